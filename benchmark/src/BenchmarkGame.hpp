@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Game.hpp>
+#include <core/Logger.hpp>
+#include <core/MeshOptimizer.hpp>
+#include <core/FrustumCuller.hpp>
+
+#include <string>
+#include <vector>
+#include <random>
+
+/*
+    Renderer benchmark
+    Runs one synthetic scene for a fixed number of frames after a warmup and writes CPU and GPU frame time percentiles to a JSON file
+    Everything is seeded, so two runs of the same scene on the same build submit exactly the same work
+
+    Usage: benchmark [--scene=draws|meshes|materials|churn|resize|mesh|gpu|cull|instances] [--count=N] [--frames=N] [--warmup=N]
+                     [--width=N] [--height=N] [--output=results.json] [--capture=frame.ppm] [--windowed] [--pipelined]
+                     [--present=fifo|mailbox|immediate] [--images=N] [--frames-in-flight=N] [--fps-limit=N] [--unoptimized]
+
+    Scenes (count means something different for each):
+    - draws: count draws of the same mesh
+    - meshes: count unique meshes, one draw each
+    - materials: count pipeline variants (up to 128), 1024 draws cycling through them
+    - churn: 1024 draws plus count KB of vertex data uploaded every frame
+    - resize: 256 draws and the framebuffer resized every count frames
+    - mesh: 64 draws of a sphere with count rings (up to 256), triangles and vertices shuffled and some vertices split like a careless exporter would
+      The mesh goes through MeshOptimizer unless --unoptimized is passed, ACMR and ATVR before and after are in the results either way
+    - gpu: count GPU scene instances of a small mesh spread over twice the screen, so roughly a quarter survive culling, and no packet draws
+    - cull: count bounding spheres and count boxes (100k to 1M is a good range) culled on the CPU every frame, single threaded and across the job system
+      Nothing is drawn but the test triangle, the cull times and objects per nanosecond are in the results
+    - instances: count draws of the same mesh, each with its own InstanceData, which the renderer batches into one instanced draw
+      Compare with draws at the same count for the cost of a draw per copy
+
+    The present mode and limiter only change anything when windowed, latency_ms in the results is input to present latency (see FrameLimiter.hpp)
+*/
+
+struct BenchmarkConfig {
+    std::string scene = "draws";
+    uint32_t count = 1000;
+    uint32_t frames = 500;
+    uint32_t warmup = 50;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    std::string output = "benchmark_results.json";
+    std::string capture;
+    bool windowed = false;
+    bool pipelined = false;
+    SwapchainConfig swapchain;
+    double fps_limit = 0.0;
+    bool optimize_mesh = true;
+
+    bool parse(int argc, char** argv);
+};
+
+class BenchmarkGame : public Game {
+    public:
+        BenchmarkConfig config;
+
+        void init() override;
+        void update(float deltaTime) override;
+        void render(float deltaTime) override;
+        void onWindowResize(uint16_t width, uint16_t height) override;
+        void buildRenderPacket(RenderPacket& packet) override;
+
+    private:
+        VulkanDrawCommand uploadTriangle(float x, float y, float size);
+        void setupDraws();
+        void setupMaterials();
+        void setupChurn();
+        void setupMesh();
+        void setupGpu();
+        void setupCull();
+        void setupInstances();
+        void runCull();
+        void uploadChurn();
+        bool writeResults();
+
+        std::mt19937 m_random{1234};
+        uint32_t m_frame = 0;
+
+        // Draws are double buffered so the render thread can still be reading last frame's list when pipelined
+        std::vector<VulkanDrawCommand> m_draws[2];
+
+        VulkanMesh m_churn_region; // Vertex space that churn uploads overwrite, never drawn
+        std::vector<Vertex3D> m_churn_vertices;
+
+        VertexCacheStats m_mesh_stats_before;
+        VertexCacheStats m_mesh_stats_after;
+        uint32_t m_mesh_vertices_before = 0;
+        uint32_t m_mesh_vertices_after = 0;
+        double m_mesh_optimize_ms = 0.0;
+
+        std::vector<InstanceData> m_instances; // Draws of the instances scene point into this
+
+        BoundingSpheres m_cull_spheres;
+        BoundingBoxes m_cull_boxes;
+        std::vector<uint32_t> m_cull_visible;
+        std::vector<uint32_t> m_cull_parallel_visible; // Resized by every parallel cull, reserved up front so it never reallocates
+        uint32_t m_cull_visible_spheres = 0;
+        uint32_t m_cull_visible_boxes = 0;
+        std::vector<double> m_cull_sphere_times;
+        std::vector<double> m_cull_box_times;
+        std::vector<double> m_cull_parallel_times;
+
+        std::vector<VulkanPipelineDescription> m_material_descriptions;
+        std::vector<VulkanPipeline*> m_materials;
+        bool m_materials_ready = false;
+        uint32_t m_compile_wait_frames = 0;
+
+        std::vector<double> m_cpu_times;
+        std::vector<double> m_gpu_times;
+        std::vector<double> m_latencies;
+        uint64_t m_gpu_frames_seen = 0;
+};
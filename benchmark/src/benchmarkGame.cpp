@@ -0,0 +1,482 @@
+#include "BenchmarkGame.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+static const uint32_t MATERIAL_DRAWS = 1024;
+static const uint32_t MAX_MATERIALS = 128;
+static const uint32_t CHURN_DRAWS = 1024;
+static const uint32_t MAX_CHURN_KB = 4096; // Keeps a frame's uploads well inside the staging ring
+static const uint32_t RESIZE_DRAWS = 256;
+static const uint32_t MESH_DRAWS = 64;
+static const uint32_t MAX_MESH_RINGS = 256; // 262144 triangles, inside one geometry page
+static const float GPU_INSTANCE_SPREAD = 2.0f; // Clip space is [-1, 1], so about a quarter of the instances are visible
+static const float CULL_SPREAD = 2.0f; // Bounds are spread over [-2, 2] on each axis around clip space
+static const uint32_t MAX_COMPILE_WAIT_FRAMES = 10000; // Stop waiting on pipelines that are never going to compile
+
+bool BenchmarkConfig::parse(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = strchr(arg, '=');
+        value = value ? value + 1 : "";
+
+        if (strncmp(arg, "--scene=", 8) == 0) scene = value;
+        else if (strncmp(arg, "--count=", 8) == 0) count = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--frames=", 9) == 0) frames = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--warmup=", 9) == 0) warmup = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--width=", 8) == 0) width = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--height=", 9) == 0) height = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--output=", 9) == 0) output = value;
+        else if (strncmp(arg, "--capture=", 10) == 0) capture = value;
+        else if (strcmp(arg, "--windowed") == 0) windowed = true;
+        else if (strcmp(arg, "--pipelined") == 0) pipelined = true;
+        else if (strcmp(arg, "--unoptimized") == 0) optimize_mesh = false;
+        else if (strncmp(arg, "--images=", 9) == 0) swapchain.image_count = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--frames-in-flight=", 19) == 0) swapchain.frames_in_flight = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strncmp(arg, "--fps-limit=", 12) == 0) fps_limit = strtod(value, nullptr);
+        else if (strncmp(arg, "--present=", 10) == 0) {
+            if (strcmp(value, "fifo") == 0) swapchain.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+            else if (strcmp(value, "mailbox") == 0) swapchain.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+            else if (strcmp(value, "immediate") == 0) swapchain.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            else {
+                Logger::error("Unknown present mode %s", value);
+                return false;
+            }
+        }
+        else {
+            Logger::error("Unknown benchmark argument %s", arg);
+            return false;
+        }
+    }
+
+    if (scene != "draws" && scene != "meshes" && scene != "materials" && scene != "churn" && scene != "resize" && scene != "mesh" && scene != "gpu" && scene != "cull" && scene != "instances") {
+        Logger::error("Unknown benchmark scene %s", scene.c_str());
+        return false;
+    }
+    if (frames == 0 || width == 0 || height == 0) {
+        Logger::error("Benchmark frames, width and height have to be greater than zero");
+        return false;
+    }
+    return true;
+}
+
+void BenchmarkGame::init() {
+    Logger::info("Benchmark '%s' with count %u on %s, %u frames after %u warmup frames", config.scene.c_str(), config.count, Renderer::getDeviceName(), config.frames, config.warmup);
+
+    m_cpu_times.reserve(config.frames);
+    m_latencies.reserve(config.frames);
+    m_gpu_times.reserve(config.frames);
+
+    if (config.scene == "materials") setupMaterials();
+    else if (config.scene == "churn") setupChurn();
+    else if (config.scene == "mesh") setupMesh();
+    else if (config.scene == "gpu") setupGpu();
+    else if (config.scene == "cull") setupCull();
+    else if (config.scene == "instances") setupInstances();
+    else setupDraws();
+
+    m_draws[1] = m_draws[0];
+}
+
+VulkanDrawCommand BenchmarkGame::uploadTriangle(float x, float y, float size) {
+    // Same winding as the test triangle, positions are already in clip space
+    std::uniform_real_distribution<float> depth(0.1f, 0.9f);
+    float z = depth(m_random);
+    Vertex3D vertices[3] = {
+        {{x, y - size, z}},
+        {{x + size, y + size, z}},
+        {{x - size, y + size, z}},
+    };
+    uint32_t indices[3] = {0, 1, 2};
+    return Renderer::uploadMesh(vertices, 3, indices, 3).getDrawCommand(); // Nothing is freed, so the pool never needs compacting
+}
+
+void BenchmarkGame::setupDraws() {
+    std::uniform_real_distribution<float> position(-0.95f, 0.95f);
+
+    if (config.scene == "meshes") {
+        // Every draw gets its own vertices and indices
+        m_draws[0].reserve(config.count);
+        for (uint32_t i = 0; i < config.count; i++) {
+            VulkanDrawCommand mesh = uploadTriangle(position(m_random), position(m_random), 0.02f);
+            if (mesh.index_count == 0) break;
+            m_draws[0].push_back(mesh);
+        }
+        return;
+    }
+
+    uint32_t draw_count = config.scene == "resize" ? RESIZE_DRAWS : config.count;
+    VulkanDrawCommand mesh = uploadTriangle(0.0f, 0.0f, 0.5f);
+    m_draws[0].assign(draw_count, mesh);
+}
+
+void BenchmarkGame::setupMaterials() {
+    /*
+        Every combination of a handful of fixed function states, in a fixed order so the same count always builds the same pipelines
+        Some variants (e.g. depth compare never) draw nothing, that's fine since the point is the cost of switching pipelines
+        The pipeline state cache compiles them in the background, so frames aren't measured until all of them are ready
+    */
+    uint32_t material_count = config.count;
+    if (material_count > MAX_MATERIALS) {
+        Logger::warn("The materials scene only has %u pipeline variants, using that many instead of %u", MAX_MATERIALS, material_count);
+        material_count = MAX_MATERIALS;
+    }
+    material_count = std::max(material_count, 1u);
+
+    const VkCullModeFlags cull_modes[] = {VK_CULL_MODE_NONE, VK_CULL_MODE_BACK_BIT};
+    const VkFrontFace front_faces[] = {VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_FRONT_FACE_CLOCKWISE};
+
+    for (uint32_t i = 0; i < material_count; i++) {
+        VulkanPipelineDescription description = Renderer::getDefaultPipelineDescription();
+        uint32_t variant = i;
+        description.cull_mode = cull_modes[variant % 2]; variant /= 2;
+        description.front_face = front_faces[variant % 2]; variant /= 2;
+        description.depth_compare = static_cast<VkCompareOp>(variant % 8); variant /= 8;
+        description.depth_write = variant % 2 == 0; variant /= 2;
+        description.blend_enable = variant % 2 == 1;
+        m_material_descriptions.push_back(description);
+    }
+    m_materials.assign(material_count, nullptr);
+
+    VulkanDrawCommand mesh = uploadTriangle(0.0f, 0.0f, 0.5f);
+    m_draws[0].assign(MATERIAL_DRAWS, mesh);
+}
+
+void BenchmarkGame::setupChurn() {
+    VulkanDrawCommand mesh = uploadTriangle(0.0f, 0.0f, 0.5f);
+    m_draws[0].assign(CHURN_DRAWS, mesh);
+
+    uint32_t churn_kb = config.count;
+    if (churn_kb > MAX_CHURN_KB) {
+        Logger::warn("Churn is capped at %u KB per frame, using that instead of %u", MAX_CHURN_KB, churn_kb);
+        churn_kb = MAX_CHURN_KB;
+    }
+
+    // Region is reserved through uploadMesh but never drawn, so overwriting it can't race with frames in flight
+    uint32_t vertex_count = std::max<uint32_t>(churn_kb * 1024 / sizeof(Vertex3D), 3);
+    m_churn_vertices.resize(vertex_count);
+    std::vector<uint32_t> indices(3, 0);
+    m_churn_region = Renderer::uploadMesh(m_churn_vertices.data(), vertex_count, indices.data(), 3);
+    if (!m_churn_region.isValid()) m_churn_vertices.clear();
+}
+
+void BenchmarkGame::setupMesh() {
+    uint32_t rings = std::clamp(config.count, 2u, MAX_MESH_RINGS);
+    if (rings != config.count) Logger::warn("The mesh scene uses between 2 and %u rings, using %u instead of %u", MAX_MESH_RINGS, rings, config.count);
+    uint32_t segments = rings * 2;
+
+    // Sphere in clip space, nearer the camera in the middle of the screen
+    std::vector<Vertex3D> vertices;
+    for (uint32_t ring = 0; ring <= rings; ring++) {
+        float theta = glm::pi<float>() * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; segment++) {
+            float phi = 2.0f * glm::pi<float>() * segment / segments;
+            glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vertices.push_back({glm::vec3(direction.x * 0.8f, direction.y * 0.8f, 0.5f + direction.z * 0.4f)});
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (uint32_t ring = 0; ring < rings; ring++) {
+        for (uint32_t segment = 0; segment < segments; segment++) {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+
+    // Source order: shuffled triangles and vertices, and a quarter of the triangles with their own copy of a vertex
+    uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<uint32_t> triangle_order(triangle_count);
+    for (uint32_t i = 0; i < triangle_count; i++) triangle_order[i] = i;
+    std::shuffle(triangle_order.begin(), triangle_order.end(), m_random);
+
+    std::vector<uint32_t> vertex_order(vertices.size());
+    for (uint32_t i = 0; i < vertex_order.size(); i++) vertex_order[i] = i;
+    std::shuffle(vertex_order.begin(), vertex_order.end(), m_random);
+
+    std::vector<uint32_t> source_indices;
+    source_indices.reserve(indices.size());
+    std::vector<Vertex3D> source_vertices(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++) source_vertices[vertex_order[i]] = vertices[i];
+    for (uint32_t t : triangle_order) {
+        for (uint32_t k = 0; k < 3; k++) source_indices.push_back(vertex_order[indices[t * 3 + k]]);
+        if (m_random() % 4 == 0) {
+            source_indices.back() = static_cast<uint32_t>(source_vertices.size());
+            source_vertices.push_back(vertices[indices[t * 3 + 2]]);
+        }
+    }
+
+    uint32_t index_count = static_cast<uint32_t>(source_indices.size());
+    m_mesh_vertices_before = static_cast<uint32_t>(source_vertices.size());
+    m_mesh_stats_before = MeshOptimizer::analyzeVertexCache(source_indices.data(), index_count, m_mesh_vertices_before);
+
+    auto optimize_start = std::chrono::steady_clock::now();
+    std::vector<Vertex3D> optimized_vertices = source_vertices;
+    std::vector<uint32_t> optimized_indices = source_indices;
+    MeshOptimizer::optimize(optimized_vertices, optimized_indices);
+    m_mesh_optimize_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimize_start).count();
+
+    m_mesh_vertices_after = static_cast<uint32_t>(optimized_vertices.size());
+    m_mesh_stats_after = MeshOptimizer::analyzeVertexCache(optimized_indices.data(), index_count, m_mesh_vertices_after);
+    Logger::info("Mesh of %u triangles optimised in %.2f ms: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+        triangle_count, m_mesh_optimize_ms, m_mesh_vertices_before, m_mesh_vertices_after,
+        m_mesh_stats_before.acmr, m_mesh_stats_after.acmr, m_mesh_stats_before.atvr, m_mesh_stats_after.atvr);
+
+    VulkanMesh mesh = config.optimize_mesh
+        ? Renderer::uploadMesh(optimized_vertices.data(), m_mesh_vertices_after, optimized_indices.data(), index_count)
+        : Renderer::uploadMesh(source_vertices.data(), m_mesh_vertices_before, source_indices.data(), index_count);
+    if (mesh.isValid()) m_draws[0].assign(MESH_DRAWS, mesh.getDrawCommand());
+}
+
+void BenchmarkGame::setupGpu() {
+    // Instances aren't in the packet at all, the renderer culls and draws them every frame on its own
+    Vertex3D vertices[3] = {
+        {{0.0f, -0.02f, 0.0f}},
+        {{0.02f, 0.02f, 0.0f}},
+        {{-0.02f, 0.02f, 0.0f}},
+    };
+    uint32_t indices[3] = {0, 1, 2};
+    VulkanMesh mesh = Renderer::uploadMesh(vertices, 3, indices, 3);
+    if (!mesh.isValid()) return;
+
+    glm::vec4 bounds = VulkanGpuScene::computeBounds(vertices, 3);
+    std::uniform_real_distribution<float> position(-GPU_INSTANCE_SPREAD, GPU_INSTANCE_SPREAD);
+    std::uniform_real_distribution<float> depth(0.1f, 0.9f);
+    for (uint32_t i = 0; i < config.count; i++) {
+        if (Renderer::addInstance(mesh, bounds, glm::vec3(position(m_random), position(m_random), depth(m_random))) == UINT32_MAX) break;
+    }
+    if (Renderer::getInstanceCount() == 0) Logger::warn("The gpu scene has no instances, GPU driven rendering isn't supported on %s", Renderer::getDeviceName());
+}
+
+void BenchmarkGame::setupInstances() {
+    // Small copies of one triangle scattered over the screen, each tinted differently
+    Vertex3D vertices[3] = {
+        {{0.0f, -0.02f, 0.0f}},
+        {{0.02f, 0.02f, 0.0f}},
+        {{-0.02f, 0.02f, 0.0f}},
+    };
+    uint32_t indices[3] = {0, 1, 2};
+    VulkanMesh mesh = Renderer::uploadMesh(vertices, 3, indices, 3);
+    if (!mesh.isValid()) return;
+
+    std::uniform_real_distribution<float> position(-0.95f, 0.95f);
+    std::uniform_real_distribution<float> depth(0.1f, 0.9f);
+    std::uniform_real_distribution<float> tint(-0.5f, 0.5f);
+    m_instances.resize(config.count);
+    for (InstanceData& instance : m_instances) {
+        instance.transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(m_random), position(m_random), depth(m_random)));
+        instance.params = glm::vec4(tint(m_random), tint(m_random), tint(m_random), 0.0f);
+    }
+
+    m_draws[0].assign(config.count, mesh.getDrawCommand());
+    for (uint32_t i = 0; i < config.count; i++) m_draws[0][i].instance = &m_instances[i];
+}
+
+void BenchmarkGame::setupCull() {
+    // Small objects scattered around the clip space frustum, about 7% of them are inside
+    std::uniform_real_distribution<float> position(-CULL_SPREAD, CULL_SPREAD);
+    std::uniform_real_distribution<float> size(0.001f, 0.05f);
+    m_cull_spheres.reserve(config.count);
+    m_cull_boxes.reserve(config.count);
+    for (uint32_t i = 0; i < config.count; i++) {
+        glm::vec3 centre(position(m_random), position(m_random), position(m_random));
+        m_cull_spheres.add(centre, size(m_random));
+        glm::vec3 extent(size(m_random), size(m_random), size(m_random));
+        m_cull_boxes.add(centre - extent, centre + extent);
+    }
+    m_cull_visible.resize(config.count);
+    m_cull_parallel_visible.reserve(config.count);
+
+    m_cull_sphere_times.reserve(config.frames);
+    m_cull_box_times.reserve(config.frames);
+    m_cull_parallel_times.reserve(config.frames);
+    Logger::info("Culling %u spheres and %u boxes, %s (%u wide) on %u threads", config.count, config.count, FrustumCuller::getSimdName(), FrustumCuller::getSimdWidth(), JobSystem::getThreadCount());
+}
+
+void BenchmarkGame::runCull() {
+    // The frustum drifts a little every frame so no two frames cull exactly the same set
+    float offset = 0.25f * std::sin(m_frame * 0.01f);
+    Frustum frustum = Frustum::fromViewProjection(glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)));
+    bool measured = m_frame > config.warmup && m_cull_sphere_times.size() < config.frames;
+
+    auto start = std::chrono::steady_clock::now();
+    m_cull_visible_spheres = FrustumCuller::cullSpheres(frustum, m_cull_spheres, 0, m_cull_spheres.size(), m_cull_visible.data());
+    auto spheres_done = std::chrono::steady_clock::now();
+    m_cull_visible_boxes = FrustumCuller::cullBoxes(frustum, m_cull_boxes, 0, m_cull_boxes.size(), m_cull_visible.data());
+    auto boxes_done = std::chrono::steady_clock::now();
+
+    FrustumCuller::cullSpheresParallel(frustum, m_cull_spheres, m_cull_parallel_visible);
+    auto parallel_done = std::chrono::steady_clock::now();
+
+    if (!measured) return;
+    m_cull_sphere_times.push_back(std::chrono::duration<double, std::milli>(spheres_done - start).count());
+    m_cull_box_times.push_back(std::chrono::duration<double, std::milli>(boxes_done - spheres_done).count());
+    m_cull_parallel_times.push_back(std::chrono::duration<double, std::milli>(parallel_done - boxes_done).count());
+}
+
+void BenchmarkGame::uploadChurn() {
+    if (m_churn_vertices.empty()) return;
+
+    // Changing the data every frame stops the driver or the staging ring from skipping anything
+    float value = static_cast<float>(m_frame);
+    for (Vertex3D& vertex : m_churn_vertices) vertex.position = glm::vec3(value);
+    Renderer::updateMeshVertices(m_churn_region, m_churn_vertices.data(), static_cast<uint32_t>(m_churn_vertices.size()));
+}
+
+void BenchmarkGame::update(float deltaTime) {
+    if (!m_materials.empty() && !m_materials_ready) {
+        const VulkanPipelineDescription& default_description = Renderer::getDefaultPipelineDescription();
+        VulkanPipeline* fallback = Renderer::getPipeline(default_description);
+        uint64_t default_hash = VulkanPipelineStateCache::hash(default_description);
+
+        m_materials_ready = true;
+        for (size_t i = 0; i < m_materials.size(); i++) {
+            if (m_materials[i] == nullptr || m_materials[i] == fallback) m_materials[i] = Renderer::getPipeline(m_material_descriptions[i]);
+
+            // The variant with the default state really is the fallback
+            if (m_materials[i] == fallback && VulkanPipelineStateCache::hash(m_material_descriptions[i]) != default_hash) m_materials_ready = false;
+        }
+
+        if (!m_materials_ready && ++m_compile_wait_frames < MAX_COMPILE_WAIT_FRAMES) return;
+        if (!m_materials_ready) Logger::warn("Some pipeline variants still aren't ready after %u frames, benchmarking with the fallback", MAX_COMPILE_WAIT_FRAMES);
+        m_materials_ready = true;
+
+        Logger::info("All %zu pipeline variants are ready", m_materials.size());
+        for (auto& draws : m_draws) {
+            for (size_t i = 0; i < draws.size(); i++) draws[i].pipeline = m_materials[i % m_materials.size()];
+        }
+    }
+
+    if (config.scene == "cull") runCull();
+
+    // The delta time of a frame is the time between the starts of this frame and the last one
+    if (m_frame > config.warmup && m_cpu_times.size() < config.frames) {
+        m_cpu_times.push_back(deltaTime * 1000.0);
+        m_latencies.push_back(Application::get().getInputLatency().getLast() * 1000.0); // Last frame the renderer finished, a frame behind when pipelined
+    }
+
+    // GPU results show up a couple of frames late, they're only read on this thread when rendering isn't pipelined
+    const VulkanGpuProfiler& gpu_profiler = Renderer::getGpuProfiler();
+    if (!config.pipelined && gpu_profiler.getCollectedFrameCount() > m_gpu_frames_seen) {
+        m_gpu_frames_seen = gpu_profiler.getCollectedFrameCount();
+        if (m_frame > config.warmup && m_gpu_times.size() < config.frames) m_gpu_times.push_back(gpu_profiler.getLastFrameTime());
+    }
+
+    if (m_cpu_times.size() == config.frames) {
+        writeResults();
+        Application::get().quit();
+    }
+}
+
+void BenchmarkGame::render(float deltaTime) {
+    if (config.scene == "churn") uploadChurn();
+}
+
+void BenchmarkGame::onWindowResize(uint16_t width, uint16_t height) {
+
+}
+
+void BenchmarkGame::buildRenderPacket(RenderPacket& packet) {
+    if (!m_materials.empty() && !m_materials_ready) return; // Test triangle until the pipelines are compiled
+
+    std::vector<VulkanDrawCommand>& draws = m_draws[m_frame % 2];
+    packet.draws = draws.data();
+    packet.draw_count = static_cast<uint32_t>(draws.size());
+
+    // Headless swapchains can be resized straight from the packet, windows can only be resized by the user
+    if (config.scene == "resize" && !config.windowed && config.count > 0 && m_frame > 0 && m_frame % config.count == 0) {
+        bool small = (m_frame / config.count) % 2 == 1;
+        packet.framebuffer_resized = true;
+        packet.framebuffer_width = small ? config.width / 2 : config.width;
+        packet.framebuffer_height = small ? config.height / 2 : config.height;
+    }
+
+    // Update has already quit on the last measured frame, so this is the last packet that gets drawn
+    if (m_cpu_times.size() == config.frames && !config.capture.empty()) packet.capture_path = config.capture.c_str();
+
+    m_frame++;
+}
+
+struct FrameTimeStats {
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+static FrameTimeStats computeStats(std::vector<double> times) {
+    FrameTimeStats stats;
+    if (times.empty()) return stats;
+
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p) {
+        // Nearest rank, so every reported value is a frame that actually happened
+        size_t rank = static_cast<size_t>(p / 100.0 * times.size() + 0.999999);
+        return times[std::clamp<size_t>(rank, 1, times.size()) - 1];
+    };
+
+    for (double time : times) stats.mean += time;
+    stats.mean /= times.size();
+    stats.p50 = percentile(50.0);
+    stats.p95 = percentile(95.0);
+    stats.p99 = percentile(99.0);
+    stats.max = times.back();
+    return stats;
+}
+
+static void writeStats(FILE* file, const char* name, const std::vector<double>& times, bool last) {
+    FrameTimeStats stats = computeStats(times);
+    fprintf(file, "    \"%s\": {\"samples\": %zu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+        name, times.size(), stats.mean, stats.p50, stats.p95, stats.p99, stats.max, last ? "" : ",");
+    Logger::info("%s frame time (ms): mean %.3f, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f", name, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+}
+
+bool BenchmarkGame::writeResults() {
+    FILE* file = fopen(config.output.c_str(), "w");
+    if (!file) {
+        Logger::error("Failed to open %s to write the benchmark results", config.output.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"scene\": \"%s\",\n", config.scene.c_str());
+    fprintf(file, "    \"count\": %u,\n", config.count);
+    fprintf(file, "    \"frames\": %u,\n", config.frames);
+    fprintf(file, "    \"warmup\": %u,\n", config.warmup);
+    fprintf(file, "    \"width\": %u,\n", config.width);
+    fprintf(file, "    \"height\": %u,\n", config.height);
+    fprintf(file, "    \"pipelined\": %s,\n", config.pipelined ? "true" : "false");
+    fprintf(file, "    \"present_mode\": %d,\n", config.swapchain.present_mode);
+    fprintf(file, "    \"fps_limit\": %.2f,\n", config.fps_limit);
+    fprintf(file, "    \"device\": \"%s\",\n", Renderer::getDeviceName());
+    fprintf(file, "    \"draws_per_frame\": %zu,\n", m_draws[0].size());
+    if (config.scene == "mesh") {
+        fprintf(file, "    \"mesh_optimized\": %s,\n", config.optimize_mesh ? "true" : "false");
+        fprintf(file, "    \"mesh_optimize_ms\": %.3f,\n", m_mesh_optimize_ms);
+        fprintf(file, "    \"mesh_before\": {\"vertices\": %u, \"acmr\": %.4f, \"atvr\": %.4f},\n", m_mesh_vertices_before, m_mesh_stats_before.acmr, m_mesh_stats_before.atvr);
+        fprintf(file, "    \"mesh_after\": {\"vertices\": %u, \"acmr\": %.4f, \"atvr\": %.4f},\n", m_mesh_vertices_after, m_mesh_stats_after.acmr, m_mesh_stats_after.atvr);
+    }
+    if (config.scene == "cull") {
+        // Objects per nanosecond from the median, count objects in p50 milliseconds
+        auto objects_per_ns = [&](const std::vector<double>& times) { double p50 = computeStats(times).p50; return p50 > 0.0 ? config.count / (p50 * 1e6) : 0.0; };
+        fprintf(file, "    \"cull_simd\": \"%s\",\n", FrustumCuller::getSimdName());
+        fprintf(file, "    \"cull_threads\": %u,\n", JobSystem::getThreadCount());
+        fprintf(file, "    \"cull_visible\": {\"spheres\": %u, \"boxes\": %u},\n", m_cull_visible_spheres, m_cull_visible_boxes);
+        fprintf(file, "    \"cull_objects_per_ns\": {\"spheres\": %.4f, \"boxes\": %.4f, \"spheres_parallel\": %.4f},\n",
+            objects_per_ns(m_cull_sphere_times), objects_per_ns(m_cull_box_times), objects_per_ns(m_cull_parallel_times));
+        writeStats(file, "cull_spheres_ms", m_cull_sphere_times, false);
+        writeStats(file, "cull_boxes_ms", m_cull_box_times, false);
+        writeStats(file, "cull_spheres_parallel_ms", m_cull_parallel_times, false);
+    }
+    writeStats(file, "cpu_ms", m_cpu_times, false);
+    writeStats(file, "gpu_ms", m_gpu_times, false);
+    writeStats(file, "latency_ms", m_latencies, true);
+    fprintf(file, "}\n");
+    fclose(file);
+
+    Logger::info("Benchmark results written to %s", config.output.c_str());
+    return true;
+}
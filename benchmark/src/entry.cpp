@@ -0,0 +1,26 @@
+#include <EntryPoint.hpp>
+#include "BenchmarkGame.hpp"
+
+#include <cstdlib>
+
+Game& createGame(int argc, char** argv) {
+    static BenchmarkGame game;
+    if (!game.config.parse(argc, argv)) {
+        Logger::shutdown(); // Flush the error before exiting
+        exit(1);
+    }
+
+    // Configure app
+    game.app_config.app_name = "Wyvern Benchmark";
+    game.app_config.window_width = game.config.width;
+    game.app_config.window_height = game.config.height;
+    game.app_config.pipelined_rendering = game.config.pipelined;
+    game.app_config.swapchain = game.config.swapchain;
+    game.app_config.frame_rate_limit = game.config.fps_limit;
+
+    // The benchmark quits itself once it has enough frames, the frame count only has to be out of the way (pipelines compiling can take a while)
+    game.app_config.headless = !game.config.windowed;
+    game.app_config.headless_frame_count = UINT32_MAX;
+
+    return game;
+}
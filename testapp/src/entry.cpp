@@ -1,7 +1,7 @@
 #include <EntryPoint.hpp>
 #include "TestGame.hpp"
 
-Game& createGame() {
+Game& createGame(int argc, char** argv) {
     static TestGame game;
 
     // Configure app
@@ -4,22 +4,24 @@
 #include "core/Logger.hpp"
 #include "Game.hpp"
 
-extern Game& createGame(); // This will be implemented by the game itself outside of engine
+extern Game& createGame(int argc, char** argv); // This will be implemented by the game itself outside of engine
 
 /*
     This is the main entry point of the application
     Engine controls the flow
 */
-int main() {
+int main(int argc, char** argv) {
+    Logger::init();
     Logger::info("Starting Wyvern Engine...");
 
     // Request game instance from application
-    Game& game = createGame();
+    Game& game = createGame(argc, argv);
 
     Application::init(&game);
     Application& app = Application::get();
     app.run();
 
     Logger::info("Shutting down Wyvern Engine...");
+    Logger::shutdown();
     return 0;
 }
\ No newline at end of file
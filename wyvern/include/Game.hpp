@@ -16,4 +16,7 @@ class Game {
         virtual void update(float deltaTime) = 0;
         virtual void render(float deltaTime) = 0;
         virtual void onWindowResize(uint16_t width, uint16_t height) = 0;
+
+        // Called after render() to fill in the frame's draws, the packet already has the frame number and delta time
+        virtual void buildRenderPacket(RenderPacket& packet) {}
 };
\ No newline at end of file
@@ -2,11 +2,16 @@
 
 #include <string>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "core/Logger.hpp"
 #include "core/glfw/Window.hpp"
 #include "core/glfw/Input.hpp"
 #include "core/Clock.hpp"
+#include "core/FrameLimiter.hpp"
+#include "core/JobSystem.hpp"
+#include "core/Profiler.hpp"
 #include "events/EventTypes.hpp"
 
 #include "renderer/Renderer.hpp"
@@ -18,6 +23,29 @@ struct ApplicationConfig {
     int window_width;
     int window_height;
     std::string app_name;
+
+    /*
+        Run the renderer on its own thread, one frame behind the game
+        The main thread updates frame N+1 while the render thread records and submits frame N, so a frame costs max(update, render) rather than the sum
+        Game::update and Game::render both stay on the main thread, and the renderer only sees the RenderPacket they produce
+    */
+    bool pipelined_rendering = false;
+
+    /*
+        Render into offscreen images without creating a window, so the engine can run on machines without a display (e.g. build servers with a software Vulkan driver like lavapipe)
+        The app runs for headless_frame_count frames and then exits, and if headless_capture_path is set the last frame is written there as a PPM
+    */
+    bool headless = false;
+    uint32_t headless_frame_count = 1000;
+    std::string headless_capture_path;
+
+    /*
+        Throughput against latency, see VulkanSwapchain.hpp and FrameLimiter.hpp. Both can also be changed while running
+        e.g. FIFO with 1 frame in flight for the least input lag with vsync, or MAILBOX with a few frames in flight and no limit for the most frames
+    */
+    SwapchainConfig swapchain;
+    double frame_rate_limit = 0.0; // 0 is unlimited
+    double frame_limiter_spin_time = 0.002; // Seconds spun before each deadline instead of sleeping
 };
 
 struct ApplicationState {
@@ -40,17 +68,46 @@ class Application {
         void run();
 
         static Application& get() { return *s_instance; }
+        void quit() { m_state.is_running = false; } // Stops after the current frame
         Window* getWindow() { return m_state.window.get(); }
+
+        // Applied from the next frame, call these from the main thread
+        void setSwapchainConfig(const SwapchainConfig& config);
+        const SwapchainConfig& getSwapchainConfig() { return m_swapchain_config; }
+        void setFrameRateLimit(double frames_per_second) { m_frame_limiter.setTargetFrameRate(frames_per_second); }
+        double getFrameRateLimit() { return m_frame_limiter.getTargetFrameRate(); }
+
+        const LatencyTracker& getInputLatency() { return m_input_latency; } // Seconds from polling input to presenting the frame
         EventDispatcher* getEventDispatcher() { return &m_dispatcher; }
 
     private:
         Application(Game* game);
 
-        bool onWindowClose();
-        bool onWindowResize(WindowResizeEvent& e);
-        bool onKeyPress(KeyPressedEvent& e);
+        bool onWindowClose(const WindowCloseEvent& e);
+        bool onWindowResize(const WindowResizeEvent& e);
+        bool onKeyPress(const KeyPressedEvent& e);
+
+        void submitRenderPacket(const RenderPacket& packet);
+        void renderThreadLoop();
 
         static Application* s_instance;
         ApplicationState m_state;
         EventDispatcher m_dispatcher;
+
+        FrameLimiter m_frame_limiter;
+        LatencyTracker m_input_latency;
+        SwapchainConfig m_swapchain_config;
+        bool m_swapchain_config_changed = false;
+
+        // Pipelined rendering, the main thread writes packet m_packets_submitted % 2 while the render thread reads the other one
+        bool m_pipelined = false;
+        bool m_headless = false;
+        std::thread m_render_thread;
+        RenderPacket m_packets[2];
+        uint64_t m_packets_submitted = 0;
+        uint64_t m_packets_consumed = 0;
+        bool m_render_thread_running = false;
+        bool m_pending_resize = false; // Only touched by the main thread
+        std::mutex m_packet_mutex;
+        std::condition_variable m_packet_condition;
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+/*
+    FRAME LIMITER:
+    - Holds the main loop to a target frame rate, independent of the present mode (e.g. capping MAILBOX or IMMEDIATE so they don't burn power, or running below the refresh rate)
+    - sleep_for on its own wakes up late by anything up to a scheduler tick, so the limiter sleeps until spin_time before the deadline and spins for the rest
+      A bigger spin_time is more precise but keeps a core busy for longer
+    - Deadlines are a fixed grid of frame times rather than "now + frame time", so small errors don't add up. A frame that overruns by more than a whole frame restarts the grid
+      instead of rushing the next few frames to catch up
+    - The loop waits before it polls input, so the sleep happens between frames rather than between reading input and drawing with it
+
+    LATENCY:
+    - Input to present latency is the time from polling a frame's input to handing that frame to vkQueuePresentKHR
+    - With pipelined rendering that includes the frame waiting for the render thread, and the display adds its own queueing on top (a refresh per queued image with FIFO),
+      so it is a lower bound on what the user sees but moves the same way when frames in flight or the limiter change
+*/
+
+class FrameLimiter {
+    public:
+        void setTargetFrameRate(double frames_per_second); // 0 turns the limiter off
+        void setSpinTime(double seconds) { m_spin_time = seconds; }
+        double getTargetFrameRate() const { return m_frame_time > 0.0 ? 1.0 / m_frame_time : 0.0; }
+
+        void wait(); // Blocks until the next frame is due
+
+    private:
+        double m_frame_time = 0.0;
+        double m_spin_time = 0.002;
+        double m_last_frame_start = -1.0; // Negative until the first frame
+};
+
+class LatencyTracker {
+    public:
+        void record(double seconds); // Can be called from the render thread while another thread reads
+        double getLast() const { return m_last.load(std::memory_order_relaxed); }
+        double getAverage() const { return m_average.load(std::memory_order_relaxed); } // Exponential moving average, roughly the last 30 frames
+
+    private:
+        std::atomic<double> m_last{0.0};
+        std::atomic<double> m_average{0.0};
+};
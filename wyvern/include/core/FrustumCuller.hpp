@@ -0,0 +1,66 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+/*
+    FRUSTUM CULLING:
+    - Objects outside the view frustum cost draw recording, uploads and GPU time for nothing, so their bounds are tested against the frustum first
+    - Bounds are kept as a structure of arrays (all the x, then all the y...) rather than an array of structs, so one SIMD load fetches the same
+      component of 4 or 8 objects and every plane test runs on all of them at once
+    - A volume is visible when it isn't completely behind any of the six planes:
+        - Sphere: distance from the plane to the centre >= -radius, so a volume just touching a plane is kept (the same test as cull.comp)
+        - Box (centre and half extents): the same, with the radius being the box projected onto the plane's normal, |n.x| * e.x + |n.y| * e.y + |n.z| * e.z
+      This is conservative, a volume near a corner of the frustum can pass every plane while still being outside
+    - Visible objects come out as a compact list of indices. Every lane writes its index and only moves the output forward when it's visible,
+      so there are no branches on the visibility of single objects
+    - The SIMD width is picked at compile time from the compiler's target macros (the same ones glm's simd/platform.h checks):
+      AVX 8 wide, SSE2 or NEON 4 wide, otherwise one object at a time. AVX needs the engine compiled with it, e.g. -mavx or -march=native
+    - The parallel versions cut the objects into batches that go through the job system, each batch compacts into its own part of the output
+      and the parts are joined up afterwards
+*/
+
+// Six normalised planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum {
+    glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+
+    // Gribb and Hartmann, with Vulkan's [0, 1] depth range. The identity gives clip space
+    static Frustum fromViewProjection(const glm::mat4& view_projection);
+};
+
+struct BoundingSpheres {
+    std::vector<float> x, y, z, radius;
+
+    uint32_t add(const glm::vec3& centre, float radius); // Returns the sphere's index
+    void set(uint32_t index, const glm::vec3& centre, float radius);
+    void reserve(uint32_t count);
+    void clear();
+    uint32_t size() const { return static_cast<uint32_t>(x.size()); }
+};
+
+// Stored as centre and half extents, that's what the plane test needs
+struct BoundingBoxes {
+    std::vector<float> x, y, z, extent_x, extent_y, extent_z;
+
+    uint32_t add(const glm::vec3& min, const glm::vec3& max); // Returns the box's index
+    void set(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+    void reserve(uint32_t count);
+    void clear();
+    uint32_t size() const { return static_cast<uint32_t>(x.size()); }
+};
+
+class FrustumCuller {
+    public:
+        static const uint32_t DEFAULT_BATCH_SIZE = 16384; // Objects per job, 64 KB of each component
+
+        // Tests objects [begin, end) and writes the indices of the visible ones to out_visible, which needs room for end - begin. Returns how many are visible
+        static uint32_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* out_visible);
+        static uint32_t cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t begin, uint32_t end, uint32_t* out_visible);
+
+        // Every object across the job system, out_visible is resized to the visible indices in ascending order
+        static uint32_t cullSpheresParallel(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& out_visible, uint32_t batch_size = DEFAULT_BATCH_SIZE);
+        static uint32_t cullBoxesParallel(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& out_visible, uint32_t batch_size = DEFAULT_BATCH_SIZE);
+
+        static uint32_t getSimdWidth(); // Objects tested at once
+        static const char* getSimdName();
+};
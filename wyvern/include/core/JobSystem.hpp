@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+/*
+    JOB SYSTEM:
+    - One worker thread per core (minus one for the main thread), each with its own deque of jobs
+    - A thread pushes and pops jobs at the bottom of its own deque, idle threads steal from the top of other threads' deques
+      (Chase-Lev work stealing deque, the owner never takes a lock and thieves only race each other with a CAS on top)
+    - Threads that aren't workers (e.g. the render thread) push into a shared queue that every worker checks
+    - Progress is tracked with JobCounters: each job decrements its counter when it finishes, so waiting on a counter waits on a group of jobs
+    - A job can also depend on a counter, it won't start until that counter reaches zero
+      Until then it's parked on the side rather than queued, so idle workers sleep instead of picking it up over and over,
+      and the job that brings the counter to zero moves it to the shared queue
+    - Threads waiting on a counter run other jobs in the meantime instead of blocking a core
+
+    Job storage is a ring per submitting thread, so a single thread must not have more than MAX_JOBS_PER_THREAD jobs alive at once
+    The rings belong to the job system rather than the thread and live until shutdown, a thread can exit while its jobs are still queued or parked
+*/
+
+struct JobCounter {
+    std::atomic<uint32_t> value{0};
+
+    bool isDone() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+using JobFunction = std::function<void()>;
+
+struct Job {
+    JobFunction function;
+    JobCounter* counter = nullptr;
+    const JobCounter* dependency = nullptr;
+    # if defined(_DEBUG)
+        std::atomic<bool> in_use{false}; // From allocation until execute finishes, catches the ring wrapping onto a job that hasn't run yet
+    # endif
+};
+
+class JobDeque {
+    public:
+        static const int64_t CAPACITY = 4096; // Power of two
+
+        bool push(Job* job); // Owner only, returns false when full
+        Job* pop(); // Owner only
+        Job* steal(); // Any thread
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Job*> m_jobs[CAPACITY];
+};
+
+class JobSystem {
+    public:
+        static void init(uint32_t thread_count = 0); // 0 uses one thread per core
+        static void shutdown(); // Finishes every queued and parked job first
+
+        // Queue a job, counter (optional) is incremented now and decremented when the job finishes
+        static void run(JobFunction function, JobCounter* counter = nullptr, const JobCounter* dependency = nullptr);
+        // Runs other jobs on this thread until counter reaches zero
+        static void wait(const JobCounter& counter);
+
+        // Calls function(begin, end) over [0, count) in batches of batch_size across all threads, and returns once every batch is done
+        template<typename Fn>
+        static void parallelFor(uint32_t count, uint32_t batch_size, const Fn& function) {
+            // Only a reference is captured so the std::function fits in its small buffer and never allocates
+            parallelForRange(count, batch_size, [&function](uint32_t begin, uint32_t end) { function(begin, end); });
+        }
+
+        static uint32_t getThreadCount() { return s_thread_count; } // Including the main thread
+        static bool isInitialised() { return s_running.load(std::memory_order_relaxed); }
+
+    private:
+        static const uint32_t MAX_JOBS_PER_THREAD = 4096;
+
+        static void parallelForRange(uint32_t count, uint32_t batch_size, const std::function<void(uint32_t, uint32_t)>& function);
+        static void workerLoop(uint32_t index);
+        static Job* allocateJob();
+        static Job* findJob();
+        static void execute(Job* job);
+        static void push(Job* job);
+        static bool park(Job* job);
+        static void releaseParked(const JobCounter* counter);
+
+        static uint32_t s_thread_count;
+        static std::vector<std::thread> s_workers;
+        static std::vector<std::unique_ptr<JobDeque>> s_deques; // Index 0 is the main thread
+
+        static std::mutex s_shared_mutex; // Guards s_shared_jobs, and is used to put idle workers to sleep
+        static std::deque<Job*> s_shared_jobs; // Jobs from non worker threads and jobs whose dependency just finished
+        static std::vector<Job*> s_parked_jobs; // Jobs whose dependency isn't done yet, also guarded by s_shared_mutex
+        static std::condition_variable s_wake_condition;
+        static std::atomic<uint32_t> s_queued_jobs;
+        static std::atomic<uint32_t> s_parked_count; // Lets finishing jobs skip the mutex when nothing is parked
+        static std::atomic<uint32_t> s_unfinished_jobs; // Queued, parked or running, for draining on shutdown
+        static std::atomic<uint32_t> s_sleeping_workers;
+        static std::atomic<bool> s_running;
+
+        static std::mutex s_pools_mutex;
+        static std::vector<std::unique_ptr<Job[]>> s_job_pools; // One ring per thread that has submitted a job, guarded by s_pools_mutex
+        static std::atomic<uint32_t> s_pool_generation; // Bumped on shutdown so threads know the ring they point at is gone
+};
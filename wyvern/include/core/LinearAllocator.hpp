@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+    LINEAR ALLOCATOR:
+    - Allocating is just bumping an offset into one big block, and everything is freed at once by resetting the offset
+    - Meant for data that only lives for one frame (draw lists, scratch arrays, ...), the renderer keeps one per frame in flight and resets it in beginFrame
+      once that frame has retired, so the memory stays valid until the GPU is done with the frame
+    - Allocating is lock free so jobs can allocate from the same arena
+    - If the block runs out, allocations spill over onto the heap and the block is grown on the next reset, so a steady state frame never calls malloc
+    - Destructors are never called, only use it for types that don't need them or are cleaned up by their owner
+*/
+
+class LinearAllocator {
+    public:
+        void create(size_t size);
+        void destroy();
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+        void reset();
+
+        template<typename T>
+        T* allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+
+        size_t getUsed() const { return m_offset.load(std::memory_order_relaxed); }
+        size_t getCapacity() const { return m_capacity; }
+        size_t getHighWater() const { return m_high_water; }
+        size_t getOverflowCount(); // Allocations since the last reset that didn't fit and went to the heap
+
+    private:
+        char* m_memory = nullptr;
+        size_t m_capacity = 0;
+        std::atomic<size_t> m_offset{0};
+        size_t m_high_water = 0; // Largest amount requested in a frame, including overflow
+
+        std::mutex m_overflow_mutex;
+        std::vector<void*> m_overflow;
+        size_t m_overflow_bytes = 0;
+};
+
+// Lets standard containers allocate from a LinearAllocator, deallocate does nothing as memory is released on reset
+template<typename T>
+class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        ArenaAllocator(LinearAllocator& arena) : m_arena(&arena) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.getArena()) {}
+
+        T* allocate(size_t count) { return m_arena->allocateArray<T>(count); }
+        void deallocate(T*, size_t) {}
+
+        LinearAllocator* getArena() const { return m_arena; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.getArena(); }
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.getArena(); }
+
+    private:
+        LinearAllocator* m_arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 enum LogLevel {
     LOG_LEVEL_FATAL = 0,
@@ -12,17 +17,83 @@ enum LogLevel {
     LOG_LEVEL_DEBUG = 4,
 };
 
+// Messages above this level are compiled out entirely, define WYVERN_LOG_LEVEL to override (for the engine and the app alike, _DEBUG comes from the wyvern target)
+#if !defined(WYVERN_LOG_LEVEL)
+    #if defined(_DEBUG)
+        #define WYVERN_LOG_LEVEL LOG_LEVEL_DEBUG
+    #else
+        #define WYVERN_LOG_LEVEL LOG_LEVEL_INFO
+    #endif
+#endif
+
+/*
+    ASYNC LOGGING:
+    - Logging calls format the message into a slot of a fixed size ring buffer and return, a background thread writes the slots out
+    - Any thread can log: producers claim slots with a CAS on the write position, and each slot has a sequence number that tells the writer thread when it's filled in
+    - The writer sleeps until there is something to write. A pending flag means only the first message since it last woke pays for a notify
+    - If the ring is full, info and debug messages are dropped (and counted) rather than stalling the caller, warnings and errors wait for space
+    - Fatal messages flush everything queued and are written synchronously, as the program is about to stop
+    - Before init() and after shutdown() messages are written synchronously. shutdown() stops taking messages and waits for producers already past that check,
+      so nothing gets published after the final drain
+*/
+
 class Logger {
     public:
-        static void init() {}
-               
+        static void init(const char* file_path = nullptr); // Optionally also write the log to a file
+        static void shutdown();
+        static void flush(); // Blocks until everything logged so far is written
+
         static void log(LogLevel level, const char* message, ...);
         static void fatal(const char* message, ...);
-        static void error(const char* message, ...);
-        static void warn(const char* message, ...);
-        static void info(const char* message, ...);
-        static void debug(const char* message, ...);
+
+        template<typename... Args>
+        static void error(const char* message, Args... args) {
+            if constexpr (LOG_LEVEL_ERROR <= WYVERN_LOG_LEVEL) log(LOG_LEVEL_ERROR, message, args...);
+        }
+        template<typename... Args>
+        static void warn(const char* message, Args... args) {
+            if constexpr (LOG_LEVEL_WARNING <= WYVERN_LOG_LEVEL) log(LOG_LEVEL_WARNING, message, args...);
+        }
+        template<typename... Args>
+        static void info(const char* message, Args... args) {
+            if constexpr (LOG_LEVEL_INFO <= WYVERN_LOG_LEVEL) log(LOG_LEVEL_INFO, message, args...);
+        }
+        template<typename... Args>
+        static void debug(const char* message, Args... args) {
+            if constexpr (LOG_LEVEL_DEBUG <= WYVERN_LOG_LEVEL) log(LOG_LEVEL_DEBUG, message, args...);
+        }
+
+        static uint64_t getDroppedCount() { return s_dropped.load(std::memory_order_relaxed); }
 
     private:
+        static const uint32_t SLOT_COUNT = 1024; // Power of two
+        static const uint32_t MESSAGE_SIZE = 1024; // Longer messages are truncated
+
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            LogLevel level;
+            double time;
+            char message[MESSAGE_SIZE];
+        };
+
         static void output(LogLevel level, const char* message, va_list args);
-};
\ No newline at end of file
+        static void write(LogLevel level, double time, const char* message);
+        static void writerLoop();
+        static void wakeWriter();
+        static bool drain();
+
+        static Slot s_slots[SLOT_COUNT];
+        alignas(64) static std::atomic<uint64_t> s_write_position;
+        alignas(64) static uint64_t s_read_position; // Only touched by the writer thread
+
+        static std::atomic<uint64_t> s_dropped;
+        static std::atomic<bool> s_running; // Writer thread is alive
+        static std::atomic<bool> s_accepting; // Messages go into the ring rather than being written synchronously
+        static std::atomic<uint32_t> s_producers; // Threads between the s_accepting check and publishing their slot
+        static std::atomic<bool> s_pending; // Set when something was published since the writer last looked, guarded by s_wake_mutex for waiting
+        static std::thread s_writer;
+        static std::mutex s_wake_mutex;
+        static std::condition_variable s_wake_condition;
+        static std::mutex s_sink_mutex; // Held while writing to stdout and the file so synchronous messages don't interleave with the writer thread
+        static FILE* s_file;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+    MESH OPTIMIZATION:
+    - Meshes come out of modelling tools in whatever order they were built, which is rarely a good order for the GPU
+    - Run optimize() once when a mesh is imported/cooked, before it's quantized and uploaded. The steps in order:
+        - Deduplicate: vertices with exactly the same bytes are merged, exporters often split vertices that don't need splitting
+        - Vertex cache: the GPU keeps recently transformed vertices in a small post-transform cache, so triangles are reordered to reuse them (Tipsify)
+          How well this works is measured by ACMR (transformed vertices per triangle, 3 is no reuse, ~0.5-0.7 is great on a regular mesh)
+          and ATVR (transformed vertices per unique vertex, 1 is perfect)
+        - Overdraw: the cache order is cut into clusters, which are sorted so the ones facing away from the mesh's centre are drawn first
+          These are the ones most likely to be in front, so more of the later pixels fail the depth test before shading. Clusters are only
+          cut where it costs at most threshold times the ACMR, so this trades a little vertex reuse for less overdraw
+        - Vertex fetch: vertices are put in the order the indices first use them, so fetching them walks forward through memory
+    - The cache is modelled as a FIFO of CACHE_SIZE vertices, real hardware differs but an order that's good for one size is good for most
+*/
+
+struct VertexCacheStats {
+    uint32_t vertices_transformed = 0; // Cache misses
+    float acmr = 0.0f; // Average cache miss ratio, transformed vertices per triangle
+    float atvr = 0.0f; // Average transformed to vertex ratio, transformed vertices per vertex the indices use
+};
+
+class MeshOptimizer {
+    public:
+        static const uint32_t CACHE_SIZE = 16;
+
+        // Runs every step on an indexed triangle list, Vertex needs a glm::vec3 position
+        template<typename Vertex>
+        static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdraw_threshold = 1.05f);
+
+        // Fills remap with the new index of every vertex, returns the unique vertex count
+        static uint32_t generateVertexRemap(uint32_t* remap, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride);
+        static void remapVertices(void* out_vertices, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* remap); // out_vertices can't be vertices
+        static void remapIndices(uint32_t* out_indices, const uint32_t* indices, uint32_t index_count, const uint32_t* remap); // Can be done in place
+
+        // Reorders triangles in place, out_clusters gets the index offsets where the order had to jump to an unconnected part of the mesh
+        static void optimizeVertexCache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = CACHE_SIZE, std::vector<uint32_t>* out_clusters = nullptr);
+        // indices have to be in vertex cache order, with clusters from optimizeVertexCache. Position stride is in bytes
+        static void optimizeOverdraw(uint32_t* indices, uint32_t index_count, const glm::vec3* positions, uint32_t position_stride, const std::vector<uint32_t>& clusters, uint32_t cache_size = CACHE_SIZE, float threshold = 1.05f);
+        // Writes the vertices in first use order and rewrites the indices to match, returns the vertex count (unused vertices are dropped)
+        static uint32_t optimizeVertexFetch(void* out_vertices, uint32_t* indices, uint32_t index_count, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride);
+
+        static VertexCacheStats analyzeVertexCache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = CACHE_SIZE);
+};
+
+template<typename Vertex>
+void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdraw_threshold) {
+    uint32_t index_count = static_cast<uint32_t>(indices.size());
+    if (vertices.empty() || index_count < 3) return;
+
+    std::vector<uint32_t> remap(vertices.size());
+    uint32_t unique_count = generateVertexRemap(remap.data(), vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(Vertex));
+    std::vector<Vertex> unique_vertices(unique_count);
+    remapVertices(unique_vertices.data(), vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(Vertex), remap.data());
+    remapIndices(indices.data(), indices.data(), index_count, remap.data());
+
+    std::vector<uint32_t> clusters;
+    optimizeVertexCache(indices.data(), index_count, unique_count, CACHE_SIZE, &clusters);
+    optimizeOverdraw(indices.data(), index_count, &unique_vertices[0].position, sizeof(Vertex), clusters, CACHE_SIZE, overdraw_threshold);
+
+    vertices.resize(unique_count);
+    vertices.resize(optimizeVertexFetch(vertices.data(), indices.data(), index_count, unique_vertices.data(), unique_count, sizeof(Vertex)));
+}
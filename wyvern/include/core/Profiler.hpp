@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Profiling markers are compiled in unless WYVERN_DISABLE_PROFILING is defined
+#if !defined(WYVERN_DISABLE_PROFILING)
+    #define WYVERN_PROFILE_CONCAT_INNER(a, b) a##b
+    #define WYVERN_PROFILE_CONCAT(a, b) WYVERN_PROFILE_CONCAT_INNER(a, b)
+    #define WYVERN_PROFILE_SCOPE(name) ProfileScope WYVERN_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+    #define WYVERN_PROFILE_FUNCTION() WYVERN_PROFILE_SCOPE(__func__)
+#else
+    #define WYVERN_PROFILE_SCOPE(name)
+    #define WYVERN_PROFILE_FUNCTION()
+#endif
+
+/*
+    CPU PROFILER:
+    - WYVERN_PROFILE_SCOPE("name") records how long the enclosing scope took, scopes nest and each one remembers its depth
+    - Every thread records into its own fixed size ring buffer, so recording is a couple of clock reads and stores with no locks or allocations
+      The ring keeps the most recent events, older ones are overwritten
+    - GPU timings from the renderer are recorded on a separate "GPU" track the same way
+    - exportChromeTrace() writes everything currently in the rings as Chrome trace_event JSON, open it in chrome://tracing or ui.perfetto.dev
+    - Names must be string literals (or otherwise live for the whole program), only the pointer is stored
+*/
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start; // Nanoseconds since the profiler started
+    uint64_t end;
+    uint32_t depth;
+};
+
+class Profiler {
+    public:
+        static void setThreadName(const char* name);
+        static void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+        static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static bool exportChromeTrace(const char* file_path);
+
+        static uint64_t getTime();
+
+        // Used by ProfileScope
+        static uint32_t beginScope();
+        static void endScope(const char* name, uint64_t start, uint32_t depth);
+
+        // Adds an event measured on the GPU, already converted to profiler time, to the "GPU" track. Only one thread may call this
+        static void recordGpuEvent(const char* name, uint64_t start, uint64_t end, uint32_t depth);
+
+    private:
+        static const uint32_t EVENTS_PER_THREAD = 64 * 1024; // Power of two
+
+        struct ThreadBuffer {
+            std::unique_ptr<ProfileEvent[]> events;
+            std::atomic<uint64_t> write_index{0}; // Only written by the owning thread
+            uint32_t thread_id;
+            std::atomic<const char*> thread_name{nullptr};
+            const char* category; // "cpu" for thread buffers, "gpu" for the GPU timestamp track
+            uint32_t depth = 0;
+        };
+
+        static ThreadBuffer& getThreadBuffer();
+        static ThreadBuffer* createBuffer(const char* name, const char* category);
+        static void writeEvent(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end, uint32_t depth);
+
+        static std::atomic<bool> s_enabled;
+        static std::mutex s_buffers_mutex; // Only taken when a thread records its first event and when exporting
+        static std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+        static thread_local ThreadBuffer* s_thread_buffer;
+        static ThreadBuffer* s_gpu_buffer;
+};
+
+class ProfileScope {
+    public:
+        ProfileScope(const char* name) : m_name(name) {
+            if (!Profiler::isEnabled()) return;
+            m_depth = Profiler::beginScope();
+            m_start = Profiler::getTime();
+            m_active = true;
+        }
+
+        ~ProfileScope() {
+            if (m_active) Profiler::endScope(m_name, m_start, m_depth);
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_start = 0;
+        uint32_t m_depth = 0;
+        bool m_active = false;
+};
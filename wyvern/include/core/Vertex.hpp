@@ -1,6 +1,62 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cstdint>
+
+/*
+    VERTEX FORMATS:
+    - Vertex fetch bandwidth grows with the size of a vertex, and full precision floats for everything is far more than most attributes need
+    - Vertex3D: position only, what the object shader draws
+    - VertexStatic: full precision position, normal, uv and tangent (48 bytes), what meshes are built in before being quantized
+    - VertexQuantized: the same attributes in 20 bytes
+        - Position is 16 bit unorm per axis relative to the mesh's bounding box, the vertex shader moves it back with the mesh's VertexDequantization
+          Precision is the bounding box size / 65535, e.g. 0.03 mm on a 2 m object
+        - Normal and tangent are octahedral encoded, a unit vector folded onto a square so it only needs 2 components, 16 bit snorm each
+        - The tangent's handedness goes in the spare w component of the position (0 or 1)
+        - UVs are half floats, plenty for coordinates in [0, 1] and exact for whole texels up to 2048
+    - InstanceData: not a vertex but read like one, once per instance of an instanced draw (a transform and 4 floats of parameters)
+    The Vulkan attribute descriptions for each format live in VulkanVertexLayout.hpp
+*/
 
 struct Vertex3D {
     glm::vec3 position;
-};
\ No newline at end of file
+};
+
+struct VertexStatic {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+    glm::vec4 tangent; // w is the handedness, +1 or -1
+};
+
+struct VertexQuantized {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+    int16_t tangent[2];
+};
+static_assert(sizeof(VertexQuantized) == 20, "VertexQuantized should be tightly packed");
+
+// Takes a mesh's quantized positions back to object space, position = offset + unorm position * scale. vec4s so it matches the push constant block in the shader
+struct VertexDequantization {
+    glm::vec4 offset = glm::vec4(0.0f);
+    glm::vec4 scale = glm::vec4(1.0f);
+};
+
+// Per instance input of object_instanced.vert, draws point at it and the renderer copies it into the frame's instance ring
+struct InstanceData {
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 params = glm::vec4(0.0f); // Free for the material to use, the object shader tints by xyz
+};
+
+class VertexQuantizer {
+    public:
+        // Quantizes a whole mesh, out_vertices needs room for vertex_count vertices
+        static VertexDequantization quantize(const VertexStatic* vertices, uint32_t vertex_count, VertexQuantized* out_vertices);
+        static VertexQuantized quantize(const VertexStatic& vertex, const VertexDequantization& dequantization);
+
+        static glm::vec2 encodeOctahedral(const glm::vec3& direction); // Direction has to be normalized, result is in [-1, 1]
+        static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+        static uint16_t floatToHalf(float value);
+        static int16_t floatToSnorm16(float value);
+        static uint16_t floatToUnorm16(float value);
+};
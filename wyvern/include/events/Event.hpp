@@ -1,41 +1,145 @@
 #pragma once
 
-#include <string>
-#include <typeindex>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
 #include "core/Logger.hpp"
+#include "core/LinearAllocator.hpp"
 
-struct Event {
-    public:
-        virtual ~Event() = default;
+/*
+    EVENT IDS:
+    - Every event type has a compile time ID (static constexpr EventID ID) which directly indexes the dispatcher's listener table, so there is no hashing or RTTI
+    - Engine events use the IDs below, games should number their own events from EVENT_ID_GAME_START
+    - Events are plain data: no virtual functions, and they must be trivially copyable so they can be queued in an arena
+*/
+
+using EventID = uint32_t;
+
+enum EngineEventID : EventID {
+    EVENT_ID_KEY_PRESSED = 0,
+    EVENT_ID_WINDOW_RESIZE,
+    EVENT_ID_WINDOW_CLOSE,
+
+    EVENT_ID_GAME_START = 32,
+};
+
+static const EventID MAX_EVENT_TYPES = 128;
+
+struct Event {};
+
+// Returned when registering a listener, pass it back to unregisterListener
+struct ListenerHandle {
+    EventID event_id = 0;
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool isValid() const { return slot != UINT32_MAX; }
 };
 
+/*
+    EVENT DISPATCHER:
+    - Listeners for each event type are stored in one contiguous array in registration order, each is a function pointer plus an instance pointer
+      rather than a std::function, so dispatching is a loop of plain indirect calls
+    - A listener returns true if it handled the event fully, which stops propagation to later listeners
+    - Handles go through a slot table with generations so they stay valid while other listeners are added or removed, and a stale handle is harmless
+    - dispatch() calls listeners immediately, queue() copies the event into a per-frame arena and processQueue() dispatches everything queued in one batch
+      Window and input callbacks queue their events so nothing runs inside glfwPollEvents
+*/
+
 class EventDispatcher {
     public:
-        using EventCallbackFn = std::function<bool(Event&)>; // Input event, output is true if event is handled fully
-        using EventID = std::type_index;
+        using ListenerFn = bool (*)(void* instance, const void* event);
+
+        EventDispatcher();
+        ~EventDispatcher();
 
+        // Member function listener, e.g. registerListener<WindowCloseEvent, &Application::onWindowClose>(this)
+        template<typename EventType, auto Method, typename Class>
+        ListenerHandle registerListener(Class* instance) {
+            return addListener(checkID<EventType>(), instance, [](void* object, const void* event) -> bool {
+                return (static_cast<Class*>(object)->*Method)(*static_cast<const EventType*>(event));
+            });
+        }
+
+        // Free function or captureless lambda listener
         template<typename EventType>
-        void registerListener(EventCallbackFn callback) {
-            auto& listeners = m_listeners[typeid(EventType)];
-            listeners.push_back(callback);
-            Logger::debug("Added listener to event: %s", typeid(EventType).name());
+        ListenerHandle registerListener(bool (*function)(const EventType&)) {
+            return addListener(checkID<EventType>(), reinterpret_cast<void*>(function), [](void* object, const void* event) -> bool {
+                return reinterpret_cast<bool (*)(const EventType&)>(object)(*static_cast<const EventType*>(event));
+            });
         }
 
+        void unregisterListener(ListenerHandle& handle);
+
         template<typename EventType>
-        void unregisterListener(EventCallbackFn callback) {
-            // To implement
+        void dispatch(const EventType& event) {
+            dispatchRaw(checkID<EventType>(), &event);
         }
 
-        void dispatch(Event& event) {
-            // Logger::debug("Firing event: %s", typeid(event).name());
-            auto it = m_listeners.find(typeid(event));
-            if (it != m_listeners.end()) {
-                for (auto& listener : it->second) {
-                    if (listener(event)) break; // stop propagation if handled
-                }
-            }
+        // Safe to call from any thread, events are dispatched on the thread that calls processQueue
+        template<typename EventType>
+        void queue(const EventType& event) {
+            static_assert(std::is_trivially_copyable_v<EventType>, "Queued events must be trivially copyable");
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            QueuedEvent* queued = static_cast<QueuedEvent*>(m_queues[m_write_queue].allocate(sizeof(QueuedEvent) + sizeof(EventType), alignof(std::max_align_t)));
+            queued->event_id = checkID<EventType>();
+            queued->next = nullptr;
+            new (queued + 1) EventType(event);
+
+            if (m_queue_tail) m_queue_tail->next = queued;
+            else m_queue_head = queued;
+            m_queue_tail = queued;
         }
 
+        void processQueue();
+
     private:
-        std::unordered_map<EventID, std::vector<EventCallbackFn>> m_listeners;
-};
\ No newline at end of file
+        static const size_t QUEUE_ARENA_SIZE = 64 * 1024;
+
+        struct Listener {
+            ListenerFn function;
+            void* instance;
+            uint32_t slot;
+        };
+
+        struct Slot {
+            uint32_t index; // Position in the listener array, or the next free slot when unused
+            uint32_t generation;
+        };
+
+        struct ListenerList {
+            std::vector<Listener> listeners;
+            std::vector<Slot> slots;
+            uint32_t free_slot = UINT32_MAX;
+            bool needs_compact = false;
+        };
+
+        // Header in front of each queued event, the event itself follows it in the arena
+        struct alignas(std::max_align_t) QueuedEvent {
+            EventID event_id;
+            QueuedEvent* next;
+        };
+
+        template<typename EventType>
+        static constexpr EventID checkID() {
+            static_assert(EventType::ID < MAX_EVENT_TYPES, "Event ID out of range, increase MAX_EVENT_TYPES");
+            return EventType::ID;
+        }
+
+        ListenerHandle addListener(EventID id, void* instance, ListenerFn function);
+        void dispatchRaw(EventID id, const void* event);
+        void compact(ListenerList& list);
+
+        ListenerList m_lists[MAX_EVENT_TYPES];
+        uint32_t m_dispatch_depth = 0; // Listeners removed while dispatching are only nulled out, and compacted once the outermost dispatch returns
+        bool m_needs_compact = false;
+
+        // Two arenas so events queued while the queue is being processed go into the next batch
+        LinearAllocator m_queues[2];
+        uint32_t m_write_queue = 0;
+        QueuedEvent* m_queue_head = nullptr;
+        QueuedEvent* m_queue_tail = nullptr;
+        std::mutex m_queue_mutex;
+};
@@ -3,14 +3,18 @@
 #include "events/Event.hpp"
 
 struct KeyPressedEvent : Event { 
+    static constexpr EventID ID = EVENT_ID_KEY_PRESSED;
     int key; 
     int action;
     KeyPressedEvent(int _key, int _action) : key(_key), action(_action) {}
 };
 
 struct WindowResizeEvent : Event { 
+    static constexpr EventID ID = EVENT_ID_WINDOW_RESIZE;
     int width, height; 
     WindowResizeEvent(int w, int h) : width(w), height(h) {}
 };
 
-struct WindowCloseEvent : Event { };
\ No newline at end of file
+struct WindowCloseEvent : Event {
+    static constexpr EventID ID = EVENT_ID_WINDOW_CLOSE;
+};
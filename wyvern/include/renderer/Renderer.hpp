@@ -5,11 +5,45 @@
 
 class Renderer {
     public:
-        static void init(const char* appName, Window* window);
+        static void init(const char* appName, Window* window, uint32_t headless_width = 0, uint32_t headless_height = 0, const SwapchainConfig& swapchain_config = SwapchainConfig()); // Null window for headless
         static void shutdown();
 
         static void drawFrame(RenderPacket& renderPacket);
         static void onWindowResize(u_int16_t width, u_int16_t height);
+
+        // Per frame scratch memory for code running on the render thread, everything in it is released a few frames later
+        static LinearAllocator& getFrameArena() { return s_backend.getFrameArena(); }
+
+        /*
+            Geometry and pipelines for the draws in a RenderPacket, these can be called from the main thread while the render thread is drawing
+            Uploads are only staged on the calling thread, the render thread submits the copies with its next frame (see VulkanStagingRing.hpp)
+        */
+        template<typename Vertex>
+        static VulkanMesh uploadMesh(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) { return s_backend.uploadMesh(vertices, vertex_count, indices, index_count); }
+        static void freeMesh(const VulkanMesh& mesh) { s_backend.freeMesh(mesh); }
+        static VulkanMesh getMesh(uint32_t id) { return s_backend.getMesh(id); }
+        template<typename Vertex>
+        static UploadToken updateMeshVertices(const VulkanMesh& mesh, const Vertex* vertices, uint32_t vertex_count) { return s_backend.updateMeshVertices(mesh, vertices, vertex_count); }
+        // Moves meshes to close up freed space, cached draw commands have to be fetched again with getMesh() when the generation changes
+        static uint32_t compactGeometry(VkDeviceSize max_bytes) { return s_backend.compactGeometry(max_bytes); }
+        static uint64_t getGeometryGeneration() { return s_backend.getGeometryGeneration(); }
+        static VulkanGeometryStats getGeometryStats() { return s_backend.getGeometryStats(); }
+        static const VulkanPipelineDescription& getDefaultPipelineDescription() { return s_backend.getDefaultPipelineDescription(); }
+        static const VulkanPipelineDescription& getQuantizedPipelineDescription() { return s_backend.getQuantizedPipelineDescription(); }
+        static const VulkanPipelineDescription& getInstancedPipelineDescription() { return s_backend.getInstancedPipelineDescription(); }
+        static const VulkanPipelineDescription& getIndirectPipelineDescription() { return s_backend.getIndirectPipelineDescription(); }
+        static VulkanPipeline* getPipeline(const VulkanPipelineDescription& description) { return s_backend.getPipeline(description); }
+        static const char* getDeviceName() { return s_backend.getDeviceName(); }
+
+        // Instances culled and drawn entirely on the GPU, see VulkanGpuScene.hpp
+        static uint32_t addInstance(const VulkanMesh& mesh, const glm::vec4& bounds, const glm::vec3& position, float scale = 1.0f, const VulkanPipelineDescription* pipeline_description = nullptr) { return s_backend.addInstance(mesh, bounds, position, scale, pipeline_description); }
+        static void removeInstance(uint32_t id) { s_backend.removeInstance(id); }
+        static void setInstanceTransform(uint32_t id, const glm::vec3& position, float scale) { s_backend.setInstanceTransform(id, position, scale); }
+        static void setCullingViewProjection(const glm::mat4& view_projection) { s_backend.setCullingViewProjection(view_projection); }
+        static uint32_t getInstanceCount() { return s_backend.getInstanceCount(); }
+
+        // GPU frame and renderpass timings, read them from the same thread that calls drawFrame
+        static const VulkanGpuProfiler& getGpuProfiler() { return s_backend.getGpuProfiler(); }
     
     private:
         static VulkanBackend s_backend;
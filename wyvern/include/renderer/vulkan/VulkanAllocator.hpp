@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+/*
+    DEVICE MEMORY ALLOCATOR:
+    - Drivers only allow a limited number of live vkAllocateMemory calls (maxMemoryAllocationCount, often 4096), and each call is a round trip into the kernel
+    - So instead of every buffer and image owning its own VkDeviceMemory, we allocate large blocks per memory type and hand out sub-ranges of them
+    - Sub-allocation inside a block uses TLSF (two level segregated fit), which finds a free range in O(1) using two levels of bitmaps:
+        - First level splits free ranges by power of two size class
+        - Second level linearly subdivides each power of two range into SL_COUNT buckets
+    - Resources that are very large get their own dedicated VkDeviceMemory, as there is nothing to be gained by sharing a block with them
+    - bufferImageGranularity is the granularity at which linear (buffers, linear images) and optimal (tiled images) resources may sit next to each other in memory
+      When it is bigger than 1 we keep linear and optimal resources in separate blocks so they can never alias within a page
+    - Allocations never move between blocks, a VkBuffer/VkImage can only be bound to memory once. Fragmentation is dealt with by the owners instead,
+      e.g. VulkanGeometryPool::compact packs meshes inside its own buffers
+*/
+
+struct VulkanContext;
+class VulkanMemoryBlock;
+
+struct VulkanAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // Host pointer to the start of this allocation if memory is host visible (blocks are persistently mapped)
+    uint32_t memory_type = 0;
+
+    VulkanMemoryBlock* block = nullptr; // Null for dedicated allocations
+    uint32_t chunk = UINT32_MAX; // Handle of the TLSF chunk within the block
+
+    bool isValid() const { return memory != VK_NULL_HANDLE; }
+    bool isDedicated() const { return block == nullptr; }
+};
+
+struct VulkanHeapStats {
+    VkDeviceSize heap_size = 0;
+    VkDeviceSize block_bytes = 0; // Memory reserved from the driver
+    VkDeviceSize used_bytes = 0; // Memory handed out to resources
+    uint32_t block_count = 0;
+    uint32_t allocation_count = 0;
+    uint32_t dedicated_count = 0;
+};
+
+class VulkanMemoryBlock {
+    public:
+        bool create(VkDevice device, uint32_t memory_type, VkDeviceSize size, bool is_linear, bool is_host_visible);
+        void destroy(VkDevice device);
+
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, VulkanAllocation& out_allocation);
+        void free(uint32_t chunk);
+
+        VkDeviceSize getSize() const { return m_size; }
+        VkDeviceSize getUsedBytes() const { return m_used; }
+        uint32_t getAllocationCount() const { return m_allocation_count; }
+        uint32_t getMemoryType() const { return m_memory_type; }
+        bool isLinear() const { return m_is_linear; }
+        bool isEmpty() const { return m_allocation_count == 0; }
+
+    private:
+        static const uint32_t SL_LOG2 = 4;
+        static const uint32_t SL_COUNT = 1 << SL_LOG2;
+        static const uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+        static const uint32_t NO_CHUNK = UINT32_MAX;
+        static const VkDeviceSize MIN_CHUNK_SIZE = 64; // Don't split off free ranges smaller than this
+
+        struct Chunk {
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            uint32_t prev_phys = NO_CHUNK; // Neighbours in address order, used to merge on free
+            uint32_t next_phys = NO_CHUNK;
+            uint32_t prev_free = NO_CHUNK; // Neighbours in the segregated free list
+            uint32_t next_free = NO_CHUNK;
+            bool is_free = true;
+        };
+
+        static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+        uint32_t findFreeChunk(VkDeviceSize size);
+        void insertFree(uint32_t chunk);
+        void removeFree(uint32_t chunk);
+        uint32_t splitChunk(uint32_t chunk, VkDeviceSize size); // Returns the new chunk after the first size bytes
+        uint32_t newChunk();
+        VulkanAllocation makeAllocation(uint32_t chunk) const;
+
+        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        void* m_mapped = nullptr;
+        VkDeviceSize m_size = 0;
+        VkDeviceSize m_used = 0;
+        uint32_t m_memory_type = 0;
+        uint32_t m_allocation_count = 0;
+        bool m_is_linear = true;
+
+        std::vector<Chunk> m_chunks;
+        std::vector<uint32_t> m_unused_chunks; // Recycled entries of m_chunks
+        uint32_t m_first_chunk = NO_CHUNK;
+
+        uint64_t m_fl_bitmap = 0;
+        uint32_t m_sl_bitmap[FL_COUNT] = {};
+        uint32_t m_free_heads[FL_COUNT][SL_COUNT];
+};
+
+class VulkanAllocator {
+    public:
+        void create(VulkanContext& context, VkPhysicalDevice physical_device, VkDevice device);
+        void destroy();
+
+        // is_linear is true for buffers and linear tiled images, false for optimal tiled images
+        VulkanAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool is_linear);
+        void free(VulkanAllocation& allocation);
+
+        std::vector<VulkanHeapStats> getHeapStats();
+        void logStats();
+
+    private:
+        uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
+        VkDeviceSize preferredBlockSize(uint32_t memory_type);
+        VulkanAllocation allocateDedicated(VkDeviceSize size, uint32_t memory_type);
+        VulkanAllocation allocateFromBlocks(const VkMemoryRequirements& requirements, uint32_t memory_type, bool is_linear);
+        void releaseEmptyBlocks(bool keep_one);
+
+        VulkanContext* m_context;
+        VkDevice m_device = VK_NULL_HANDLE;
+
+        VkPhysicalDeviceMemoryProperties m_memory_properties;
+        VkDeviceSize m_buffer_image_granularity = 1;
+        VkDeviceSize m_non_coherent_atom_size = 1;
+        uint32_t m_max_allocation_count = 0;
+        uint32_t m_device_allocation_count = 0; // Live vkAllocateMemory calls
+
+        std::vector<std::unique_ptr<VulkanMemoryBlock>> m_blocks;
+        std::vector<VulkanAllocation> m_dedicated;
+        std::mutex m_mutex;
+};
@@ -9,18 +9,53 @@
 #include "renderer/vulkan/VulkanSwapchain.hpp"
 #include "renderer/vulkan/VulkanRenderpass.hpp"
 #include "renderer/vulkan/VulkanFence.hpp"
+#include "renderer/vulkan/VulkanFrameTimeline.hpp"
+#include "renderer/vulkan/VulkanDeletionQueue.hpp"
 #include "renderer/vulkan/shaders/VulkanObjectShader.hpp"
 #include "renderer/vulkan/VulkanPipeline.hpp"
+#include "renderer/vulkan/VulkanPipelineStateCache.hpp"
 #include "renderer/vulkan/VulkanBuffer.hpp"
+#include "renderer/vulkan/VulkanGeometryPool.hpp"
+#include "renderer/vulkan/VulkanStagingRing.hpp"
+#include "renderer/vulkan/VulkanDrawRecorder.hpp"
+#include "renderer/vulkan/VulkanGpuScene.hpp"
+#include "renderer/vulkan/VulkanInstanceRing.hpp"
+#include "core/Logger.hpp"
+#include "renderer/vulkan/VulkanGpuProfiler.hpp"
+#include "core/LinearAllocator.hpp"
+#include "core/Vertex.hpp"
 
 class Window;
 
+/*
+    Everything the renderer needs for one frame. With pipelined rendering the packet is written by the main thread and then read by the render thread,
+    so it has to be a self contained copy and must not point at game state that keeps changing
+*/
 struct RenderPacket {
     float deltaTime;
+    uint64_t frame_number = 0;
+
+    // Set if the window was resized since the last packet, the size is queried on the main thread because GLFW isn't thread safe
+    bool framebuffer_resized = false;
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+
+    // Set if the present mode, image count or frames in flight were changed since the last packet
+    bool swapchain_config_changed = false;
+    SwapchainConfig swapchain_config;
+
+    double input_time = 0.0; // Clock time the frame's input was polled at, for measuring input to present latency
+
+    const char* capture_path = nullptr; // If set this frame is read back and written to this path as a PPM, only supported when headless
+
+    // Draws for this frame, the memory has to stay untouched until the renderer has consumed the packet. Without any draws the test triangle is drawn
+    const VulkanDrawCommand* draws = nullptr;
+    uint32_t draw_count = 0;
 };
 
 struct VulkanContext {
     Window* window;
+    bool headless = false; // Rendering into offscreen images, there is no window, surface or VkSwapchainKHR
 
     VkInstance instance = VK_NULL_HANDLE;
     VkSurfaceKHR surface = VK_NULL_HANDLE;
@@ -34,12 +69,23 @@ struct VulkanContext {
     VulkanSwapchain swapchain;
     VulkanRenderpass renderpass;
 
-    std::vector<VulkanCommandBuffer> commandBuffers;
+    std::vector<VulkanCommandBuffer> commandBuffers; // One per frame in flight
 
     std::vector<VkSemaphore> image_acquire_semaphores; // Ensure it doesn't start rendering until the acquired image is actually available
     std::vector<VkSemaphore> queue_submit_semaphores; // Present image until after rendering has completed
-    std::vector<VulkanFence> in_flight_fences; // Fence per frame in flight         
-    std::vector<VulkanFence*> images_in_flight; // Pointer per swapchain image
+
+    /*
+        Frame pacing goes through the frame timeline, each frame in flight only remembers the timeline value it was last submitted with
+        Command buffers and everything else that gets reused are per frame in flight rather than per swapchain image,
+        so an image coming back out of order doesn't need its own wait, the acquire semaphore already orders writes to it after its last present
+    */
+    VulkanFrameTimeline frame_timeline;
+    std::vector<uint64_t> frame_values;
+    VulkanDeletionQueue deletion_queue; // Vulkan objects waiting for the frames that might use them to retire
+
+    // Everything the current frame's submission waits on, the image acquire plus any uploads from the transfer queue
+    std::vector<VkSemaphore> frame_wait_semaphores;
+    std::vector<VkPipelineStageFlags> frame_wait_stages;
 
     unsigned int framebuffer_width;
     unsigned int framebuffer_height;
@@ -47,7 +93,7 @@ struct VulkanContext {
 
     /*
         We want to allow multiple frames to be 'in-flight' at once so we can render one frame while recording the next frame. If CPU finishes early it can wait for GPU to finish rendering work before submitting more work.
-        This means we also need to duplicate any resource that is accessed and modified during rendering, so things like command buffers, semaphores and fences
+        This means we also need to duplicate any resource that is accessed and modified during rendering, so things like command buffers and semaphores
         Default is that 2 in flight frames is enough
     */
     unsigned int max_frames_in_flight;
@@ -56,42 +102,129 @@ struct VulkanContext {
 
     // Shader stuff
     VulkanObjectShader object_shader;
-    VulkanPipeline pipeline;
+    VulkanObjectShader quantized_object_shader; // Same shader reading VertexQuantized, draws push their mesh's VertexDequantization
+    VulkanObjectShader instanced_object_shader; // Vertex3D plus InstanceData per instance, for draws with instance data
+    VulkanPipelineStateCache pipeline_states;
+
+    VulkanStagingRing staging_ring;
+
+    VulkanDrawRecorder draw_recorder;
+    VulkanInstanceRing instance_ring;
+
+    VulkanGpuProfiler gpu_profiler;
+    uint32_t renderpass_gpu_scope = UINT32_MAX;
+
+    // Transient CPU memory, one arena per frame in flight, reset in beginFrame once the frame has retired
+    std::vector<std::unique_ptr<LinearAllocator>> frame_arenas;
+
+    # if defined(_DEBUG)
+        uint32_t frames_since_recreate = 0; // Arenas are expected to grow while things warm up after (re)creation
+    # endif
+
+    VulkanBuffer readback_buffer; // Created the first time a frame is captured
+    VkDeviceSize readback_size = 0;
+
+    VulkanGeometryPool geometry; // Vertex and index buffers every mesh is sub-allocated from
+    VulkanMesh test_triangle; // First mesh in the pool, so compacting never moves it
 
-    VulkanBuffer object_vertex_buffer;
-    VulkanBuffer object_index_buffer;
-    uint32_t geometry_vertex_offset;
-    uint32_t geometry_index_offset;
+    VulkanGpuScene gpu_scene; // Instances culled and drawn on the GPU, alongside the packet's draws
 };
 
 class VulkanBackend {
     public:
-        void init(const char* appName, Window* window);
+        // Pass a null window to render headless into offscreen images of the given size
+        void init(const char* appName, Window* window, uint32_t headless_width = 0, uint32_t headless_height = 0, const SwapchainConfig& swapchain_config = SwapchainConfig());
         void shutdown();
-        void drawFrame(float dt) {
-            if (beginFrame(dt)) endFrame(dt);
+        void drawFrame(const RenderPacket& packet) {
+            if (beginFrame(packet)) endFrame(packet.deltaTime);
         }
 
         void onWindowResize(int width, int height);
+        void onFramebufferResize(int width, int height);
+        // Recreates the swapchain before the next frame, call it from the thread that draws frames
+        void setSwapchainConfig(const SwapchainConfig& config) {
+            m_context.swapchain.setConfig(config);
+            m_context.window_resized = true;
+        }
+
+        // Reads the next frame back and writes it to a PPM file, this waits for the GPU so only use it for tests and screenshots
+        void captureNextFrame(const char* path) { m_capture_path = path; }
         
-        void uploadDataRange(void* data, VulkanBuffer& buffer, VkDeviceSize size, VkQueue queue);
+        UploadToken uploadDataRange(const void* data, VulkanBuffer& buffer, VkDeviceSize offset, VkDeviceSize size);
+
+        // Meshes are sub-allocated from the geometry pool, see VulkanGeometryPool.hpp. mesh.getDrawCommand() draws the whole mesh
+        template<typename Vertex>
+        VulkanMesh uploadMesh(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) { return m_context.geometry.allocate(vertices, vertex_count, indices, index_count); }
+        void freeMesh(const VulkanMesh& mesh) { m_context.geometry.free(mesh); }
+        VulkanMesh getMesh(uint32_t id) { return m_context.geometry.getMesh(id); }
+        // Overwrites the start of a mesh's vertices, nothing in flight may be drawing the mesh
+        template<typename Vertex>
+        UploadToken updateMeshVertices(const VulkanMesh& mesh, const Vertex* vertices, uint32_t vertex_count) {
+            if (sizeof(Vertex) != mesh.vertex_stride) {
+                Logger::error("Vertex size %u doesn't match the mesh's vertex stride %u", (uint32_t)sizeof(Vertex), mesh.vertex_stride);
+                return 0;
+            }
+            return m_context.geometry.updateVertices(mesh, vertices, vertex_count);
+        }
+        uint32_t compactGeometry(VkDeviceSize max_bytes) { return m_context.geometry.compact(max_bytes); }
+        uint64_t getGeometryGeneration() { return m_context.geometry.getGeneration(); }
+        VulkanGeometryStats getGeometryStats() { return m_context.geometry.getStats(); }
+
+        // A pipeline built from one of the object shaders' descriptions with some state changed, compiled in the background if it's new
+        const VulkanPipelineDescription& getDefaultPipelineDescription() { return m_context.object_shader.getDescription(); }
+        const VulkanPipelineDescription& getQuantizedPipelineDescription() { return m_context.quantized_object_shader.getDescription(); } // For meshes of VertexQuantized
+        const VulkanPipelineDescription& getInstancedPipelineDescription() { return m_context.instanced_object_shader.getDescription(); } // For draws with instance data
+        const VulkanPipelineDescription& getIndirectPipelineDescription() { return m_context.gpu_scene.getPipelineDescription(); } // For GPU scene instances
+        VulkanPipeline* getPipeline(const VulkanPipelineDescription& description) {
+            // Until it's compiled draws fall back to the base pipeline reading the same vertex format (and descriptor sets)
+            VulkanObjectShader* shader = &m_context.object_shader;
+            if (m_context.quantized_object_shader.ownsPipelineDescription(description)) shader = &m_context.quantized_object_shader;
+            else if (m_context.instanced_object_shader.ownsPipelineDescription(description)) shader = &m_context.instanced_object_shader;
+            else if (m_context.gpu_scene.getShader().ownsPipelineDescription(description)) shader = &m_context.gpu_scene.getShader();
+            return m_context.pipeline_states.get(description, shader->getPipeline());
+        }
+
+        // GPU driven instances, see VulkanGpuScene.hpp. These can be called from any thread
+        uint32_t addInstance(const VulkanMesh& mesh, const glm::vec4& bounds, const glm::vec3& position, float scale = 1.0f, const VulkanPipelineDescription* pipeline_description = nullptr) { return m_context.gpu_scene.addInstance(mesh, bounds, position, scale, pipeline_description); }
+        void removeInstance(uint32_t id) { m_context.gpu_scene.removeInstance(id); }
+        void setInstanceTransform(uint32_t id, const glm::vec3& position, float scale) { m_context.gpu_scene.setInstanceTransform(id, position, scale); }
+        void setCullingViewProjection(const glm::mat4& view_projection) { m_context.gpu_scene.setViewProjection(view_projection); }
+        uint32_t getInstanceCount() { return m_context.gpu_scene.getInstanceCount(); }
+
+        const char* getDeviceName() { return m_context.device.getProperties().deviceName; }
+        bool isUploadComplete(UploadToken token) { return m_context.staging_ring.isComplete(token); }
+
+        // Timeline value of the frame currently being recorded, anything used by it can be released once isFrameRetired returns true for this value
+        uint64_t getCurrentFrameValue() { return m_context.frame_timeline.getNextValue(); }
+        bool isFrameRetired(uint64_t frame_value) { return m_context.frame_timeline.isRetired(frame_value); }
+
+        // Only valid until the same frame in flight comes around again
+        LinearAllocator& getFrameArena() { return *m_context.frame_arenas[m_context.current_frame]; }
+
+        // Updated on the thread that draws frames
+        const VulkanGpuProfiler& getGpuProfiler() { return m_context.gpu_profiler; }
 
     private:
         VulkanContext m_context;
+        const char* m_capture_path = nullptr;
 
-        bool beginFrame(float dt);
+        bool beginFrame(const RenderPacket& packet);
         void endFrame(float dt);
 
         void createInstance(const char* appName);
         void createDebugCallback();
 
         void createCommandBuffers();
-        void createSyncObjects();
-        void createBuffers();
+        void createFrameSyncObjects();
+        void createPresentSemaphores();
+        void createFrameArenas();
         void recreateSwapchain();
 
         void cleanupSyncObjects();
 
+        void recordCapture(VulkanCommandBuffer& command_buffer);
+        bool writeCapture(const char* path);
+
         std::vector<const char*> getRequiredInstanceExtensions();
         std::vector<const char*> getLayers();
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "renderer/vulkan/VulkanAllocator.hpp"
+
 struct VulkanContext;
 
 class VulkanBuffer {
@@ -9,20 +11,22 @@ class VulkanBuffer {
         void create(VulkanContext& context, VkDeviceSize size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_property_flags, bool bind_on_create = 1);
         void destroy();
         void bind(VkDeviceSize offset = 0);
-        void loadData(const void* data, VkDeviceSize offset = 0);
+        void loadData(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
 
         void copyBufferFrom(VulkanBuffer& src_buffer, VkQueue queue, VkDeviceSize size, VkDeviceSize src_offset = 0, VkDeviceSize dst_offset = 0);
         void copyBufferTo(VulkanBuffer& dst_buffer, VkQueue queue, VkDeviceSize size, VkDeviceSize src_offset = 0, VkDeviceSize dst_offset = 0);
 
         VkBuffer& getHandle() { return m_buffer; }
+        const VulkanAllocation& getAllocation() const { return m_allocation; }
+        VkDeviceSize getSize() const { return m_size; }
     
     private:
         void copyBufferToFrom(VkBuffer src_buffer, VkBuffer dst_buffer, VkQueue queue, VkDeviceSize size, VkDeviceSize src_offset = 0, VkDeviceSize dst_offset = 0);
 
         VulkanContext* m_context;
 
-        VkBuffer m_buffer;
-        VkDeviceMemory m_memory;
+        VkBuffer m_buffer = VK_NULL_HANDLE;
+        VulkanAllocation m_allocation; // Sub-range of a device memory block owned by the allocator
         VkDeviceSize m_size;
 
         bool is_bound;
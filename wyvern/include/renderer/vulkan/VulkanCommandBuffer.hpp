@@ -29,6 +29,8 @@ class VulkanCommandBuffer {
         void free();
 
         void beginRecording(bool is_single_use = 0, bool is_renderpass_continue = 0, bool is_simultaneous_use = 0);
+        // Secondary buffers that continue a renderpass need to know which renderpass, subpass and framebuffer they will execute in
+        void beginRecordingSecondary(VkRenderPass renderpass, uint32_t subpass, VkFramebuffer framebuffer, bool is_single_use = 1);
         void endRecording();
     
         void allocateAndBeginSingleUse(VulkanContext& context, VkCommandPool& commandPool);
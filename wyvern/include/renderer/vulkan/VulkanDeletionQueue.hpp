@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+
+#include "renderer/vulkan/VulkanAllocator.hpp"
+
+/*
+    DEFERRED DELETION:
+    - A Vulkan object can't be destroyed while a submitted frame may still use it. Waiting for the device to go idle makes that safe but drains the whole GPU
+    - Instead, destroying something hands its handles to the deletion queue along with the frame timeline value of the frame being recorded
+    - Once a frame has started recording, the backend calls collect(), which destroys everything whose frame has retired on the timeline
+      Entries are queued in frame order, so it only ever looks at the front of the queue
+    - The push functions can be called from any thread (e.g. the main thread streaming out assets while the render thread draws), collect only from the thread that draws frames
+    - flush() destroys everything right away and is only for shutdown, after the device has gone idle
+*/
+
+struct VulkanContext;
+
+class VulkanDeletionQueue {
+    public:
+        void create(VulkanContext& context);
+        void destroy(); // Flushes whatever is left
+
+        void pushBuffer(VkBuffer buffer);
+        void pushImage(VkImage image);
+        void pushImageView(VkImageView image_view);
+        void pushFramebuffer(VkFramebuffer framebuffer);
+        void pushPipeline(VkPipeline pipeline);
+        void pushPipelineLayout(VkPipelineLayout pipeline_layout);
+        void pushSwapchain(VkSwapchainKHR swapchain);
+        void pushSemaphore(VkSemaphore semaphore);
+        void pushAllocation(const VulkanAllocation& allocation);
+
+        void collect();
+        void flush();
+
+        size_t getPendingCount();
+
+    private:
+        enum class ResourceType {
+            BUFFER,
+            IMAGE,
+            IMAGE_VIEW,
+            FRAMEBUFFER,
+            PIPELINE,
+            PIPELINE_LAYOUT,
+            SWAPCHAIN,
+            SEMAPHORE,
+            ALLOCATION
+        };
+
+        struct Entry {
+            ResourceType type;
+            uint64_t frame_value; // Safe to destroy once this frame has retired
+            union {
+                VkBuffer buffer;
+                VkImage image;
+                VkImageView image_view;
+                VkFramebuffer framebuffer;
+                VkPipeline pipeline;
+                VkPipelineLayout pipeline_layout;
+                VkSwapchainKHR swapchain;
+                VkSemaphore semaphore;
+            };
+            VulkanAllocation allocation;
+        };
+
+        void pushEntry(Entry& entry);
+        void destroyEntry(Entry& entry);
+
+        VulkanContext* m_context;
+
+        std::vector<Entry> m_entries; // In frame order, entries before m_first have been destroyed
+        size_t m_first = 0;
+        std::mutex m_mutex;
+};
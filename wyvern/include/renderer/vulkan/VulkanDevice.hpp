@@ -5,12 +5,15 @@
 #include <string>
 #include <set>
 
+#include "renderer/vulkan/VulkanAllocator.hpp"
+
 struct VulkanContext;
 
 struct QueueFamilyIndices {
     // optional is wrapper that contains no value until something is assigned
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // Only set if the device has a queue family for transfers that isn't the graphics family
     bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 };
 
@@ -26,6 +29,9 @@ class VulkanDevice {
         void destroy();
 
         VkDevice& getLogicalDevice() { return m_logicalDevice; }
+        VkPhysicalDevice getPhysicalDevice() { return m_physicalDevice; }
+        const VkPhysicalDeviceProperties& getProperties() { return properties; }
+        VulkanAllocator& getAllocator() { return m_allocator; }
         SwapChainSupportDetails getSwapchainSupportDetails() { return m_swapChainSupport; }
         QueueFamilyIndices getQueueFamilyIndices() { return m_queueFamilyIndices; }
         VkFormat getDepthFormat() { return m_depth_format; }
@@ -33,8 +39,32 @@ class VulkanDevice {
         VkQueue& getGraphicsQueue() { return m_graphicsQueue; }
         VkQueue& getPresentQueue() { return m_presentQueue; }
 
+        // Falls back to the graphics queue and command pool when there is no separate transfer family
+        bool hasDedicatedTransferQueue() { return m_queueFamilyIndices.transferFamily.has_value(); }
+        VkCommandPool& getTransferCommandPool() { return hasDedicatedTransferQueue() ? m_transferCommandPool : m_graphicsCommandPool; }
+        VkQueue& getTransferQueue() { return hasDedicatedTransferQueue() ? m_transferQueue : m_graphicsQueue; }
+
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
+        // VK_KHR_timeline_semaphore is enabled if the driver has it, the wait/counter functions have to be loaded through vkGetDeviceProcAddr
+        bool hasTimelineSemaphores() { return m_timeline_semaphores; }
+
+        /*
+            Indirect drawing support, see VulkanGpuScene.hpp
+            - VK_KHR_draw_indirect_count is enabled if the driver has it, vkCmdDrawIndexedIndirectCountKHR has to be loaded through vkGetDeviceProcAddr
+            - multiDrawIndirect and drawIndirectFirstInstance are turned on when supported, getEnabledFeatures() says which ones are
+        */
+        bool hasDrawIndirectCount() { return m_draw_indirect_count; }
+        const VkPhysicalDeviceFeatures& getEnabledFeatures() { return m_enabled_features; }
+
+        /*
+            Driver compiled pipelines are kept in a VkPipelineCache which is saved to disk, so later launches don't compile everything from scratch again
+            The file is only valid for the exact GPU and driver that wrote it, so it's keyed by vendor/device ID and driver version and its header is checked on load
+        */
+        VkPipelineCache getPipelineCache() { return m_pipeline_cache; }
+        bool isPipelineCacheWarm() { return m_pipeline_cache_warm; }
+        void savePipelineCache();
+
     private:
         bool selectPhysicalDevice(VkInstance& instance, VkSurfaceKHR& surface);
         bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR& surface);
@@ -43,10 +73,17 @@ class VulkanDevice {
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR& surface);
 
         void createLogicalDevice(VkSurfaceKHR& surface);
+        bool checkTimelineSemaphoreSupport();
+        bool checkDrawIndirectCountSupport();
         std::vector<const char*> getRequiredDeviceExtensions();
         void createGraphicsCommandPool();
+        void createTransferCommandPool();
 
         void findSupportedDepthFormat();
+
+        void createPipelineCache();
+        std::string getPipelineCachePath();
+        bool isPipelineCacheDataValid(const std::vector<char>& data);
         
         VulkanContext* m_context;
 
@@ -56,6 +93,7 @@ class VulkanDevice {
         VkDevice m_logicalDevice;
         VkQueue m_graphicsQueue;
         VkQueue m_presentQueue;
+        VkQueue m_transferQueue = VK_NULL_HANDLE;
 
         SwapChainSupportDetails m_swapChainSupport;
 
@@ -64,8 +102,17 @@ class VulkanDevice {
         VkPhysicalDeviceMemoryProperties memory;
 
         VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+        VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+
+        VulkanAllocator m_allocator;
+
+        VkPipelineCache m_pipeline_cache = VK_NULL_HANDLE;
+        bool m_pipeline_cache_warm = false; // True if the cache was seeded from a valid file
 
         VkFormat m_depth_format;
+        bool m_timeline_semaphores = false;
+        bool m_draw_indirect_count = false;
+        VkPhysicalDeviceFeatures m_enabled_features = {};
 
         std::vector<const char*> m_deviceExtensions = { 
             VK_KHR_SWAPCHAIN_EXTENSION_NAME // For presenting images to window 
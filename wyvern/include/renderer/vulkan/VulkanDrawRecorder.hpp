@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+
+/*
+    PARALLEL COMMAND RECORDING:
+    - Recording thousands of draws into a single command buffer on the main thread quickly becomes the CPU bottleneck
+    - Vulkan lets any thread record commands, as long as no two threads use the same command pool at the same time
+    - So every batch of the frame's draws gets its own command pool per frame in flight, and is recorded into a secondary command buffer as a job
+    - The primary command buffer begins the renderpass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS and runs the batches in order with vkCmdExecuteCommands
+    - Pools are reset as a whole once the frame has retired on the frame timeline, which is cheaper than resetting each command buffer
+*/
+
+struct VulkanContext;
+struct VertexDequantization;
+struct InstanceData;
+class VulkanPipeline;
+
+struct VulkanDrawCommand {
+    uint32_t index_count;
+    uint32_t instance_count = 1;
+    uint32_t first_index = 0;
+    int32_t vertex_offset = 0;
+    uint32_t first_instance = 0;
+    uint32_t geometry_page = 0; // Page of the geometry pool the mesh is in, batches only rebind the buffers when this changes
+    VulkanPipeline* pipeline = nullptr; // Null draws with the object shader, batches only rebind when this changes
+    const VertexDequantization* dequantization = nullptr; // Pushed for meshes of VertexQuantized, has to stay alive until the packet is drawn
+    const InstanceData* instance = nullptr; // instance_count of them, set to batch the draw with every other draw of the same mesh and pipeline (see VulkanInstanceRing.hpp)
+};
+
+class VulkanDrawRecorder {
+    public:
+        void create(VulkanContext& context, uint32_t frame_count);
+        void destroy();
+
+        // Records draws into secondary command buffers for the given frame in flight and executes them from primary
+        void record(uint32_t frame, VulkanCommandBuffer& primary, VkFramebuffer framebuffer, const VulkanDrawCommand* draws, size_t draw_count);
+
+        uint32_t getThreadCount() { return m_thread_count; }
+
+    private:
+        static const uint32_t MAX_THREADS = 8;
+        static const uint32_t MIN_DRAWS_PER_BATCH = 256; // Smaller batches aren't worth the cost of another thread
+
+        struct ThreadData {
+            VkCommandPool command_pool = VK_NULL_HANDLE;
+            VulkanCommandBuffer command_buffer;
+        };
+
+        void recordBatch(ThreadData& thread_data, VkFramebuffer framebuffer, const VulkanDrawCommand* draws, size_t draw_count);
+
+        VulkanContext* m_context;
+        uint32_t m_thread_count = 1;
+        uint32_t m_frame_count = 0;
+
+        std::vector<ThreadData> m_thread_data; // m_frame_count * m_thread_count, indexed by frame first
+};
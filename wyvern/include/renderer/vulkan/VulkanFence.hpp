@@ -26,6 +26,7 @@ class VulkanFence {
         void destroy();
 
         bool wait(uint64_t nanosec);
+        bool poll(); // Non-blocking check if the fence has been signaled
         void reset();
 
         VkFence& getHandle() { return m_fence; }
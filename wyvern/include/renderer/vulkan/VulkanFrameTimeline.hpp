@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <thread>
+
+#include "renderer/vulkan/VulkanFence.hpp"
+
+/*
+    FRAME TIMELINE:
+    - Every submitted frame gets the next value of a counter that starts at 1, and the GPU signals that value once it has finished the frame
+    - With timeline semaphores the counter is a single VkSemaphore, the frame's submission signals it with the frame's value
+        - Waiting for a frame is vkWaitSemaphores on its value, so everything waits on one object no matter how many frames are in flight
+        - Asking whether frame X has retired is reading the counter, which never blocks. Anything that has to outlive the GPU's use of it
+          (staging memory, resources waiting to be destroyed, per frame data) only needs to remember the frame value it was last used in
+    - Acquire and present only take binary semaphores, so the swapchain still keeps its own
+    - Drivers without timeline semaphores fall back to a small ring of fences, frame X signals fence X % FENCE_COUNT
+        - Frames are all submitted to the graphics queue and finish in order, so once frame X's fence has signalled every frame before it has retired too
+        - A fence is waited on before it's reused, so a frame whose fence slot has moved on has retired
+*/
+
+struct VulkanContext;
+
+class VulkanFrameTimeline {
+    public:
+        void create(VulkanContext& context);
+        void destroy();
+
+        // Submits to the queue with this frame's value signalled on top of submit_info's own semaphores, returns the frame's value (0 if the submit failed)
+        uint64_t submit(VkQueue queue, const VkSubmitInfo& submit_info);
+
+        bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+        /*
+            Never blocks, and can be called from any thread
+            With the fence fallback only the thread submitting frames polls the fences (they're reset when they're reused), other threads see what it last saw
+        */
+        bool isRetired(uint64_t value) { return value <= m_completed_value.load(std::memory_order_acquire) || value <= pollCompletedValue(); }
+
+        uint64_t getNextValue() const { return m_next_value; } // Value the next submitted frame will signal
+        uint64_t getLastSubmittedValue() const { return m_next_value - 1; }
+        uint64_t pollCompletedValue(); // Highest frame value the GPU has finished, any thread like isRetired
+
+        bool usesTimelineSemaphore() const { return m_timeline != VK_NULL_HANDLE; }
+        VkSemaphore getSemaphore() const { return m_timeline; } // For other queues to wait on a frame value, null with the fence fallback
+
+    private:
+        static const uint32_t FENCE_COUNT = 8; // Fallback only, more frames than this in flight just means waiting on the oldest one before reusing its fence
+        static const uint32_t MAX_SIGNAL_SEMAPHORES = 8;
+
+        VulkanContext* m_context;
+
+        void advanceCompletedValue(uint64_t value);
+
+        std::atomic<uint64_t> m_next_value{1}; // Read from other threads to tag resources with the frame that may use them
+        std::atomic<uint64_t> m_completed_value{0}; // Cached, only ever goes up
+        std::atomic<std::thread::id> m_submit_thread; // The only thread that touches the fences
+
+        // Timeline semaphore path
+        VkSemaphore m_timeline = VK_NULL_HANDLE;
+        PFN_vkWaitSemaphoresKHR m_wait_semaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValueKHR m_get_counter_value = nullptr;
+
+        // Fence fallback
+        VulkanFence m_fences[FENCE_COUNT];
+        uint64_t m_fence_values[FENCE_COUNT] = {}; // Frame value each fence was last submitted with, 0 if never
+};
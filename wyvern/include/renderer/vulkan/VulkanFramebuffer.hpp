@@ -11,12 +11,12 @@ struct VulkanContext;
 
 class VulkanFramebuffer {
     public:
-        void create(VulkanContext& context, uint32_t width, uint32_t height, const std::vector<VkImageView>& imageViews);
+        void create(VulkanContext& context, uint32_t width, uint32_t height, const VkImageView* imageViews, uint32_t imageViewCount);
         void destroy();
         VkFramebuffer& getHandle() { return m_framebuffer; }
 
     private:
         VulkanContext* m_context;
 
-        VkFramebuffer m_framebuffer;
+        VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
 };
\ No newline at end of file
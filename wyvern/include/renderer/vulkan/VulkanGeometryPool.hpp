@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "renderer/vulkan/VulkanBuffer.hpp"
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+#include "renderer/vulkan/VulkanDrawRecorder.hpp"
+#include "renderer/vulkan/VulkanStagingRing.hpp"
+#include "core/Vertex.hpp"
+
+/*
+    GEOMETRY POOL:
+    - Every mesh lives in a few big vertex and index buffers shared by everything, so a batch of draws binds them once and each draw only picks its range with firstIndex and vertexOffset
+    - A page is one vertex buffer plus one index buffer. Ranges in each buffer are handed out by an offset allocator:
+        - The free ranges are kept sorted by offset, allocating takes the lowest one that fits so meshes pack towards the start of the page
+        - Meshes can use any vertex format (see Vertex.hpp). vertexOffset counts in vertices of the pipeline's stride, so vertex ranges start at a multiple of their mesh's stride
+        - Freeing merges the range with its free neighbours, so freeing everything always ends with one free range again
+    - When no page has room for a mesh another page is added, a mesh's vertices and indices always share a page
+      The recorder only rebinds the buffers when the page changes between draws, so keep draws from the same page together (almost everything ends up in page 0 anyway)
+    - Frames in flight may still be drawing a freed mesh, so its ranges only go back to the allocators once those frames have retired on the frame timeline
+    - compact() moves meshes into free space lower down with GPU copies, so holes left by freed meshes close up and pages at the end empty out and get released
+      A mesh keeps its id when it moves, but its draw command changes. getGeneration() goes up on every move, so anything caching draw commands knows to fetch them again with getMesh()
+*/
+
+struct VulkanContext;
+
+struct VulkanMesh {
+    uint32_t id = UINT32_MAX; // Stays the same when the mesh is moved
+    uint32_t page = 0;
+    uint32_t first_index = 0;
+    int32_t vertex_offset = 0;
+    uint32_t index_count = 0;
+    uint32_t vertex_count = 0;
+    uint32_t vertex_stride = 0; // Size of the mesh's vertex format, has to match the pipeline it's drawn with
+
+    bool isValid() const { return id != UINT32_MAX; }
+
+    VulkanDrawCommand getDrawCommand() const {
+        VulkanDrawCommand draw;
+        draw.index_count = index_count;
+        draw.first_index = first_index;
+        draw.vertex_offset = vertex_offset;
+        draw.geometry_page = page;
+        return draw;
+    }
+};
+
+struct VulkanGeometryStats {
+    uint32_t page_count = 0;
+    uint32_t mesh_count = 0;
+    uint64_t vertex_bytes_capacity = 0;
+    uint64_t vertex_bytes_used = 0;
+    uint64_t index_capacity = 0;
+    uint64_t indices_used = 0;
+    uint32_t free_ranges = 0; // Across both buffers of every page, a rough measure of fragmentation
+};
+
+class VulkanGeometryPool {
+    public:
+        // Page sizes are in bytes of vertex data and in indices
+        void create(VulkanContext& context, uint32_t page_vertex_bytes, uint32_t page_index_count);
+        void destroy();
+
+        // These can be called from any thread. The returned mesh is invalid if it doesn't even fit in an empty page
+        VulkanMesh allocate(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count);
+        template<typename Vertex>
+        VulkanMesh allocate(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) { return allocate(vertices, vertex_count, sizeof(Vertex), indices, index_count); }
+        void free(const VulkanMesh& mesh);
+        VulkanMesh getMesh(uint32_t id); // Where the mesh is now
+        // Overwrites the start of a mesh's vertices, nothing in flight may be drawing the mesh and it must not have been moved since the last frame started
+        UploadToken updateVertices(const VulkanMesh& mesh, const void* vertices, uint32_t vertex_count);
+
+        // Moves up to max_bytes of geometry lower down, returns how many meshes moved. Meshes whose upload hasn't finished yet stay where they are
+        uint32_t compact(VkDeviceSize max_bytes);
+        uint64_t getGeneration() const { return m_generation.load(std::memory_order_acquire); }
+
+        VulkanGeometryStats getStats();
+
+        // Only from the thread that draws frames
+        void collect(); // Releases ranges and pages whose frames have retired
+        void recordMoves(VulkanCommandBuffer& command_buffer); // Copies for meshes moved since the last frame, must be outside the renderpass
+        void bind(VkCommandBuffer command_buffer, uint32_t page);
+
+    private:
+        static const uint32_t MAX_PAGES = 16;
+
+        class RangeAllocator {
+            public:
+                void create(uint32_t size);
+                bool allocate(uint32_t size, uint32_t alignment, uint32_t& out_offset); // Alignment doesn't have to be a power of two
+                void free(uint32_t offset, uint32_t size);
+
+                uint32_t getUsed() const { return m_size - m_free_total; }
+                uint32_t getFreeRangeCount() const { return static_cast<uint32_t>(m_free.size()); }
+
+            private:
+                struct Range {
+                    uint32_t offset;
+                    uint32_t size;
+                };
+
+                std::vector<Range> m_free; // Sorted by offset, never two touching ranges
+                uint32_t m_size = 0;
+                uint32_t m_free_total = 0;
+        };
+
+        struct Page {
+            VulkanBuffer vertex_buffer;
+            VulkanBuffer index_buffer;
+            RangeAllocator vertices;
+            RangeAllocator indices;
+            uint32_t range_count = 0; // Ranges in use by meshes or waiting to be released, the page can go once this is 0
+            bool in_use = false;
+        };
+
+        struct MeshEntry {
+            VulkanMesh mesh;
+            UploadToken upload = 0;
+            bool live = false;
+        };
+
+        enum RangeKind { VERTICES, INDICES };
+
+        struct PendingFree {
+            uint64_t frame_value; // Released once this frame has retired
+            uint32_t page;
+            RangeKind kind;
+            uint32_t offset; // In bytes for vertices, in indices for indices
+            uint32_t size;
+        };
+
+        struct PendingMove {
+            VkBuffer src_buffer;
+            VkBuffer dst_buffer;
+            VkBufferCopy region;
+        };
+
+        bool allocateInPage(uint32_t page, uint32_t vertex_count, uint32_t vertex_stride, uint32_t index_count, uint32_t& out_vertex_byte_offset, uint32_t& out_first_index);
+        bool createPage(uint32_t& out_page);
+        uint64_t getRetireValue();
+        void retireRange(uint32_t page, RangeKind kind, uint32_t offset, uint32_t size);
+        bool moveRange(MeshEntry& entry, uint32_t src_page, uint32_t dst_page, RangeKind kind, uint32_t dst_offset); // dst_offset in allocator units
+
+        VulkanContext* m_context;
+        uint32_t m_page_vertex_bytes = 0;
+        uint32_t m_page_index_count = 0;
+
+        Page m_pages[MAX_PAGES]; // Fixed so the render thread can bind a page while another thread adds one
+        std::vector<MeshEntry> m_meshes;
+        std::vector<uint32_t> m_free_ids;
+        std::vector<PendingFree> m_pending_frees; // In frame order
+        std::vector<PendingMove> m_pending_moves;
+        std::atomic<uint64_t> m_generation{0};
+        std::mutex m_mutex;
+};
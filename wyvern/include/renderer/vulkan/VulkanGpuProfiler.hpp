@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+
+/*
+    GPU PROFILING:
+    - The GPU runs behind the CPU, so CPU timers can't tell how long the GPU spent on a frame. Instead the command buffer writes timestamps into a query pool
+    - There is one query pool per frame in flight. A frame's timestamps are read back in beginFrame right after the frame has been waited on,
+      so the results are always ready and reading them never stalls
+    - Timestamps are in ticks, VkPhysicalDeviceLimits::timestampPeriod is the number of nanoseconds per tick
+    - The whole frame and the renderpass are always timed, other code can add named scopes with beginScope/endScope (names must be string literals)
+    - Finished scopes are also sent to the CPU profiler as a "GPU" track, shifted so each frame's GPU work starts after the CPU submitted it
+*/
+
+struct VulkanContext;
+
+struct GpuScopeTiming {
+    const char* name;
+    double start_ms; // Relative to the start of the frame
+    double duration_ms;
+    uint32_t depth;
+};
+
+class VulkanGpuProfiler {
+    public:
+        void create(VulkanContext& context, uint32_t frame_count);
+        void destroy();
+
+        // Reads back the results from the last time this frame was in flight, only call once the frame has retired
+        void collect(uint32_t frame);
+
+        // beginFrame has to be recorded outside a renderpass since it resets the frame's queries
+        void beginFrame(VulkanCommandBuffer& command_buffer, uint32_t frame);
+        void endFrame(VulkanCommandBuffer& command_buffer);
+        void onSubmit(); // Remembers the CPU time of the submit to line the GPU track up with the CPU one
+
+        uint32_t beginScope(VulkanCommandBuffer& command_buffer, const char* name);
+        void endScope(VulkanCommandBuffer& command_buffer, uint32_t scope);
+
+        bool isSupported() { return m_supported; }
+
+        // Rolling history of whole frame GPU times in milliseconds, oldest first, most recent last
+        static const uint32_t HISTORY_SIZE = 240;
+        uint32_t getHistory(float* out_ms, uint32_t max_count) const;
+        float getLastFrameTime() const { return m_history_count ? m_history[(m_history_next + HISTORY_SIZE - 1) % HISTORY_SIZE] : 0.0f; }
+        float getAverageFrameTime() const;
+        uint64_t getCollectedFrameCount() const { return m_collected_frames; } // Goes up by one every time a frame's results are read back
+
+        // Scopes of the most recently collected frame
+        const std::vector<GpuScopeTiming>& getLastFrameScopes() const { return m_last_scopes; }
+
+    private:
+        static const uint32_t MAX_SCOPES = 64; // Per frame, scopes past this are ignored
+
+        struct Scope {
+            const char* name;
+            uint32_t depth;
+            bool closed; // Scopes still open at endFrame are closed there, so every query has been written by the time it's read back
+        };
+
+        struct FrameQueries {
+            VkQueryPool pool = VK_NULL_HANDLE;
+            std::vector<Scope> scopes; // Scope i writes queries 2i and 2i+1
+            uint64_t cpu_submit_time = 0; // Profiler::getTime() when the frame was submitted
+            bool submitted = false;
+        };
+
+        VulkanContext* m_context;
+        bool m_supported = false;
+        double m_ns_per_tick = 1.0;
+        uint64_t m_timestamp_mask = ~0ull;
+
+        std::vector<FrameQueries> m_frames;
+        FrameQueries* m_recording = nullptr;
+        uint32_t m_depth = 0;
+
+        std::vector<uint64_t> m_results; // Scratch space for vkGetQueryPoolResults
+        std::vector<GpuScopeTiming> m_last_scopes;
+        int64_t m_gpu_to_cpu_offset = INT64_MIN; // Added to GPU nanoseconds to get profiler time
+
+        float m_history[HISTORY_SIZE] = {};
+        uint32_t m_history_next = 0;
+        uint32_t m_history_count = 0;
+        uint64_t m_collected_frames = 0;
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <glm/glm.hpp>
+
+#include "renderer/vulkan/VulkanBuffer.hpp"
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+#include "renderer/vulkan/VulkanGeometryPool.hpp"
+#include "renderer/vulkan/shaders/VulkanObjectShader.hpp"
+#include "core/Vertex.hpp"
+
+/*
+    GPU DRIVEN RENDERING:
+    - Recording a draw per object keeps the CPU busy with work the GPU could do itself, so instances added here never go through the draw recorder
+    - Every instance (a mesh, its bounds and where it is) lives in a storage buffer. Each frame a compute shader (cull.comp) tests the bounds against the
+      frustum and writes a VkDrawIndexedIndirectCommand for every visible instance, firstInstance is the instance's index so the vertex shader can find it
+    - Instances are grouped into buckets of the same pipeline and geometry page, and each bucket is drawn with one indirect draw:
+        - With VK_KHR_draw_indirect_count the shader appends visible instances to their bucket and counts them, and vkCmdDrawIndexedIndirectCountKHR
+          reads the count on the GPU, so the CPU never knows how many draws there are
+        - Without it every instance keeps its slot and culled ones get instanceCount 0, which still costs the GPU a little per culled draw
+    - Buffers are per frame in flight, so changing instances never touches a buffer an earlier frame is still reading. The instance list is only uploaded
+      to a frame's buffers when it has changed since that frame was last drawn
+    - The vertex shader (object_indirect.vert) reads Vertex3D and places it with the instance's position and scale. Pipeline descriptions for instances
+      have to start from getIndirectPipelineDescription() so they have the instance buffer's descriptor set
+    - Instances keep their pipeline description rather than a pipeline, and every build looks it up in the pipeline state cache again.
+      Until a pipeline has compiled in the background its instances draw with the indirect object shader, and then move over to it
+    - Needs drawIndirectFirstInstance, without it addInstance() returns UINT32_MAX
+*/
+
+struct VulkanContext;
+
+// Same layout as Instance in cull.comp and object_indirect.vert (std430)
+struct VulkanGpuInstance {
+    glm::vec4 position_scale; // xyz is added to the mesh's vertices after scaling them by w
+    glm::vec4 bounding_sphere; // Where the instance is, xyz centre and w radius
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t bucket;
+};
+static_assert(sizeof(VulkanGpuInstance) == 48, "VulkanGpuInstance has to match the shaders");
+
+class VulkanGpuScene {
+    public:
+        // Needs the pipeline state cache and renderpass. shader_dir has cull.comp.spv and object_indirect.vert.spv
+        void create(VulkanContext& context, uint32_t frame_count, const std::string& shader_dir);
+        void destroy(); // After the device is idle
+        void recreateFrames(uint32_t frame_count); // Frames in flight changed, nothing may be in flight
+
+        // Bounds are the mesh's bounding sphere before position and scale are applied, e.g. from computeBounds
+        // Without a pipeline description the instance is drawn with the indirect object shader
+        uint32_t addInstance(const VulkanMesh& mesh, const glm::vec4& bounds, const glm::vec3& position, float scale = 1.0f, const VulkanPipelineDescription* pipeline_description = nullptr);
+        void removeInstance(uint32_t id);
+        void setInstanceTransform(uint32_t id, const glm::vec3& position, float scale);
+        void setViewProjection(const glm::mat4& view_projection); // Frustum instances are culled against, identity culls to clip space
+        uint32_t getInstanceCount();
+
+        template<typename Vertex>
+        static glm::vec4 computeBounds(const Vertex* vertices, uint32_t vertex_count);
+
+        bool isSupported() { return m_supported; }
+        const VulkanPipelineDescription& getPipelineDescription() { return m_shader.getDescription(); }
+        VulkanObjectShader& getShader() { return m_shader; }
+
+        // Only from the thread that draws frames, in this order
+        void update(uint32_t frame); // Uploads the instances to the frame's buffers if they changed, before the staging ring is flushed
+        bool hasDraws(uint32_t frame) { return !m_frames[frame].buckets.empty(); }
+        void recordCull(uint32_t frame, VulkanCommandBuffer& command_buffer); // Outside the renderpass
+        void recordDraws(uint32_t frame, VulkanCommandBuffer& primary, VkFramebuffer framebuffer); // Inside a renderpass begun for secondary command buffers
+
+    private:
+        static const uint32_t MIN_INSTANCE_CAPACITY = 1024;
+        static const uint32_t MIN_BUCKET_CAPACITY = 64;
+        static const uint32_t WORKGROUP_SIZE = 64; // local_size_x in cull.comp
+
+        struct Instance {
+            uint32_t mesh_id;
+            glm::vec4 bounds;
+            glm::vec3 position;
+            float scale;
+            uint32_t material; // Index into m_materials, UINT32_MAX for the indirect object shader
+            bool live = false;
+        };
+
+        // A pipeline description shared by instances, and the pipeline it resolved to in the last build
+        struct Material {
+            uint64_t hash; // VulkanPipelineStateCache::hash, to find the material again when more instances use the same description
+            VulkanPipelineDescription description;
+            VulkanPipeline* pipeline = nullptr; // The indirect object shader until the real one has compiled
+        };
+
+        // Instances [first, first + count) in the sorted list, their draws go in the same range of the command buffer
+        struct Bucket {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        struct BucketDraw {
+            VulkanPipeline* pipeline;
+            uint32_t page;
+            Bucket range;
+        };
+
+        struct CullConstants {
+            glm::vec4 planes[6];
+            uint32_t instance_count;
+            uint32_t use_count; // Append to buckets and count, or zero culled draws in place
+        };
+
+        struct Frame {
+            VulkanBuffer instance_buffer;
+            VulkanBuffer bucket_buffer;
+            VulkanBuffer command_buffer; // VkDrawIndexedIndirectCommand per instance
+            VulkanBuffer count_buffer; // Draw count per bucket
+            uint32_t instance_capacity = 0;
+            uint32_t bucket_capacity = 0;
+            VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+            VkCommandPool command_pool = VK_NULL_HANDLE;
+            VulkanCommandBuffer draw_commands; // Secondary
+
+            uint64_t version = 0; // Of the instance list last uploaded
+            uint32_t instance_count = 0;
+            std::vector<BucketDraw> buckets;
+        };
+
+        void createFrames(uint32_t frame_count);
+        void destroyFrames();
+        void createFrameBuffers(Frame& frame, uint32_t instance_capacity, uint32_t bucket_capacity);
+        void writeDescriptorSet(Frame& frame);
+        void createCullPipeline(const std::string& path);
+        void drawBucket(VkCommandBuffer command_buffer, Frame& frame, uint32_t bucket);
+        void build();
+        bool resolveMaterials(); // Returns true if any material's pipeline changed
+
+        VulkanContext* m_context;
+        bool m_supported = false;
+        bool m_use_count = false;
+        uint32_t m_max_draw_count = 1;
+        PFN_vkCmdDrawIndexedIndirectCountKHR m_draw_indexed_indirect_count = nullptr;
+
+        VkDescriptorSetLayout m_descriptor_set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+        VkPipelineLayout m_cull_layout = VK_NULL_HANDLE;
+        VkPipeline m_cull_pipeline = VK_NULL_HANDLE;
+        VulkanShaderStage m_cull_stage = {};
+        VulkanObjectShader m_shader;
+
+        std::vector<Frame> m_frames;
+
+        // Written from any thread under the mutex, build() turns them into the sorted lists the frames upload
+        std::mutex m_mutex;
+        std::vector<Instance> m_instances;
+        std::vector<uint32_t> m_free_ids;
+        std::vector<Material> m_materials; // Only ever grows, a scene uses a handful
+        glm::vec4 m_planes[6];
+        uint64_t m_version = 1; // Bumped on every change to the instances
+        uint64_t m_built_version = 0;
+        uint64_t m_geometry_generation = 0;
+
+        std::vector<VulkanGpuInstance> m_sorted_instances;
+        std::vector<BucketDraw> m_buckets;
+        std::vector<Bucket> m_bucket_ranges; // What the cull shader reads
+};
+
+template<typename Vertex>
+glm::vec4 VulkanGpuScene::computeBounds(const Vertex* vertices, uint32_t vertex_count) {
+    // Centre of the bounding box, not the tightest sphere but close enough for culling
+    if (vertex_count == 0) return glm::vec4(0.0f);
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (uint32_t i = 1; i < vertex_count; i++) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    glm::vec3 centre = (min + max) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < vertex_count; i++) radius = glm::max(radius, glm::length(vertices[i].position - centre));
+    return glm::vec4(centre, radius);
+}
@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "renderer/vulkan/VulkanAllocator.hpp"
+
 /*
     A VkImage is basically GPU memory allocated for storing pixel data (like color, depth, etc.)
     A VkImageView is literally a view into the image, which describes how to access image and which part of the image to access (e.g. should it be treated as a 2D texture depth without any mipmapping levels?)
@@ -15,13 +17,14 @@ class VulkanImage {
         void createImageView(VkFormat format, VkImageAspectFlags view_aspect_flags);
         void destroy();
 
+        VkImage& getHandle() { return m_image; }
         VkImageView& getImageView() { return m_imageView; }
 
     private:
         VulkanContext* m_context;
-        VkImage m_image;
-        VkImageView m_imageView;
-        VkDeviceMemory m_deviceMemory;
+        VkImage m_image = VK_NULL_HANDLE;
+        VkImageView m_imageView = VK_NULL_HANDLE;
+        VulkanAllocation m_allocation;
 
         int m_width;
         int m_height;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "renderer/vulkan/VulkanBuffer.hpp"
+#include "renderer/vulkan/VulkanDrawRecorder.hpp"
+#include "core/LinearAllocator.hpp"
+#include "core/Vertex.hpp"
+
+/*
+    HARDWARE INSTANCING:
+    - A forest or a crowd is thousands of copies of the same mesh, and a draw per copy makes the CPU record thousands of draws that only differ in a transform
+    - Draws that set VulkanDrawCommand::instance are batched instead: every draw of the same mesh, pipeline and dequantization in the packet is merged
+      into one vkCmdDrawIndexed with instance_count set to the number of copies
+        - The InstanceData of the merged draws is copied into this frame's instance buffer, one contiguous run per batch, in packet order
+        - The buffer is bound at binding 1, which instanced pipelines read at VK_VERTEX_INPUT_RATE_INSTANCE (see addInstanceLayout), and each batch's
+          firstInstance is the start of its run, so no buffer is rebound between batches
+        - A batch is drawn where the first of its draws was, so instanced draws are assumed not to depend on their order (opaque, depth tested)
+        - Their pipelines have to read the instance binding, i.e. come from getInstancedPipelineDescription(). Without a pipeline they use the instanced object shader
+    - The buffers are host visible and written directly, one per frame in flight so a frame never overwrites instances the GPU is still reading.
+      If a frame needs more instances than fit, that frame's buffer is replaced with a bigger one, the old one goes through the deletion queue
+    - Draws without instance data are passed through untouched
+*/
+
+struct VulkanContext;
+
+class VulkanInstanceRing {
+    public:
+        void create(VulkanContext& context, uint32_t frame_count, uint32_t instances_per_frame);
+        void destroy();
+        void recreateFrames(uint32_t frame_count); // Frames in flight changed, nothing may be in flight
+
+        /*
+            Merges the instanced draws in draws and writes their instances to the frame's buffer, returns the draws to record (from arena)
+            Only from the thread that draws frames, after the frame has retired
+        */
+        const VulkanDrawCommand* batch(uint32_t frame_index, LinearAllocator& arena, const VulkanDrawCommand* draws, size_t draw_count, size_t& out_draw_count);
+
+        // Binds the buffer of the last frame batched at binding 1, from any thread recording that frame
+        void bind(VkCommandBuffer command_buffer);
+
+        uint32_t getLastInstanceCount() const { return m_last_instance_count; }
+        uint32_t getLastBatchCount() const { return m_last_batch_count; }
+
+    private:
+        static const uint32_t INSTANCE_BINDING = 1;
+
+        struct Frame {
+            VulkanBuffer buffer;
+            InstanceData* mapped = nullptr;
+            uint32_t capacity = 0;
+        };
+
+        void createFrameBuffer(Frame& frame, uint32_t capacity);
+
+        VulkanContext* m_context;
+        uint32_t m_instances_per_frame = 0;
+        std::vector<Frame> m_frames;
+        uint32_t m_current_frame = 0;
+
+        uint32_t m_last_instance_count = 0;
+        uint32_t m_last_batch_count = 0;
+};
@@ -2,20 +2,66 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
 
 #include "VulkanCommandBuffer.hpp"
 
 struct VulkanContext;
 
+struct VulkanPipelineShaderStage {
+    VkShaderStageFlagBits stage;
+    VkShaderModule module;
+    std::string entry_point = "main";
+};
+
+/*
+    Everything that gets baked into a graphics pipeline
+    Viewport, scissor and line width are dynamic state, so they aren't part of the description
+    The defaults are the opaque, back face culled, depth tested state we use for regular geometry
+*/
+struct VulkanPipelineDescription {
+    std::vector<VulkanPipelineShaderStage> stages;
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+    std::vector<VkPushConstantRange> push_constant_ranges;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    bool depth_test = true;
+    bool depth_write = true;
+    VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+
+    bool blend_enable = false;
+    VkBlendFactor src_color_blend = VK_BLEND_FACTOR_SRC_ALPHA;
+    VkBlendFactor dst_color_blend = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    VkBlendOp color_blend_op = VK_BLEND_OP_ADD;
+    VkBlendFactor src_alpha_blend = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dst_alpha_blend = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp alpha_blend_op = VK_BLEND_OP_ADD;
+
+    // Pipelines can be used with any renderpass compatible with this one
+    VkRenderPass renderpass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+};
+
 class VulkanPipeline {
     public:
-        void create(VulkanContext& context, const std::vector<VkVertexInputAttributeDescription>& attributes, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const std::vector<VkPipelineShaderStageCreateInfo>& stages, VkViewport viewport, VkRect2D scissor, bool is_wireframe);
+        bool create(VulkanContext& context, const VulkanPipelineDescription& description);
         void destroy();
         void bind(VulkanCommandBuffer& command_buffer, VkPipelineBindPoint bind_point);
 
+        VkPipelineLayout getLayout() { return m_pipeline_layout; }
+        // Whether the layout has push constants covering [0, size) for stage, pushing outside them is invalid
+        bool hasPushConstants(VkShaderStageFlags stage, uint32_t size) const;
+
     private:
         VulkanContext* m_context;
+        std::vector<VkPushConstantRange> m_push_constant_ranges;
 
-        VkPipeline m_graphics_pipeline;
-        VkPipelineLayout m_pipeline_layout;
-};
\ No newline at end of file
+        VkPipeline m_graphics_pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "renderer/vulkan/VulkanPipeline.hpp"
+#include "core/JobSystem.hpp"
+
+/*
+    PIPELINE STATE CACHE:
+    - Every combination of shaders, vertex layout, blend/depth/raster state and renderpass needs its own VkPipeline, and compiling one can take milliseconds
+    - Pipelines are looked up by a hash of their VulkanPipelineDescription, so asking for the same state twice returns the same pipeline
+    - A missing pipeline can either be compiled right away, or compiled as a job on a worker thread while the caller keeps drawing with a fallback pipeline
+      This way a new material showing up mid-frame costs a frame or two of slightly wrong shading instead of a hitch
+    - Compiles go through the device's VkPipelineCache, which is internally synchronised, so several can run at once
+*/
+
+struct VulkanContext;
+
+class VulkanPipelineStateCache {
+    public:
+        void create(VulkanContext& context);
+        void destroy();
+
+        /*
+            Returns the pipeline for the description if it's ready
+            If it isn't, a fallback means the compile is started in the background and fallback is returned (fallback should be compatible with the same vertex layout and renderpass)
+            Without a fallback the pipeline is compiled (or finished) on this thread. Returns nullptr if compiling failed
+        */
+        VulkanPipeline* get(const VulkanPipelineDescription& description, VulkanPipeline* fallback = nullptr);
+
+        static uint64_t hash(const VulkanPipelineDescription& description);
+
+    private:
+        enum class PipelineState {
+            COMPILING,
+            READY,
+            FAILED
+        };
+
+        struct Entry {
+            std::vector<uint8_t> key; // Serialised description, compared on hash collisions
+            VulkanPipelineDescription description;
+            VulkanPipeline pipeline;
+            std::atomic<PipelineState> state{PipelineState::COMPILING};
+            JobCounter compile_counter;
+        };
+
+        static void serialise(const VulkanPipelineDescription& description, std::vector<uint8_t>& out);
+        void compile(Entry& entry);
+
+        VulkanContext* m_context;
+
+        std::unordered_map<uint64_t, std::vector<std::unique_ptr<Entry>>> m_entries;
+        std::vector<uint8_t> m_key; // Scratch space for lookups, guarded by m_mutex
+        std::mutex m_mutex;
+
+        uint32_t m_hits = 0;
+        uint32_t m_misses = 0;
+};
@@ -31,7 +31,8 @@ class VulkanRenderpass {
         void create(VulkanContext& context, glm::vec2 size, glm::vec2 offset, glm::vec4 color, float depth, float stencil);
         void destroy();
 
-        void begin(VulkanCommandBuffer* commandBuffer, VkFramebuffer& framebuffer);
+        // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the renderpass may only contain vkCmdExecuteCommands
+        void begin(VulkanCommandBuffer* commandBuffer, VkFramebuffer& framebuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
         void end(VulkanCommandBuffer* commandBuffer);
 
         VkRenderPass& getHandle() { return m_renderPass; }
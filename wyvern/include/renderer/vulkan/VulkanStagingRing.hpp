@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "renderer/vulkan/VulkanBuffer.hpp"
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+#include "renderer/vulkan/VulkanFence.hpp"
+
+/*
+    STAGING RING:
+    - Device local memory can't be written by the CPU, so uploads go through host visible staging memory followed by a GPU copy
+    - Instead of creating a staging buffer per upload and waiting for the queue to go idle, we keep one persistently mapped buffer used as a ring:
+        - upload() copies data to the head of the ring and queues a VkBufferCopy region
+        - flush() records every queued region into one command buffer (one vkCmdCopyBuffer per source and destination buffer) and submits it with a fence
+        - Once a submission's fence signals, the part of the ring it used can be written again
+    - Callers get an UploadToken back, which can be polled with isComplete() rather than stalling the queue
+    - If the device has a dedicated transfer queue family, batches are submitted there so copies run alongside rendering:
+        - Buffers are owned by one queue family at a time, so each batch ends with release barriers (transfer -> graphics family)
+        - The batch signals a semaphore, and the next frame records the matching acquire barriers and waits on that semaphore
+        - Without a transfer family everything goes through the graphics queue and a plain memory barrier is enough
+    - A copy can overwrite a range that frames still in flight are reading (e.g. updating a mesh's vertices). Those uploads are marked in_use,
+      and a batch containing one first waits for the work submitted before it to finish reading. Batches of fresh ranges don't wait:
+        - On the graphics queue an execution barrier from the stages that read uploads to the transfer stage does it, the first scope of a barrier
+          covers everything submitted earlier on the queue
+        - A barrier on the transfer queue can't see the graphics queue's work, so the batch waits on the frame timeline for the last submitted frame.
+          That needs timeline semaphores, without them uploads stay on the graphics queue
+    - upload() can be called from any thread, but only the thread calling flush() (the one drawing frames) ever records or submits anything,
+      queues and command pools aren't thread safe and the graphics queue is busy with that thread's frames:
+        - When the ring is full on that thread, it flushes and waits for space like before
+        - When it's full on any other thread, the data goes to a staging buffer of its own instead, destroyed once its batch has finished.
+          Waiting there could deadlock, e.g. the main thread blocking on a render thread that is waiting for the main thread's next packet
+        - The ring records from command pools of its own, so it never shares a pool with the frame's command buffers
+*/
+
+struct VulkanContext;
+
+using UploadToken = uint64_t;
+
+class VulkanStagingRing {
+    public:
+        void create(VulkanContext& context, VkDeviceSize size);
+        void destroy();
+
+        /*
+            Copies data into the ring and queues a copy to dst_buffer, the copy happens on the next flush(). Any thread
+            in_use means frames already submitted may still read the range, so the copy has to wait for them
+        */
+        UploadToken upload(const void* data, VkDeviceSize size, VulkanBuffer& dst_buffer, VkDeviceSize dst_offset = 0, bool in_use = false);
+        // Submits all queued copies as one batch, returns the token of that batch. Only from the thread that draws frames
+        UploadToken flush();
+
+        bool isComplete(UploadToken token);
+        void wait(UploadToken token); // On other threads this also waits for the flush that submits the token
+
+        /*
+            Records the graphics queue side of the ownership transfers for every batch that hasn't been acquired yet
+            The submission containing command_buffer has to wait on the semaphores added to wait_semaphores, at the matching wait_stages
+            Must be called outside of a renderpass, does nothing without a dedicated transfer queue
+        */
+        void recordAcquires(VulkanCommandBuffer& command_buffer, std::vector<VkSemaphore>& wait_semaphores, std::vector<VkPipelineStageFlags>& wait_stages);
+
+    private:
+        static const uint32_t MAX_SUBMISSIONS = 8;
+
+        struct PendingCopy {
+            VkBuffer src_buffer; // The ring, or an overflow buffer
+            VkBuffer dst_buffer;
+            VkBufferCopy region;
+            bool in_use; // Overwrites a range earlier frames may still read
+        };
+
+        struct Submission {
+            VulkanCommandBuffer command_buffer;
+            VulkanFence fence;
+            VkSemaphore semaphore = VK_NULL_HANDLE; // Only used with a dedicated transfer queue
+            std::vector<VkBufferMemoryBarrier> acquire_barriers; // Have to match the release barriers exactly
+            bool acquire_pending = false; // Semaphore is signalled but no graphics submission has waited on it yet
+            uint64_t ring_end; // Ring head at the time of submission, everything before it is free once the fence signals
+            UploadToken token;
+            bool in_flight = false;
+            std::vector<std::unique_ptr<VulkanBuffer>> overflow_buffers; // Destroyed once the fence signals
+        };
+
+        bool reserve(VkDeviceSize size, VkDeviceSize& out_offset); // False when the ring is full and this thread can't flush to make room
+        void uploadOverflow(const char* data, VkDeviceSize size, VkBuffer dst_buffer, VkDeviceSize dst_offset, bool in_use);
+        UploadToken flushLocked();
+        void retireCompleted();
+        void waitOldest();
+        void recordAcquiresLocked(VkCommandBuffer command_buffer, std::vector<VkSemaphore>& wait_semaphores, std::vector<VkPipelineStageFlags>& wait_stages);
+        void submitAcquiresLocked();
+
+        VulkanContext* m_context;
+
+        VulkanBuffer m_buffer;
+        char* m_mapped;
+        VkDeviceSize m_capacity;
+        uint64_t m_head = 0; // Monotonic byte counters, position in the ring is counter % capacity
+        uint64_t m_tail = 0;
+
+        std::thread::id m_submit_thread; // Thread that last called flush(), the only one that submits
+        VkCommandPool m_command_pool = VK_NULL_HANDLE; // On the transfer family, for the batches
+        std::vector<PendingCopy> m_pending;
+        std::vector<std::unique_ptr<VulkanBuffer>> m_overflow_buffers; // Sources of pending copies that didn't fit in the ring
+        std::vector<VkBufferCopy> m_regions; // Scratch space for grouping regions by destination
+        Submission m_submissions[MAX_SUBMISSIONS];
+        uint32_t m_next_submission = 0;
+
+        bool m_dedicated_transfer = false;
+        uint32_t m_transfer_family;
+        uint32_t m_graphics_family;
+        std::vector<VkBufferMemoryBarrier> m_barriers; // Scratch space for release/acquire barriers
+
+        // Used to acquire batches on the graphics queue when no frame has done it before the semaphore is needed again
+        VkCommandPool m_acquire_command_pool = VK_NULL_HANDLE; // On the graphics family
+        VulkanCommandBuffer m_acquire_command_buffer;
+        VulkanFence m_acquire_fence;
+        bool m_acquire_in_flight = false;
+        std::vector<VkSemaphore> m_acquire_semaphores;
+        std::vector<VkPipelineStageFlags> m_acquire_stages;
+
+        UploadToken m_current_token = 1; // Token of the batch currently being filled
+        UploadToken m_completed_token = 0; // Every batch up to and including this one has finished
+
+        std::mutex m_mutex;
+        std::condition_variable m_flush_condition; // Notified after every submitted batch, for wait() on threads that can't flush
+};
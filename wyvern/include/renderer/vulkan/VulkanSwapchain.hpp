@@ -15,34 +15,73 @@
     - Another is queued for future presentation
 
     Every frame you have to acquire an image from the swapchain via vkAcquireImageIndex() which gives index i into swapchain image list. Then you can render into that swapchainImages[i]. To render that image you have to begin command buffer, then renderpass, draw, then end renderpass and command buffer.
+
+    RECREATION:
+    - When the window is resized the swapchain has to be recreated at the new size. The old one is passed to vkCreateSwapchainKHR as oldSwapchain,
+      which lets the presentation engine hand over to the new one and finish showing the old images without us waiting for it
+    - The old swapchain, its views, framebuffers and the depth image are all retired through the deletion queue, so nothing here waits for the GPU
+
+    CONFIGURATION:
+    - The present mode decides how frames queue up for the display, and with it throughput against latency:
+        - FIFO is vsync, the app is held to the refresh rate and every queued image adds a refresh of latency
+        - MAILBOX is vsync without the queue, newer images replace queued ones so the app renders as fast as it can and the newest frame is shown
+        - IMMEDIATE doesn't wait for vblank at all, the lowest latency but it tears
+      Only FIFO is guaranteed to exist, anything else the surface doesn't support falls back to it
+    - More images lets the app get further ahead of the display, and frames in flight is how many of those the CPU can be recording or the GPU rendering at once
+      Each extra frame in flight smooths out spikes but is another frame between input and the screen
+    - Changing the config recreates the swapchain like a resize does
+
+    HEADLESS:
+    - Without a window there is no surface to make a VkSwapchainKHR for, so the swapchain owns a few plain offscreen images instead and hands them out in turn
+    - Acquiring doesn't signal the semaphore and presenting does nothing, the backend skips both semaphores when headless
+    - The images can be copied from, so frames can be read back
 */
 
 struct VulkanContext;
 
+struct SwapchainConfig {
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t image_count = 0; // 0 is one more than the surface's minimum, clamped to what the surface supports
+    uint32_t frames_in_flight = 0; // 0 is one less than the image count, clamped to [1, image count]
+};
+
 class VulkanSwapchain {
     public:
         void create(uint32_t width, uint32_t height, VulkanContext& context);
         void recreate(uint32_t width, uint32_t height);
         void destroy();
         VkResult acquireNextImageIndex(VkSemaphore image_available_semaphore, uint32_t* out_image_index);
-        void present(VkQueue presentQueue, VkSemaphore signalSemaphores, uint32_t imageIndex);
+        VkResult present(VkQueue presentQueue, VkSemaphore signalSemaphores, uint32_t imageIndex); // Out of date or suboptimal means the swapchain should be recreated
 
         void regenerateFramebuffers();
 
+        // Takes effect the next time the swapchain is (re)created
+        void setConfig(const SwapchainConfig& config) { m_config = config; }
+        const SwapchainConfig& getConfig() { return m_config; }
+        VkPresentModeKHR getPresentMode() { return m_present_mode; }
+
         VkFormat getImageFormat() { return m_imageFormat; }
         VkExtent2D getSwapchainExtent() { return m_swapChainExtent; }
         int getImageCount() { return static_cast<int>(m_images.size()); }
         VulkanFramebuffer& getFrameBuffer(int index) { return m_framebuffers[index]; }
+        VkImage getImage(int index) { return m_images[index]; }
 
    private:
+        void createSwapchain(uint32_t width, uint32_t height, VkSwapchainKHR old_swapchain);
+        void retireResources(); // Hands everything but the VkSwapchainKHR to the deletion queue
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
         VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+        void setFramesInFlight(uint32_t image_count);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t width, uint32_t height);
         void createImageViews();
+        void createOffscreenImages(uint32_t width, uint32_t height);
 
         VulkanContext* m_context;
 
-        VkSwapchainKHR m_swapChain;
+        SwapchainConfig m_config;
+        VkPresentModeKHR m_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+        VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
         std::vector<VkImage> m_images;
         std::vector<VkImageView> m_imageViews;
         std::vector<VulkanFramebuffer> m_framebuffers;
@@ -50,4 +89,8 @@ class VulkanSwapchain {
         VkFormat m_imageFormat;
         VkExtent2D m_swapChainExtent;
         VulkanImage m_depthAttachment;
+
+        static const uint32_t OFFSCREEN_IMAGE_COUNT = 3; // Unless the config asks for a different count
+        std::vector<VulkanImage> m_offscreen_images; // Only used when headless
+        uint32_t m_next_offscreen_image = 0;
 };
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+
+#include "renderer/vulkan/VulkanPipeline.hpp"
+#include "core/Vertex.hpp"
+
+/*
+    VERTEX LAYOUTS:
+    - Each vertex format specialises VulkanVertexLayout with a constexpr list of its attributes, the shader location of an attribute is its position in the list
+    - getVertexAttributes<Vertex>() turns the list into VkVertexInputAttributeDescriptions at compile time, and setVertexLayout<Vertex>() puts them and the binding
+      into a pipeline description, so pipelines can't drift out of sync with the structs they read
+    - addInstanceLayout<Instance>() adds a second binding stepped per instance instead of per vertex, its attributes take the locations after the vertex's
+    - The layouts are checked at compile time: every format has to be one we know the size of, fit inside the vertex and not overlap another attribute
+*/
+
+struct VulkanVertexAttribute {
+    VkFormat format;
+    uint32_t offset;
+};
+
+constexpr uint32_t getVertexFormatSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R32_SFLOAT: return 4;
+        case VK_FORMAT_R32G32_SFLOAT: return 8;
+        case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+        case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+        case VK_FORMAT_R16G16_UNORM:
+        case VK_FORMAT_R16G16_SNORM:
+        case VK_FORMAT_R16G16_SFLOAT: return 4;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R16G16B16A16_SNORM:
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SNORM: return 4;
+        default: return 0;
+    }
+}
+
+template<typename Vertex>
+struct VulkanVertexLayout; // Every vertex format needs a specialisation
+
+template<>
+struct VulkanVertexLayout<Vertex3D> {
+    static constexpr VulkanVertexAttribute attributes[] = {
+        { VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex3D, position) },
+    };
+};
+
+template<>
+struct VulkanVertexLayout<VertexStatic> {
+    static constexpr VulkanVertexAttribute attributes[] = {
+        { VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexStatic, position) },
+        { VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexStatic, normal) },
+        { VK_FORMAT_R32G32_SFLOAT, offsetof(VertexStatic, uv) },
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(VertexStatic, tangent) },
+    };
+};
+
+// 3 component 16 bit formats are rarely supported for vertex input, so the position uses all 4 and keeps the tangent handedness in w
+template<>
+struct VulkanVertexLayout<VertexQuantized> {
+    static constexpr VulkanVertexAttribute attributes[] = {
+        { VK_FORMAT_R16G16B16A16_UNORM, offsetof(VertexQuantized, position) },
+        { VK_FORMAT_R16G16_SNORM, offsetof(VertexQuantized, normal) },
+        { VK_FORMAT_R16G16_SFLOAT, offsetof(VertexQuantized, uv) },
+        { VK_FORMAT_R16G16_SNORM, offsetof(VertexQuantized, tangent) },
+    };
+};
+
+// A mat4 is 4 vec4 attributes, one location each
+template<>
+struct VulkanVertexLayout<InstanceData> {
+    static constexpr VulkanVertexAttribute attributes[] = {
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, transform) },
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, transform) + sizeof(glm::vec4) },
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, transform) + 2 * sizeof(glm::vec4) },
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, transform) + 3 * sizeof(glm::vec4) },
+        { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, params) },
+    };
+};
+
+template<typename Vertex>
+constexpr size_t getVertexAttributeCount() {
+    return std::size(VulkanVertexLayout<Vertex>::attributes);
+}
+
+template<typename Vertex>
+constexpr bool isValidVertexLayout() {
+    const auto& attributes = VulkanVertexLayout<Vertex>::attributes;
+    for (size_t i = 0; i < std::size(attributes); i++) {
+        uint32_t size = getVertexFormatSize(attributes[i].format);
+        if (size == 0 || attributes[i].offset + size > sizeof(Vertex)) return false;
+
+        for (size_t j = 0; j < i; j++) {
+            uint32_t other_size = getVertexFormatSize(attributes[j].format);
+            if (attributes[i].offset < attributes[j].offset + other_size && attributes[j].offset < attributes[i].offset + size) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isValidVertexLayout<Vertex3D>(), "Vertex3D layout is invalid");
+static_assert(isValidVertexLayout<VertexStatic>(), "VertexStatic layout is invalid");
+static_assert(isValidVertexLayout<VertexQuantized>(), "VertexQuantized layout is invalid");
+static_assert(isValidVertexLayout<InstanceData>(), "InstanceData layout is invalid");
+
+template<typename Vertex>
+constexpr std::array<VkVertexInputAttributeDescription, getVertexAttributeCount<Vertex>()> getVertexAttributes(uint32_t binding = 0, uint32_t first_location = 0) {
+    static_assert(isValidVertexLayout<Vertex>(), "Vertex layout has an unknown format, an attribute outside the vertex or overlapping attributes");
+
+    std::array<VkVertexInputAttributeDescription, getVertexAttributeCount<Vertex>()> descriptions = {};
+    for (size_t i = 0; i < descriptions.size(); i++) {
+        descriptions[i].location = first_location + static_cast<uint32_t>(i);
+        descriptions[i].binding = binding;
+        descriptions[i].format = VulkanVertexLayout<Vertex>::attributes[i].format;
+        descriptions[i].offset = VulkanVertexLayout<Vertex>::attributes[i].offset;
+    }
+    return descriptions;
+}
+
+template<typename Vertex>
+constexpr VkVertexInputBindingDescription getVertexBinding(uint32_t binding = 0, VkVertexInputRate input_rate = VK_VERTEX_INPUT_RATE_VERTEX) {
+    return { binding, static_cast<uint32_t>(sizeof(Vertex)), input_rate }; // Move to next data entry for each vertex (or instance)
+}
+
+// Replaces the description's vertex input with a single binding of this vertex format
+template<typename Vertex>
+void setVertexLayout(VulkanPipelineDescription& description) {
+    constexpr auto attributes = getVertexAttributes<Vertex>();
+    description.attributes.assign(attributes.begin(), attributes.end());
+    description.bindings.assign(1, getVertexBinding<Vertex>());
+}
+
+// Adds a binding of this format read once per instance, keeping the description's vertex input
+template<typename Instance>
+void addInstanceLayout(VulkanPipelineDescription& description, uint32_t binding = 1) {
+    uint32_t first_location = 0;
+    for (const auto& attribute : description.attributes) first_location = std::max(first_location, attribute.location + 1);
+
+    const auto attributes = getVertexAttributes<Instance>(binding, first_location);
+    description.attributes.insert(description.attributes.end(), attributes.begin(), attributes.end());
+    description.bindings.push_back(getVertexBinding<Instance>(binding, VK_VERTEX_INPUT_RATE_INSTANCE));
+}
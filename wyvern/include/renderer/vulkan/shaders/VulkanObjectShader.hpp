@@ -3,6 +3,9 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
+#include "renderer/vulkan/VulkanCommandBuffer.hpp"
+#include "renderer/vulkan/VulkanPipeline.hpp"
+
 struct VulkanContext;
 
 // A shader stage store info for one stage of the full graphics pipeline (e.g. vertex of fragment)
@@ -21,13 +24,21 @@ struct VulkanShaderStage {
 
 class VulkanObjectShader {
     public:
-        void create(VulkanContext& context, const std::string& base_path);
+        // vertex_input has the bindings, attributes, push constants and descriptor set layouts the shaders expect, e.g. from setVertexLayout<Vertex>()
+        void create(VulkanContext& context, const std::string& vertex_path, const std::string& fragment_path, const VulkanPipelineDescription& vertex_input);
         void destroy();
         void use();
+        void use(VulkanCommandBuffer& command_buffer);
+
+        VulkanPipeline* getPipeline() { return m_pipeline; }
+        bool ownsPipelineDescription(const VulkanPipelineDescription& description) { return !description.stages.empty() && description.stages[0].module == m_vulkan_shader_stages[0].shader_module; }
+        const VulkanPipelineDescription& getDescription() { return m_description; } // Starting point for variants of this shader's pipeline
 
     private:
         VulkanContext* m_context;
         const uint32_t SHADER_STAGE_COUNT = 2;
         std::vector<VulkanShaderStage> m_vulkan_shader_stages;
+        VulkanPipeline* m_pipeline = nullptr; // Owned by the pipeline state cache
+        VulkanPipelineDescription m_description;
         // VulkanPipeline m_pipeline;
 };
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 450
+
+// Instanced Vertex3D for the GPU scene, see VulkanGpuScene.hpp
+layout(location = 0) in vec3 in_position;
+
+struct Instance {
+    vec4 position_scale;
+    vec4 bounding_sphere;
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint bucket;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances { Instance instances[]; };
+
+layout(location = 0) out vec3 out_position;
+
+void main() {
+    vec4 position_scale = instances[gl_InstanceIndex].position_scale;
+    vec3 position = position_scale.xyz + in_position * position_scale.w;
+    gl_Position = vec4(position.x, -position.y, position.z, 1.0);
+    out_position = in_position;
+}
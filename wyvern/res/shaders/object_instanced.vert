@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+
+// InstanceData, see core/Vertex.hpp. Read once per instance, the mat4 takes locations 1 to 4
+layout(location = 1) in mat4 in_transform;
+layout(location = 5) in vec4 in_params;
+
+layout(location = 0) out vec3 out_position;
+
+void main() {
+    vec4 position = in_transform * vec4(in_position, 1.0);
+    gl_Position = vec4(position.x, -position.y, position.z, position.w);
+    out_position = position.xyz + in_params.xyz; // object.frag colours by position, so params tint each instance
+}
@@ -0,0 +1,28 @@
+#version 450
+
+// VertexQuantized, see core/Vertex.hpp
+layout(location = 0) in vec4 in_position; // xyz relative to the mesh bounds, w is the tangent handedness
+layout(location = 1) in vec2 in_normal; // Octahedral
+layout(location = 2) in vec2 in_uv;
+layout(location = 3) in vec2 in_tangent; // Octahedral
+
+layout(push_constant) uniform Dequantization {
+    vec4 offset;
+    vec4 scale;
+} dequantization;
+
+layout(location = 0) out vec3 out_position;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 direction = vec3(encoded.x, encoded.y, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-direction.z, 0.0);
+    direction.x += direction.x >= 0.0 ? -fold : fold;
+    direction.y += direction.y >= 0.0 ? -fold : fold;
+    return normalize(direction);
+}
+
+void main() {
+    vec3 position = dequantization.offset.xyz + in_position.xyz * dequantization.scale.xyz;
+    gl_Position = vec4(position.x, -position.y, position.z, 1.0);
+    out_position = position;
+}
@@ -4,6 +4,7 @@
 Application* Application::s_instance = nullptr;
 
 Application::Application(Game* game) {
+    Profiler::setThreadName("Main");
     m_state.game = game;
 
     WindowConfig config;
@@ -11,21 +12,22 @@ Application::Application(Game* game) {
     config.width = game->app_config.window_width;
     config.height = game->app_config.window_height;
 
-    m_state.window = std::make_unique<Window>(config);
+    m_headless = game->app_config.headless;
+    if (!m_headless) m_state.window = std::make_unique<Window>(config);
 
-    Renderer::init(config.name.c_str(), m_state.window.get());
+    JobSystem::init();
+    m_swapchain_config = game->app_config.swapchain;
+    Renderer::init(config.name.c_str(), m_state.window.get(), config.width, config.height, m_swapchain_config);
+    m_frame_limiter.setTargetFrameRate(game->app_config.frame_rate_limit);
+    m_frame_limiter.setSpinTime(game->app_config.frame_limiter_spin_time);
 
     m_state.game->init();
     m_state.is_running = true;
+    m_pipelined = game->app_config.pipelined_rendering;
 
-    m_dispatcher.registerListener<WindowCloseEvent>(
-        [this](Event&) -> bool { return onWindowClose(); });
-
-    m_dispatcher.registerListener<WindowResizeEvent>(
-        [this](Event& e) -> bool { return onWindowResize(static_cast<WindowResizeEvent&>(e)); });
-
-    m_dispatcher.registerListener<KeyPressedEvent>(
-        [this](Event& e) -> bool { return onKeyPress(static_cast<KeyPressedEvent&>(e)); });
+    m_dispatcher.registerListener<WindowCloseEvent, &Application::onWindowClose>(this);
+    m_dispatcher.registerListener<WindowResizeEvent, &Application::onWindowResize>(this);
+    m_dispatcher.registerListener<KeyPressedEvent, &Application::onKeyPress>(this);
 }
 
 void Application::init(Game* game) {
@@ -36,57 +38,146 @@ void Application::init(Game* game) {
     s_instance = new Application(game);
 }
 
+void Application::setSwapchainConfig(const SwapchainConfig& config) {
+    // Goes to the renderer with the next packet, so it's applied on whichever thread draws frames
+    m_swapchain_config = config;
+    m_swapchain_config_changed = true;
+}
+
 void Application::run() {
-    const double target_frame_time = 1.0 / 60.0; // 60 FPS
-    double run_time = 0;
     Clock::start();
+    uint64_t frame_number = 0;
+
+    if (m_pipelined) {
+        m_render_thread_running = true;
+        m_render_thread = std::thread(&Application::renderThreadLoop, this);
+        Logger::info("Pipelined rendering enabled");
+    }
 
     while (m_state.is_running) {
-        double frame_start = Clock::getTimeSinceStart();
+        m_frame_limiter.wait();
+
+        WYVERN_PROFILE_SCOPE("Frame");
+        double input_time = Clock::getTimeSinceStart();
         float dt = Clock::getDeltaTime();
 
-        m_state.window->update();
-        m_state.game->update(dt);
-        m_state.game->render(dt);
+        {
+            WYVERN_PROFILE_SCOPE("Window update");
+            if (m_state.window) m_state.window->update();
+            m_dispatcher.processQueue(); // Window and input events from this frame's poll
+        }
+        {
+            WYVERN_PROFILE_SCOPE("Game update");
+            m_state.game->update(dt);
+        }
+        {
+            WYVERN_PROFILE_SCOPE("Game render");
+            m_state.game->render(dt);
+        }
 
         RenderPacket renderPacket;
         renderPacket.deltaTime = dt;
-        Renderer::drawFrame(renderPacket);
+        renderPacket.frame_number = frame_number++;
+        renderPacket.input_time = input_time;
+        if (m_swapchain_config_changed) {
+            renderPacket.swapchain_config_changed = true;
+            renderPacket.swapchain_config = m_swapchain_config;
+            m_swapchain_config_changed = false;
+        }
+        m_state.game->buildRenderPacket(renderPacket);
 
-        double frame_end = Clock::getTimeSinceStart();
-        double elapsed = frame_end - frame_start;
-        run_time += elapsed;
+        if (m_headless && frame_number >= m_state.game->app_config.headless_frame_count) {
+            const std::string& capture_path = m_state.game->app_config.headless_capture_path;
+            if (!capture_path.empty()) renderPacket.capture_path = capture_path.c_str();
+            m_state.is_running = false;
+        }
+
+        if (m_pipelined) {
+            if (m_pending_resize) {
+                renderPacket.framebuffer_resized = true;
+                m_state.window->getFramebufferSize(renderPacket.framebuffer_width, renderPacket.framebuffer_height);
+                m_pending_resize = false;
+            }
+            submitRenderPacket(renderPacket);
+        } else {
+            Renderer::drawFrame(renderPacket);
+            m_input_latency.record(Clock::getTimeSinceStart() - input_time);
+        }
+    }
 
-        bool limit_frames = false;
-        if (elapsed < target_frame_time && limit_frames) {
-            double sleepTime = target_frame_time - elapsed;
-            std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+    if (m_pipelined) {
+        {
+            std::lock_guard<std::mutex> lock(m_packet_mutex);
+            m_render_thread_running = false;
         }
+        m_packet_condition.notify_all();
+        m_render_thread.join();
     }
 
     Renderer::shutdown();
+    JobSystem::shutdown();
+}
+
+void Application::submitRenderPacket(const RenderPacket& packet) {
+    WYVERN_PROFILE_SCOPE("Wait for render thread");
+    std::unique_lock<std::mutex> lock(m_packet_mutex);
+
+    // Both slots in use means the render thread is still on the frame before last, wait until it frees one up
+    m_packet_condition.wait(lock, [this]() { return m_packets_submitted - m_packets_consumed < 2; });
+
+    m_packets[m_packets_submitted % 2] = packet;
+    m_packets_submitted++;
+
+    lock.unlock();
+    m_packet_condition.notify_all();
+}
+
+void Application::renderThreadLoop() {
+    Profiler::setThreadName("Render");
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_packet_mutex);
+        m_packet_condition.wait(lock, [this]() { return m_packets_consumed < m_packets_submitted || !m_render_thread_running; });
+        if (m_packets_consumed == m_packets_submitted) break; // Only stop once every submitted frame has been drawn
+
+        // The main thread never writes to a slot that hasn't been consumed, so it's safe to read without the lock
+        RenderPacket& packet = m_packets[m_packets_consumed % 2];
+        lock.unlock();
+
+        Renderer::drawFrame(packet);
+        m_input_latency.record(Clock::getTimeSinceStart() - packet.input_time);
+
+        lock.lock();
+        m_packets_consumed++;
+        lock.unlock();
+        m_packet_condition.notify_all();
+    }
 }
 
-bool Application::onWindowClose() {
+bool Application::onWindowClose(const WindowCloseEvent&) {
     Logger::debug("Closing window...");
     m_state.is_running = false;
     return true;
 }
 
-bool Application::onWindowResize(WindowResizeEvent& e) {
+bool Application::onWindowResize(const WindowResizeEvent& e) {
     m_state.window_width = e.width;
     m_state.window_height = e.height;
 
-    Renderer::onWindowResize(e.width, e.height);
+    // The render thread picks the new size up with the next packet
+    if (m_pipelined) m_pending_resize = true;
+    else Renderer::onWindowResize(e.width, e.height);
     m_state.game->onWindowResize(e.width, e.height);
     return true;
 }
 
-bool Application::onKeyPress(KeyPressedEvent& e) {
+bool Application::onKeyPress(const KeyPressedEvent& e) {
     if (e.key == GLFW_KEY_ESCAPE) {
-        WindowCloseEvent ev;
-        m_dispatcher.dispatch(ev);
+        m_dispatcher.dispatch(WindowCloseEvent());
     }
 
+    // Dump the last few seconds of profiling markers
+    if (e.key == GLFW_KEY_F12 && e.action == GLFW_PRESS) Profiler::exportChromeTrace("wyvern_trace.json");
+
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "core/FrameLimiter.hpp"
+#include "core/Clock.hpp"
+#include "core/Profiler.hpp"
+
+#include <thread>
+
+void FrameLimiter::setTargetFrameRate(double frames_per_second) {
+    m_frame_time = frames_per_second > 0.0 ? 1.0 / frames_per_second : 0.0;
+    m_last_frame_start = -1.0;
+}
+
+void FrameLimiter::wait() {
+    double now = Clock::getTimeSinceStart();
+    if (m_frame_time <= 0.0) return;
+
+    double deadline = m_last_frame_start + m_frame_time;
+    if (m_last_frame_start < 0.0 || now >= deadline + m_frame_time) {
+        m_last_frame_start = now; // First frame or too far behind, start a new grid from here
+        return;
+    }
+
+    WYVERN_PROFILE_SCOPE("Frame limiter");
+    double remaining = deadline - now;
+    if (remaining > m_spin_time) std::this_thread::sleep_for(std::chrono::duration<double>(remaining - m_spin_time));
+    while (Clock::getTimeSinceStart() < deadline) std::this_thread::yield();
+
+    m_last_frame_start = deadline;
+}
+
+void LatencyTracker::record(double seconds) {
+    const double smoothing = 1.0 / 30.0;
+    double average = m_average.load(std::memory_order_relaxed);
+    average = average == 0.0 ? seconds : average + (seconds - average) * smoothing;
+
+    m_last.store(seconds, std::memory_order_relaxed);
+    m_average.store(average, std::memory_order_relaxed);
+}
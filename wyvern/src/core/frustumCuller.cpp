@@ -0,0 +1,263 @@
+#include "core/FrustumCuller.hpp"
+#include "core/JobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/*
+    SIMD wrappers, just enough for the plane tests:
+    - SimdFloat holds SIMD_WIDTH floats, SimdMask the result of comparing them
+    - simdMaskBits() packs a mask into the low SIMD_WIDTH bits of an integer, lane 0 in bit 0
+*/
+#if defined(__AVX__)
+#include <immintrin.h>
+
+typedef __m256 SimdFloat;
+typedef __m256 SimdMask;
+static const uint32_t SIMD_WIDTH = 8;
+static const char* SIMD_NAME = "AVX";
+
+static inline SimdFloat simdLoad(const float* values) { return _mm256_loadu_ps(values); }
+static inline SimdFloat simdSplat(float value) { return _mm256_set1_ps(value); }
+static inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+static inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+static inline SimdMask simdGreaterEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline SimdMask simdAnd(SimdMask a, SimdMask b) { return _mm256_and_ps(a, b); }
+static inline uint32_t simdMaskBits(SimdMask mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+typedef __m128 SimdFloat;
+typedef __m128 SimdMask;
+static const uint32_t SIMD_WIDTH = 4;
+static const char* SIMD_NAME = "SSE2";
+
+static inline SimdFloat simdLoad(const float* values) { return _mm_loadu_ps(values); }
+static inline SimdFloat simdSplat(float value) { return _mm_set1_ps(value); }
+static inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+static inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+static inline SimdMask simdGreaterEqual(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a, b); }
+static inline SimdMask simdAnd(SimdMask a, SimdMask b) { return _mm_and_ps(a, b); }
+static inline uint32_t simdMaskBits(SimdMask mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+typedef float32x4_t SimdFloat;
+typedef uint32x4_t SimdMask;
+static const uint32_t SIMD_WIDTH = 4;
+static const char* SIMD_NAME = "NEON";
+
+static inline SimdFloat simdLoad(const float* values) { return vld1q_f32(values); }
+static inline SimdFloat simdSplat(float value) { return vdupq_n_f32(value); }
+static inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return vaddq_f32(a, b); }
+static inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return vmulq_f32(a, b); }
+static inline SimdMask simdGreaterEqual(SimdFloat a, SimdFloat b) { return vcgeq_f32(a, b); }
+static inline SimdMask simdAnd(SimdMask a, SimdMask b) { return vandq_u32(a, b); }
+static inline uint32_t simdMaskBits(SimdMask mask) {
+    // NEON has no movemask, so every lane keeps its own bit and they're summed
+    static const uint32_t lane_bits[4] = {1, 2, 4, 8};
+    uint32x4_t bits = vandq_u32(mask, vld1q_u32(lane_bits));
+    uint32x2_t half = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return vget_lane_u32(vpadd_u32(half, half), 0);
+}
+
+#else
+typedef float SimdFloat;
+typedef bool SimdMask;
+static const uint32_t SIMD_WIDTH = 1;
+static const char* SIMD_NAME = "Scalar";
+
+static inline SimdFloat simdLoad(const float* values) { return *values; }
+static inline SimdFloat simdSplat(float value) { return value; }
+static inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return a + b; }
+static inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return a * b; }
+static inline SimdMask simdGreaterEqual(SimdFloat a, SimdFloat b) { return a >= b; }
+static inline SimdMask simdAnd(SimdMask a, SimdMask b) { return a && b; }
+static inline uint32_t simdMaskBits(SimdMask mask) { return mask ? 1u : 0u; }
+#endif
+
+Frustum Frustum::fromViewProjection(const glm::mat4& view_projection) {
+    /*
+        Each frustum plane is the last row of the matrix plus or minus one of the others
+        Vulkan's depth range is [0, w], so the near plane is just the third row
+    */
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+    Frustum frustum = {{
+        rows[3] + rows[0], rows[3] - rows[0], // Left, right
+        rows[3] + rows[1], rows[3] - rows[1], // Bottom, top
+        rows[2], rows[3] - rows[2], // Near, far
+    }};
+    for (auto& plane : frustum.planes) plane /= glm::length(glm::vec3(plane)); // So distances are in world units and compare to radii
+    return frustum;
+}
+
+uint32_t BoundingSpheres::add(const glm::vec3& centre, float sphere_radius) {
+    x.push_back(centre.x);
+    y.push_back(centre.y);
+    z.push_back(centre.z);
+    radius.push_back(sphere_radius);
+    return size() - 1;
+}
+
+void BoundingSpheres::set(uint32_t index, const glm::vec3& centre, float sphere_radius) {
+    x[index] = centre.x;
+    y[index] = centre.y;
+    z[index] = centre.z;
+    radius[index] = sphere_radius;
+}
+
+void BoundingSpheres::reserve(uint32_t count) {
+    for (auto* component : {&x, &y, &z, &radius}) component->reserve(count);
+}
+
+void BoundingSpheres::clear() {
+    for (auto* component : {&x, &y, &z, &radius}) component->clear();
+}
+
+uint32_t BoundingBoxes::add(const glm::vec3& min, const glm::vec3& max) {
+    for (auto* component : {&x, &y, &z, &extent_x, &extent_y, &extent_z}) component->emplace_back();
+    set(size() - 1, min, max);
+    return size() - 1;
+}
+
+void BoundingBoxes::set(uint32_t index, const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 centre = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    x[index] = centre.x;
+    y[index] = centre.y;
+    z[index] = centre.z;
+    extent_x[index] = extent.x;
+    extent_y[index] = extent.y;
+    extent_z[index] = extent.z;
+}
+
+void BoundingBoxes::reserve(uint32_t count) {
+    for (auto* component : {&x, &y, &z, &extent_x, &extent_y, &extent_z}) component->reserve(count);
+}
+
+void BoundingBoxes::clear() {
+    for (auto* component : {&x, &y, &z, &extent_x, &extent_y, &extent_z}) component->clear();
+}
+
+// Spheres only use extents[0] as the radius, boxes project all three onto each plane's normal
+template<bool BOXES>
+static uint32_t cullVolumes(const Frustum& frustum, const float* x, const float* y, const float* z, const float* const extents[3],
+                            uint32_t begin, uint32_t end, uint32_t* out_visible) {
+    // Plane components are the same for every object, so they're broadcast once
+    SimdFloat plane_x[6], plane_y[6], plane_z[6], plane_w[6], abs_x[6], abs_y[6], abs_z[6];
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        plane_x[p] = simdSplat(plane.x);
+        plane_y[p] = simdSplat(plane.y);
+        plane_z[p] = simdSplat(plane.z);
+        plane_w[p] = simdSplat(plane.w);
+        abs_x[p] = simdSplat(std::fabs(plane.x));
+        abs_y[p] = simdSplat(std::fabs(plane.y));
+        abs_z[p] = simdSplat(std::fabs(plane.z));
+    }
+    const SimdFloat zero = simdSplat(0.0f);
+
+    uint32_t visible_count = 0;
+    uint32_t i = begin;
+    for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+        SimdFloat vx = simdLoad(x + i);
+        SimdFloat vy = simdLoad(y + i);
+        SimdFloat vz = simdLoad(z + i);
+        SimdFloat e0 = simdLoad(extents[0] + i);
+        SimdFloat e1 = zero, e2 = zero;
+        if (BOXES) {
+            e1 = simdLoad(extents[1] + i);
+            e2 = simdLoad(extents[2] + i);
+        }
+
+        SimdMask visible = simdGreaterEqual(zero, zero);
+        for (int p = 0; p < 6; p++) {
+            SimdFloat distance = simdAdd(simdAdd(simdMul(vx, plane_x[p]), simdMul(vy, plane_y[p])), simdAdd(simdMul(vz, plane_z[p]), plane_w[p]));
+            SimdFloat radius = BOXES ? simdAdd(simdAdd(simdMul(e0, abs_x[p]), simdMul(e1, abs_y[p])), simdMul(e2, abs_z[p])) : e0;
+            visible = simdAnd(visible, simdGreaterEqual(simdAdd(distance, radius), zero));
+        }
+
+        uint32_t bits = simdMaskBits(visible);
+        if (bits == 0) continue;
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            out_visible[visible_count] = i + lane; // Always written, only kept when visible
+            visible_count += (bits >> lane) & 1;
+        }
+    }
+
+    // Whatever doesn't fill a whole SIMD register
+    for (; i < end; i++) {
+        bool visible = true;
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = x[i] * plane.x + y[i] * plane.y + z[i] * plane.z + plane.w;
+            float radius = BOXES ? extents[0][i] * std::fabs(plane.x) + extents[1][i] * std::fabs(plane.y) + extents[2][i] * std::fabs(plane.z) : extents[0][i];
+            visible = visible && distance + radius >= 0.0f;
+        }
+        out_visible[visible_count] = i;
+        visible_count += visible ? 1 : 0;
+    }
+    return visible_count;
+}
+
+template<typename Fn>
+static uint32_t cullParallel(uint32_t count, uint32_t batch_size, std::vector<uint32_t>& out_visible, const Fn& cull) {
+    // Each batch compacts into the part of the output at its own offset, then the parts are moved down next to each other
+    out_visible.resize(count);
+    if (count == 0) return 0;
+
+    batch_size = std::max(SIMD_WIDTH, batch_size / SIMD_WIDTH * SIMD_WIDTH);
+    uint32_t batch_count = (count + batch_size - 1) / batch_size;
+    std::vector<uint32_t> batch_visible(batch_count);
+
+    JobSystem::parallelFor(batch_count, 1, [&](uint32_t first_batch, uint32_t last_batch) {
+        for (uint32_t batch = first_batch; batch < last_batch; batch++) {
+            uint32_t begin = batch * batch_size;
+            batch_visible[batch] = cull(begin, std::min(count, begin + batch_size), out_visible.data() + begin);
+        }
+    });
+
+    uint32_t visible_count = batch_visible[0];
+    for (uint32_t batch = 1; batch < batch_count; batch++) {
+        auto first = out_visible.begin() + static_cast<size_t>(batch) * batch_size;
+        // Only ever moves down, but every batch before this one may have been fully visible, in which case it's already in place
+        if (first != out_visible.begin() + visible_count) std::copy(first, first + batch_visible[batch], out_visible.begin() + visible_count);
+        visible_count += batch_visible[batch];
+    }
+    out_visible.resize(visible_count);
+    return visible_count;
+}
+
+uint32_t FrustumCuller::cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* out_visible) {
+    const float* const extents[3] = {spheres.radius.data(), nullptr, nullptr};
+    return cullVolumes<false>(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(), extents, begin, std::min(end, spheres.size()), out_visible);
+}
+
+uint32_t FrustumCuller::cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t begin, uint32_t end, uint32_t* out_visible) {
+    const float* const extents[3] = {boxes.extent_x.data(), boxes.extent_y.data(), boxes.extent_z.data()};
+    return cullVolumes<true>(frustum, boxes.x.data(), boxes.y.data(), boxes.z.data(), extents, begin, std::min(end, boxes.size()), out_visible);
+}
+
+uint32_t FrustumCuller::cullSpheresParallel(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& out_visible, uint32_t batch_size) {
+    return cullParallel(spheres.size(), batch_size, out_visible, [&](uint32_t begin, uint32_t end, uint32_t* out) {
+        return cullSpheres(frustum, spheres, begin, end, out);
+    });
+}
+
+uint32_t FrustumCuller::cullBoxesParallel(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& out_visible, uint32_t batch_size) {
+    return cullParallel(boxes.size(), batch_size, out_visible, [&](uint32_t begin, uint32_t end, uint32_t* out) {
+        return cullBoxes(frustum, boxes, begin, end, out);
+    });
+}
+
+uint32_t FrustumCuller::getSimdWidth() {
+    return SIMD_WIDTH;
+}
+
+const char* FrustumCuller::getSimdName() {
+    return SIMD_NAME;
+}
@@ -17,8 +17,7 @@ void Input::update() {
 void Input::processKey(int key, int action) {
     if (!validKey(key)) { Logger::error("Not a valid keyboard input"); return; }
 
-    KeyPressedEvent e(key, action);
-    Application::get().getEventDispatcher()->dispatch(e);
+    Application::get().getEventDispatcher()->queue(KeyPressedEvent(key, action));
 
     if (action == GLFW_PRESS) current_keys[key] = true;
     else if (action == GLFW_RELEASE) current_keys[key] = false;
@@ -0,0 +1,297 @@
+#include "core/JobSystem.hpp"
+#include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+uint32_t JobSystem::s_thread_count = 1;
+std::vector<std::thread> JobSystem::s_workers;
+std::vector<std::unique_ptr<JobDeque>> JobSystem::s_deques;
+std::mutex JobSystem::s_shared_mutex;
+std::deque<Job*> JobSystem::s_shared_jobs;
+std::vector<Job*> JobSystem::s_parked_jobs;
+std::condition_variable JobSystem::s_wake_condition;
+std::atomic<uint32_t> JobSystem::s_queued_jobs{0};
+std::atomic<uint32_t> JobSystem::s_parked_count{0};
+std::atomic<uint32_t> JobSystem::s_unfinished_jobs{0};
+std::atomic<uint32_t> JobSystem::s_sleeping_workers{0};
+std::atomic<bool> JobSystem::s_running{false};
+std::mutex JobSystem::s_pools_mutex;
+std::vector<std::unique_ptr<Job[]>> JobSystem::s_job_pools;
+std::atomic<uint32_t> JobSystem::s_pool_generation{0};
+
+static thread_local int t_thread_index = -1; // Index into s_deques, -1 for threads that aren't part of the job system
+static thread_local Job* t_job_pool = nullptr; // Owned by s_job_pools
+static thread_local uint32_t t_pool_generation = 0;
+static thread_local uint32_t t_next_job = 0;
+
+/*
+    Chase-Lev deque
+    The owner works on the bottom like a stack, thieves take from the top. The only contended case is when one job is left,
+    which the owner and thieves settle with a CAS on top
+*/
+
+bool JobDeque::push(Job* job) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) return false;
+
+    m_jobs[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // Job has to be visible before a thief can see the new bottom
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobDeque::pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // Thieves have to see the reserved bottom before we read top
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        // Deque was empty
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_jobs[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job, race any thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobDeque::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+
+    Job* job = m_jobs[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr; // Lost the race to another thread
+    return job;
+}
+
+void JobSystem::init(uint32_t thread_count) {
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    s_thread_count = thread_count;
+
+    for (uint32_t i = 0; i < s_thread_count; i++) s_deques.push_back(std::make_unique<JobDeque>());
+
+    t_thread_index = 0; // The thread calling init is the main thread
+    s_running = true;
+    for (uint32_t i = 1; i < s_thread_count; i++) s_workers.emplace_back(workerLoop, i);
+
+    Logger::info("Job system started with %u threads", s_thread_count);
+}
+
+void JobSystem::shutdown() {
+    // Jobs still queued or parked may own resources or be waited on, so help finish them before the workers go away
+    while (s_unfinished_jobs.load() > 0) {
+        Job* job = findJob();
+        if (job) execute(job);
+        else std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_shared_mutex);
+        s_running = false;
+    }
+    s_wake_condition.notify_all();
+
+    for (auto& worker : s_workers) worker.join();
+    s_workers.clear();
+    s_deques.clear();
+    s_shared_jobs.clear();
+    s_parked_jobs.clear();
+
+    // Every job has finished, so the rings can go. Threads still holding a pointer to theirs see the new generation and get a fresh one
+    {
+        std::lock_guard<std::mutex> lock(s_pools_mutex);
+        s_job_pools.clear();
+        s_pool_generation.fetch_add(1);
+    }
+    s_queued_jobs = 0;
+    s_parked_count = 0;
+    s_unfinished_jobs = 0;
+    s_thread_count = 1;
+}
+
+Job* JobSystem::allocateJob() {
+    // First job from this thread (since init), take a ring from the job system so it outlives the thread
+    uint32_t generation = s_pool_generation.load(std::memory_order_relaxed);
+    if (!t_job_pool || t_pool_generation != generation) {
+        std::lock_guard<std::mutex> lock(s_pools_mutex);
+        s_job_pools.push_back(std::make_unique<Job[]>(MAX_JOBS_PER_THREAD));
+        t_job_pool = s_job_pools.back().get();
+        t_pool_generation = generation;
+        t_next_job = 0;
+    }
+
+    Job* job = &t_job_pool[t_next_job++ & (MAX_JOBS_PER_THREAD - 1)];
+    # if defined(_DEBUG)
+        bool was_in_use = job->in_use.exchange(true, std::memory_order_acquire);
+        assert(!was_in_use && "Job ring wrapped onto a job that hasn't finished, too many jobs alive on one thread");
+    # endif
+    return job;
+}
+
+void JobSystem::run(JobFunction function, JobCounter* counter, const JobCounter* dependency) {
+    // Without workers just run the job here
+    if (!isInitialised()) {
+        function();
+        return;
+    }
+
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = allocateJob();
+    job->function = std::move(function);
+    job->counter = counter;
+    job->dependency = dependency;
+    s_unfinished_jobs.fetch_add(1);
+    if (!park(job)) push(job);
+}
+
+bool JobSystem::park(Job* job) {
+    if (!job->dependency || job->dependency->isDone()) return false;
+
+    /*
+        The parked count goes up before the dependency is checked again, and a finishing job brings its counter down before it reads the parked count
+        Both are sequentially consistent, so either we see the counter at zero here or the finishing job sees something parked and takes the mutex,
+        which it can only get after the job is in s_parked_jobs. A job is never left parked on a counter that's already done
+    */
+    std::lock_guard<std::mutex> lock(s_shared_mutex);
+    s_parked_count.fetch_add(1);
+    if (job->dependency->value.load() == 0) {
+        s_parked_count.fetch_sub(1);
+        return false;
+    }
+    s_parked_jobs.push_back(job);
+    return true;
+}
+
+void JobSystem::releaseParked(const JobCounter* counter) {
+    uint32_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_shared_mutex);
+        for (size_t i = 0; i < s_parked_jobs.size();) {
+            if (s_parked_jobs[i]->dependency != counter) {
+                i++;
+                continue;
+            }
+            s_shared_jobs.push_back(s_parked_jobs[i]);
+            s_parked_jobs[i] = s_parked_jobs.back();
+            s_parked_jobs.pop_back();
+            released++;
+        }
+        s_parked_count.fetch_sub(released);
+        s_queued_jobs.fetch_add(released);
+    }
+
+    if (released == 1) s_wake_condition.notify_one();
+    else if (released > 1) s_wake_condition.notify_all();
+}
+
+void JobSystem::push(Job* job) {
+    s_queued_jobs.fetch_add(1);
+
+    bool pushed = t_thread_index >= 0 && s_deques[t_thread_index]->push(job);
+    if (!pushed) {
+        std::lock_guard<std::mutex> lock(s_shared_mutex);
+        s_shared_jobs.push_back(job);
+    }
+
+    // Only touch the mutex if someone is asleep, taking it before notifying makes sure a worker can't miss the wake up
+    if (s_sleeping_workers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(s_shared_mutex); }
+        s_wake_condition.notify_one();
+    }
+}
+
+Job* JobSystem::findJob() {
+    Job* job = nullptr;
+
+    if (t_thread_index >= 0) job = s_deques[t_thread_index]->pop();
+
+    if (!job && s_queued_jobs.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(s_shared_mutex);
+        if (!s_shared_jobs.empty()) {
+            job = s_shared_jobs.front();
+            s_shared_jobs.pop_front();
+        }
+    }
+
+    // Steal starting from the next thread along, so thieves spread out over the deques
+    for (uint32_t i = 1; !job && i <= s_thread_count; i++) {
+        uint32_t victim = (std::max(t_thread_index, 0) + i) % s_thread_count;
+        if (victim == (uint32_t)t_thread_index) continue;
+        job = s_deques[victim]->steal();
+    }
+
+    if (job) s_queued_jobs.fetch_sub(1);
+    return job;
+}
+
+void JobSystem::execute(Job* job) {
+    WYVERN_PROFILE_SCOPE("Job");
+    JobCounter* counter = job->counter;
+    job->function();
+    job->function = nullptr; // Release anything the job captured
+    # if defined(_DEBUG)
+        job->in_use.store(false, std::memory_order_release);
+    # endif
+    // Sequentially consistent to pair with park(), see there
+    if (counter && counter->value.fetch_sub(1) == 1 && s_parked_count.load() > 0) releaseParked(counter);
+    s_unfinished_jobs.fetch_sub(1);
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+    while (!counter.isDone()) {
+        Job* job = findJob();
+        if (job) execute(job);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelForRange(uint32_t count, uint32_t batch_size, const std::function<void(uint32_t, uint32_t)>& function) {
+    if (count == 0) return;
+    batch_size = std::max(1u, batch_size);
+    batch_size = std::max(batch_size, (count + MAX_JOBS_PER_THREAD / 2 - 1) / (MAX_JOBS_PER_THREAD / 2)); // Don't wrap around this thread's job ring
+
+    if (!isInitialised() || count <= batch_size) {
+        function(0, count);
+        return;
+    }
+
+    // The calling thread takes the first batch itself rather than sitting idle
+    JobCounter counter;
+    for (uint32_t begin = batch_size; begin < count; begin += batch_size) {
+        uint32_t end = std::min(count, begin + batch_size);
+        run([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    function(0, batch_size);
+
+    wait(counter);
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    t_thread_index = index;
+    Profiler::setThreadName("Job worker");
+
+    while (s_running.load(std::memory_order_relaxed)) {
+        Job* job = findJob();
+        if (job) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(s_shared_mutex);
+        s_sleeping_workers.fetch_add(1);
+        s_wake_condition.wait(lock, []() { return s_queued_jobs.load() > 0 || !s_running.load(); });
+        s_sleeping_workers.fetch_sub(1);
+    }
+}
@@ -0,0 +1,66 @@
+#include "core/LinearAllocator.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+void LinearAllocator::create(size_t size) {
+    m_capacity = size;
+    m_memory = static_cast<char*>(std::malloc(size));
+    if (!m_memory) Logger::fatal("Failed to allocate %zu byte linear allocator", size);
+    m_offset = 0;
+    m_high_water = 0;
+}
+
+void LinearAllocator::destroy() {
+    reset();
+    std::free(m_memory);
+    m_memory = nullptr;
+    m_capacity = 0;
+}
+
+void* LinearAllocator::allocate(size_t size, size_t alignment) {
+    // Bump the offset with a CAS so several threads can allocate at once
+    size_t offset = m_offset.load(std::memory_order_relaxed);
+    while (true) {
+        size_t aligned = (reinterpret_cast<uintptr_t>(m_memory) + offset + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(m_memory);
+        size_t end = aligned + size;
+        if (end > m_capacity) break;
+        if (m_offset.compare_exchange_weak(offset, end, std::memory_order_relaxed)) return m_memory + aligned;
+    }
+
+    // Out of space, fall back to the heap for the rest of this frame
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    void* memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (!memory) Logger::fatal("Linear allocator failed to allocate %zu overflow bytes", size);
+    m_overflow.push_back(memory);
+    m_overflow_bytes += size + alignment;
+    return memory;
+}
+
+size_t LinearAllocator::getOverflowCount() {
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    return m_overflow.size();
+}
+
+void LinearAllocator::reset() {
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    m_high_water = std::max(m_high_water, m_offset.load(std::memory_order_relaxed) + m_overflow_bytes);
+
+    if (!m_overflow.empty()) {
+        for (void* memory : m_overflow) std::free(memory);
+        m_overflow.clear();
+
+        // Grow so the next frame fits, with some headroom
+        size_t new_capacity = m_high_water + m_high_water / 2;
+        Logger::warn("Linear allocator overflowed by %zu bytes, growing from %zu to %zu bytes", m_overflow_bytes, m_capacity, new_capacity);
+        std::free(m_memory);
+        m_memory = static_cast<char*>(std::malloc(new_capacity));
+        if (!m_memory) Logger::fatal("Failed to grow linear allocator to %zu bytes", new_capacity);
+        m_capacity = new_capacity;
+        m_overflow_bytes = 0;
+    }
+
+    m_offset.store(0, std::memory_order_relaxed);
+}
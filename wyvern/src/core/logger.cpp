@@ -1,8 +1,87 @@
 #include "core/Logger.hpp"
 
-void Logger::output(LogLevel level, const char* message, va_list args) {
+#include <algorithm>
+#include <chrono>
+
+Logger::Slot Logger::s_slots[SLOT_COUNT];
+std::atomic<uint64_t> Logger::s_write_position{0};
+uint64_t Logger::s_read_position = 0;
+std::atomic<uint64_t> Logger::s_dropped{0};
+std::atomic<bool> Logger::s_running{false};
+std::atomic<bool> Logger::s_accepting{false};
+std::atomic<uint32_t> Logger::s_producers{0};
+std::atomic<bool> Logger::s_pending{false};
+std::thread Logger::s_writer;
+std::mutex Logger::s_wake_mutex;
+std::condition_variable Logger::s_wake_condition;
+std::mutex Logger::s_sink_mutex;
+FILE* Logger::s_file = nullptr;
+
+static const std::chrono::steady_clock::time_point s_start_time = std::chrono::steady_clock::now();
+
+static double getLogTime() {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - s_start_time;
+    return elapsed.count();
+}
+
+void Logger::init(const char* file_path) {
+    if (s_running) return;
+
+    for (uint32_t i = 0; i < SLOT_COUNT; i++) s_slots[i].sequence.store(i, std::memory_order_relaxed);
+    s_write_position = 0;
+    s_read_position = 0;
+
+    if (file_path) {
+        FILE* file = std::fopen(file_path, "w");
+        if (!file) Logger::warn("Failed to open log file %s", file_path);
+        std::lock_guard<std::mutex> lock(s_sink_mutex);
+        s_file = file;
+    }
+
+    s_pending = false;
+    s_running = true;
+    s_writer = std::thread(writerLoop);
+    s_accepting = true;
+}
+
+void Logger::shutdown() {
+    if (!s_running) return;
+
+    // Stop taking messages first, then wait out producers that got past the check before that, so nothing is published after the last drain
+    s_accepting = false;
+    while (s_producers.load() > 0) std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock(s_wake_mutex);
+        s_running = false;
+    }
+    s_wake_condition.notify_one();
+    s_writer.join();
+    drain(); // Nothing can be published anymore, this writes whatever the writer hadn't got to
+
+    // Late messages are written synchronously and may be using the file right now
+    std::lock_guard<std::mutex> lock(s_sink_mutex);
+    if (s_file) std::fclose(s_file);
+    s_file = nullptr;
+}
+
+void Logger::flush() {
+    if (!s_running) return;
+
+    uint64_t target = s_write_position.load(std::memory_order_acquire);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(s_sink_mutex);
+            if (s_read_position >= target) break;
+        }
+        wakeWriter();
+        std::this_thread::yield();
+    }
+}
+
+void Logger::write(LogLevel level, double time, const char* message) {
     const char* levelStr[] = {"FATAL", "ERROR", "WARN", "INFO", "DEBUG"};
-    const char* color[] = { 
+    const char* color[] = {
         "\e[0;31m", // red
         "\e[0;31m",   // red
         "\e[0;34m",   // orange
@@ -11,50 +90,137 @@ void Logger::output(LogLevel level, const char* message, va_list args) {
     };
     const char* resetColor = "\e[0;37m"; // white
 
-    std::printf("%s[%s]%s ", color[level], levelStr[level], resetColor);
-    std::vprintf(message, args);
-    std::printf("\n");
+    // One write per message rather than one per part
+    char line[MESSAGE_SIZE + 64];
+    int length = std::snprintf(line, sizeof(line), "%s[%s]%s %s\n", color[level], levelStr[level], resetColor, message);
+    std::fwrite(line, 1, std::min<size_t>(length, sizeof(line) - 1), stdout);
+
+    if (s_file) std::fprintf(s_file, "[%10.4f] [%s] %s\n", time, levelStr[level], message);
 }
 
-void Logger::log(LogLevel level, const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    output(level, message, args);
-    va_end(args);
+void Logger::output(LogLevel level, const char* message, va_list args) {
+    // Sequentially consistent with shutdown(): either it sees this producer and waits for it, or we see that it stopped accepting
+    s_producers.fetch_add(1);
+    if (!s_accepting.load()) {
+        s_producers.fetch_sub(1);
+        char buffer[MESSAGE_SIZE];
+        std::vsnprintf(buffer, sizeof(buffer), message, args);
+        std::lock_guard<std::mutex> lock(s_sink_mutex);
+        write(level, getLogTime(), buffer);
+        return;
+    }
+
+    // Claim a slot, a slot is free for position p when its sequence equals p
+    Slot* slot = nullptr;
+    uint64_t position = s_write_position.load(std::memory_order_relaxed);
+    while (true) {
+        slot = &s_slots[position & (SLOT_COUNT - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+        if (difference == 0) {
+            if (s_write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (difference < 0) {
+            // Ring is full
+            if (level >= LOG_LEVEL_INFO) {
+                s_dropped.fetch_add(1, std::memory_order_relaxed);
+                s_producers.fetch_sub(1);
+                return;
+            }
+            wakeWriter();
+            std::this_thread::yield();
+            position = s_write_position.load(std::memory_order_relaxed);
+        } else {
+            position = s_write_position.load(std::memory_order_relaxed); // Another thread took this slot
+        }
+    }
+
+    slot->level = level;
+    slot->time = getLogTime();
+    std::vsnprintf(slot->message, MESSAGE_SIZE, message, args);
+    slot->sequence.store(position + 1, std::memory_order_release); // Hand the slot to the writer
+    s_producers.fetch_sub(1);
+
+    wakeWriter();
 }
 
-void Logger::fatal(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    output(LogLevel::LOG_LEVEL_FATAL, message, args);
-    va_end(args);
-    throw std::runtime_error("Fatal error detected!");
+void Logger::wakeWriter() {
+    /*
+        Only the first message since the writer took the flag notifies, the rest see it already set
+        The flag is only ever changed with exchanges, so if this one comes after the writer's it sees false and notifies,
+        and if it comes before, the writer's exchange reads it and the slot published before it is visible to the drain that follows
+    */
+    if (s_pending.exchange(true, std::memory_order_acq_rel)) return;
+
+    // Taking the mutex makes sure the writer is either asleep or hasn't checked the flag yet, so the notify can't get lost
+    { std::lock_guard<std::mutex> lock(s_wake_mutex); }
+    s_wake_condition.notify_one();
 }
 
-void Logger::error(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    output(LogLevel::LOG_LEVEL_ERROR, message, args);
-    va_end(args);
+bool Logger::drain() {
+    std::lock_guard<std::mutex> lock(s_sink_mutex);
+    bool wrote = false;
+
+    while (true) {
+        Slot& slot = s_slots[s_read_position & (SLOT_COUNT - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != s_read_position + 1) break;
+
+        write(slot.level, slot.time, slot.message);
+        slot.sequence.store(s_read_position + SLOT_COUNT, std::memory_order_release); // Free for the next lap around the ring
+        s_read_position++;
+        wrote = true;
+    }
+
+    uint64_t dropped = s_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        char message[64];
+        std::snprintf(message, sizeof(message), "%llu log messages dropped", (unsigned long long)dropped);
+        write(LOG_LEVEL_WARNING, getLogTime(), message);
+    }
+
+    if (wrote) {
+        std::fflush(stdout);
+        if (s_file) std::fflush(s_file);
+    }
+    return wrote;
 }
 
-void Logger::warn(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    output(LogLevel::LOG_LEVEL_WARNING, message, args);
-    va_end(args);
+void Logger::writerLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(s_wake_mutex);
+            s_wake_condition.wait(lock, []() { return s_pending.load() || !s_running.load(); });
+        }
+
+        // Take the flag before draining, anything published after this wakes us again
+        s_pending.exchange(false, std::memory_order_acq_rel);
+        drain();
+        if (!s_running.load(std::memory_order_acquire)) break;
+    }
 }
 
-void Logger::info(const char* message, ...) {
+void Logger::log(LogLevel level, const char* message, ...) {
     va_list args;
     va_start(args, message);
-    output(LogLevel::LOG_LEVEL_INFO, message, args);
+    output(level, message, args);
     va_end(args);
 }
 
-void Logger::debug(const char* message, ...) {
+void Logger::fatal(const char* message, ...) {
+    // Everything before this message should be visible, then write it straight away
+    flush();
+
+    char buffer[MESSAGE_SIZE];
     va_list args;
     va_start(args, message);
-    output(LogLevel::LOG_LEVEL_DEBUG, message, args);
+    std::vsnprintf(buffer, sizeof(buffer), message, args);
     va_end(args);
-}
\ No newline at end of file
+
+    {
+        std::lock_guard<std::mutex> lock(s_sink_mutex);
+        write(LogLevel::LOG_LEVEL_FATAL, getLogTime(), buffer);
+        std::fflush(stdout);
+        if (s_file) std::fflush(s_file);
+    }
+    throw std::runtime_error("Fatal error detected!");
+}
@@ -0,0 +1,296 @@
+#include "core/MeshOptimizer.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+static uint32_t hashVertex(const unsigned char* vertex, uint32_t vertex_stride) {
+    // FNV-1a, vertices are small enough that anything fancier doesn't pay off
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < vertex_stride; i++) {
+        hash ^= vertex[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const glm::vec3& getPosition(const glm::vec3* positions, uint32_t position_stride, uint32_t vertex) {
+    return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const unsigned char*>(positions) + static_cast<size_t>(vertex) * position_stride);
+}
+
+uint32_t MeshOptimizer::generateVertexRemap(uint32_t* remap, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride) {
+    const unsigned char* data = static_cast<const unsigned char*>(vertices);
+
+    // Open addressing table of vertex indices, at most half full so probes stay short
+    uint32_t table_size = 1;
+    while (table_size < vertex_count * 2) table_size *= 2;
+    std::vector<uint32_t> table(table_size, UINT32_MAX);
+
+    uint32_t unique_count = 0;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        const unsigned char* vertex = data + static_cast<size_t>(i) * vertex_stride;
+        uint32_t slot = hashVertex(vertex, vertex_stride) & (table_size - 1);
+
+        while (table[slot] != UINT32_MAX && memcmp(data + static_cast<size_t>(table[slot]) * vertex_stride, vertex, vertex_stride) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = i;
+            remap[i] = unique_count++;
+        } else {
+            remap[i] = remap[table[slot]];
+        }
+    }
+    return unique_count;
+}
+
+void MeshOptimizer::remapVertices(void* out_vertices, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* remap) {
+    unsigned char* out = static_cast<unsigned char*>(out_vertices);
+    const unsigned char* data = static_cast<const unsigned char*>(vertices);
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        memcpy(out + static_cast<size_t>(remap[i]) * vertex_stride, data + static_cast<size_t>(i) * vertex_stride, vertex_stride);
+    }
+}
+
+void MeshOptimizer::remapIndices(uint32_t* out_indices, const uint32_t* indices, uint32_t index_count, const uint32_t* remap) {
+    for (uint32_t i = 0; i < index_count; i++) out_indices[i] = remap[indices[i]];
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size, std::vector<uint32_t>* out_clusters) {
+    /*
+        Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+        - Pick a fanning vertex and emit every triangle around it that hasn't been emitted yet
+        - The next fanning vertex is one of the vertices just emitted, preferring ones that are still in the cache and have few triangles left,
+          so they're finished off before they're evicted
+        - If none of them have triangles left go back through the recently emitted vertices (the dead end stack), and failing that to the next
+          vertex in input order that still has triangles. That's a jump to somewhere unconnected, which is where a cluster starts
+    */
+    uint32_t triangle_count = index_count / 3;
+    if (out_clusters) out_clusters->clear();
+    if (triangle_count == 0) return;
+
+    // Triangles around each vertex, as offsets into one big list
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (uint32_t i = 0; i < index_count; i++) live[indices[i]]++;
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + live[v];
+
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        for (uint32_t k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+
+    uint32_t cursor = 0;
+    uint32_t fanning = 0;
+    while (cursor < vertex_count && live[cursor] == 0) cursor++;
+    fanning = cursor;
+    if (out_clusters) out_clusters->push_back(0);
+
+    while (fanning < vertex_count) {
+        candidates.clear();
+        for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // Best candidate is the one that stays in the cache longest once its remaining triangles are emitted
+        uint32_t next = UINT32_MAX;
+        uint32_t best_priority = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+
+            uint32_t priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+            if (next == UINT32_MAX || priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        if (next == UINT32_MAX) {
+            while (!dead_ends.empty() && next == UINT32_MAX) {
+                uint32_t v = dead_ends.back();
+                dead_ends.pop_back();
+                if (live[v] > 0) next = v;
+            }
+        }
+
+        if (next == UINT32_MAX) {
+            while (cursor < vertex_count && live[cursor] == 0) cursor++;
+            next = cursor;
+            if (out_clusters && next < vertex_count) out_clusters->push_back(static_cast<uint32_t>(result.size()));
+        }
+        fanning = next;
+    }
+
+    memcpy(indices, result.data(), sizeof(uint32_t) * result.size());
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, uint32_t index_count, const glm::vec3* positions, uint32_t position_stride, const std::vector<uint32_t>& clusters, uint32_t cache_size, float threshold) {
+    /*
+        Clusters from the vertex cache pass are usually big, so they're cut into smaller ones where it's cheap to do so:
+        - Restarting a cluster empties the cache, so a cut is allowed where the ACMR of the triangles since the last cut is already within threshold of the whole cluster's
+        - Each cluster is then sorted by how much it faces away from the middle of the mesh, dot(cluster centre - mesh centre, cluster normal)
+          Outward facing clusters are on the outside of the mesh and likely occlude the rest, so they go first
+    */
+    uint32_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || clusters.empty()) return;
+
+    uint32_t vertex_count = 0;
+    for (uint32_t i = 0; i < index_count; i++) vertex_count = std::max(vertex_count, indices[i] + 1);
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+
+    auto simulate = [&](uint32_t triangle) {
+        uint32_t misses = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = indices[triangle * 3 + k];
+            if (time - cache_time[v] > cache_size) {
+                cache_time[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    auto flushCache = [&]() { time += cache_size + 1; };
+
+    // Soft cluster starts, in triangles
+    std::vector<uint32_t> starts;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        uint32_t begin = clusters[c] / 3;
+        uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] / 3 : triangle_count;
+
+        flushCache();
+        uint32_t cluster_misses = 0;
+        for (uint32_t t = begin; t < end; t++) cluster_misses += simulate(t);
+        float cluster_acmr = static_cast<float>(cluster_misses) / static_cast<float>(end - begin);
+
+        flushCache();
+        starts.push_back(begin);
+        uint32_t misses = 0;
+        uint32_t start = begin;
+        for (uint32_t t = begin; t < end; t++) {
+            misses += simulate(t);
+            float acmr = static_cast<float>(misses) / static_cast<float>(t + 1 - start);
+            if (t + 1 < end && acmr <= cluster_acmr * threshold) {
+                starts.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                flushCache();
+            }
+        }
+    }
+
+    // Area weighted centre of the whole mesh
+    glm::vec3 mesh_centre(0.0f);
+    float mesh_area = 0.0f;
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        const glm::vec3& a = getPosition(positions, position_stride, indices[t * 3 + 0]);
+        const glm::vec3& b = getPosition(positions, position_stride, indices[t * 3 + 1]);
+        const glm::vec3& c = getPosition(positions, position_stride, indices[t * 3 + 2]);
+        float area = glm::length(glm::cross(b - a, c - a));
+        mesh_centre += (a + b + c) * (area / 3.0f);
+        mesh_area += area;
+    }
+    if (mesh_area > 0.0f) mesh_centre /= mesh_area;
+
+    struct Cluster {
+        uint32_t begin;
+        uint32_t end;
+        float sort_key;
+    };
+    std::vector<Cluster> sorted(starts.size());
+    for (size_t c = 0; c < starts.size(); c++) {
+        Cluster& cluster = sorted[c];
+        cluster.begin = starts[c];
+        cluster.end = c + 1 < starts.size() ? starts[c + 1] : triangle_count;
+
+        // Summing unnormalized normals weights them by area
+        glm::vec3 centre(0.0f), normal(0.0f);
+        float area_total = 0.0f;
+        for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+            const glm::vec3& a = getPosition(positions, position_stride, indices[t * 3 + 0]);
+            const glm::vec3& b = getPosition(positions, position_stride, indices[t * 3 + 1]);
+            const glm::vec3& c = getPosition(positions, position_stride, indices[t * 3 + 2]);
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float area = glm::length(cross);
+            centre += (a + b + c) * (area / 3.0f);
+            normal += cross;
+            area_total += area;
+        }
+        if (area_total > 0.0f) centre /= area_total;
+        float normal_length = glm::length(normal);
+        if (normal_length > 0.0f) normal /= normal_length;
+        cluster.sort_key = glm::dot(centre - mesh_centre, normal);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+    for (const Cluster& cluster : sorted) result.insert(result.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+    memcpy(indices, result.data(), sizeof(uint32_t) * result.size());
+}
+
+uint32_t MeshOptimizer::optimizeVertexFetch(void* out_vertices, uint32_t* indices, uint32_t index_count, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride) {
+    unsigned char* out = static_cast<unsigned char*>(out_vertices);
+    const unsigned char* data = static_cast<const unsigned char*>(vertices);
+
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < index_count; i++) {
+        uint32_t& new_index = remap[indices[i]];
+        if (new_index == UINT32_MAX) {
+            new_index = next++;
+            memcpy(out + static_cast<size_t>(new_index) * vertex_stride, data + static_cast<size_t>(indices[i]) * vertex_stride, vertex_stride);
+        }
+        indices[i] = new_index;
+    }
+    return next;
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+    VertexCacheStats stats;
+    uint32_t triangle_count = index_count / 3;
+    if (triangle_count == 0) return stats;
+
+    // A vertex is in a FIFO cache if fewer than cache_size vertices went in after it
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<bool> used(vertex_count, false);
+    uint32_t time = cache_size + 1;
+    uint32_t used_count = 0;
+    for (uint32_t i = 0; i < triangle_count * 3; i++) {
+        uint32_t v = indices[i];
+        if (!used[v]) {
+            used[v] = true;
+            used_count++;
+        }
+        if (time - cache_time[v] > cache_size) {
+            cache_time[v] = time++;
+            stats.vertices_transformed++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(triangle_count);
+    stats.atvr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(used_count);
+    return stats;
+}
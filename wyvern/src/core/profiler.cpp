@@ -0,0 +1,128 @@
+#include "core/Profiler.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+std::atomic<bool> Profiler::s_enabled{true};
+std::mutex Profiler::s_buffers_mutex;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::s_buffers;
+
+thread_local Profiler::ThreadBuffer* Profiler::s_thread_buffer = nullptr;
+Profiler::ThreadBuffer* Profiler::s_gpu_buffer = nullptr;
+static const std::chrono::steady_clock::time_point s_start_time = std::chrono::steady_clock::now();
+
+uint64_t Profiler::getTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_start_time).count();
+}
+
+Profiler::ThreadBuffer* Profiler::createBuffer(const char* name, const char* category) {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events = std::make_unique<ProfileEvent[]>(EVENTS_PER_THREAD);
+    buffer->thread_name.store(name, std::memory_order_relaxed);
+    buffer->category = category;
+
+    std::lock_guard<std::mutex> lock(s_buffers_mutex);
+    buffer->thread_id = static_cast<uint32_t>(s_buffers.size());
+    s_buffers.push_back(std::move(buffer));
+    return s_buffers.back().get();
+}
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer() {
+    // First event on this thread, the buffer is kept after the thread exits so its events still show up in the export
+    if (!s_thread_buffer) s_thread_buffer = createBuffer(nullptr, "cpu");
+    return *s_thread_buffer;
+}
+
+void Profiler::setThreadName(const char* name) {
+    getThreadBuffer().thread_name.store(name, std::memory_order_release);
+}
+
+uint32_t Profiler::beginScope() {
+    return getThreadBuffer().depth++;
+}
+
+void Profiler::endScope(const char* name, uint64_t start, uint32_t depth) {
+    s_thread_buffer->depth = depth;
+    writeEvent(*s_thread_buffer, name, start, getTime(), depth);
+}
+
+void Profiler::recordGpuEvent(const char* name, uint64_t start, uint64_t end, uint32_t depth) {
+    if (!isEnabled()) return;
+    if (!s_gpu_buffer) s_gpu_buffer = createBuffer("GPU", "gpu");
+    writeEvent(*s_gpu_buffer, name, start, end, depth);
+}
+
+void Profiler::writeEvent(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end, uint32_t depth) {
+    uint64_t index = buffer.write_index.load(std::memory_order_relaxed);
+    ProfileEvent& event = buffer.events[index & (EVENTS_PER_THREAD - 1)];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    event.depth = depth;
+    buffer.write_index.store(index + 1, std::memory_order_release); // Publish the event to exportChromeTrace
+}
+
+// Names are usually literals, but function names can contain characters that need escaping
+static void writeEscaped(FILE* file, const char* text) {
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') std::fputc('\\', file);
+        if (static_cast<unsigned char>(*text) >= 0x20) std::fputc(*text, file);
+    }
+}
+
+bool Profiler::exportChromeTrace(const char* file_path) {
+    FILE* file = std::fopen(file_path, "w");
+    if (!file) {
+        Logger::error("Failed to open %s to write the profiler trace", file_path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_buffers_mutex);
+    std::vector<ProfileEvent> events;
+    size_t event_count = 0;
+    bool first = true;
+
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    for (auto& buffer : s_buffers) {
+        const char* thread_name = buffer->thread_name.load(std::memory_order_acquire);
+        if (thread_name) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", buffer->thread_id);
+            writeEscaped(file, thread_name);
+            std::fprintf(file, "\"}}");
+            first = false;
+        }
+
+        /*
+            The owning thread keeps recording while we copy, so after copying check how far it got
+            Anything it could have overwritten in the meantime is thrown away, the rest is guaranteed to be intact
+        */
+        uint64_t end = buffer->write_index.load(std::memory_order_acquire);
+        uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+        events.clear();
+        for (uint64_t i = begin; i < end; i++) events.push_back(buffer->events[i & (EVENTS_PER_THREAD - 1)]);
+
+        uint64_t latest = buffer->write_index.load(std::memory_order_acquire);
+        // The next write (index latest) lands in the slot of latest - EVENTS_PER_THREAD, so only the slots after it are intact
+        uint64_t intact_begin = latest >= EVENTS_PER_THREAD ? latest - EVENTS_PER_THREAD + 1 : 0;
+        size_t skip = intact_begin > begin ? std::min<size_t>(events.size(), intact_begin - begin) : 0;
+
+        for (size_t i = skip; i < events.size(); i++) {
+            const ProfileEvent& event = events[i];
+            std::fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+            writeEscaped(file, event.name);
+            std::fprintf(file, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}",
+                buffer->category, buffer->thread_id, event.start / 1000.0, (event.end - event.start) / 1000.0, event.depth);
+            first = false;
+        }
+        event_count += events.size() - skip;
+    }
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool success = std::ferror(file) == 0;
+    std::fclose(file);
+    if (success) Logger::info("Wrote %zu profiler events from %zu threads to %s", event_count, s_buffers.size(), file_path);
+    else Logger::error("Failed to write profiler trace to %s", file_path);
+    return success;
+}
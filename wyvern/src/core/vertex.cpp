@@ -0,0 +1,115 @@
+#include "core/Vertex.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+VertexDequantization VertexQuantizer::quantize(const VertexStatic* vertices, uint32_t vertex_count, VertexQuantized* out_vertices) {
+    VertexDequantization dequantization;
+    if (vertex_count == 0) return dequantization;
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (uint32_t i = 1; i < vertex_count; i++) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    // A flat axis still needs a non zero scale, every vertex then quantizes to 0 on it
+    glm::vec3 extent = max - min;
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f) extent[axis] = 1.0f;
+    }
+
+    dequantization.offset = glm::vec4(min, 0.0f);
+    dequantization.scale = glm::vec4(extent, 0.0f);
+    for (uint32_t i = 0; i < vertex_count; i++) out_vertices[i] = quantize(vertices[i], dequantization);
+    return dequantization;
+}
+
+VertexQuantized VertexQuantizer::quantize(const VertexStatic& vertex, const VertexDequantization& dequantization) {
+    VertexQuantized quantized;
+
+    glm::vec3 position = (vertex.position - glm::vec3(dequantization.offset)) / glm::vec3(dequantization.scale);
+    quantized.position[0] = floatToUnorm16(position.x);
+    quantized.position[1] = floatToUnorm16(position.y);
+    quantized.position[2] = floatToUnorm16(position.z);
+    quantized.position[3] = vertex.tangent.w < 0.0f ? 0 : UINT16_MAX;
+
+    glm::vec2 normal = encodeOctahedral(vertex.normal);
+    quantized.normal[0] = floatToSnorm16(normal.x);
+    quantized.normal[1] = floatToSnorm16(normal.y);
+
+    quantized.uv[0] = floatToHalf(vertex.uv.x);
+    quantized.uv[1] = floatToHalf(vertex.uv.y);
+
+    glm::vec2 tangent = encodeOctahedral(glm::vec3(vertex.tangent));
+    quantized.tangent[0] = floatToSnorm16(tangent.x);
+    quantized.tangent[1] = floatToSnorm16(tangent.y);
+
+    return quantized;
+}
+
+glm::vec2 VertexQuantizer::encodeOctahedral(const glm::vec3& direction) {
+    /*
+        Project onto the octahedron |x| + |y| + |z| = 1 and look at it from above
+        The upper half already covers the inner diamond of the square, the lower half is folded out over the corners
+    */
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length == 0.0f) return glm::vec2(0.0f);
+
+    glm::vec2 projected = glm::vec2(direction.x, direction.y) / length;
+    if (direction.z < 0.0f) {
+        glm::vec2 sign(projected.x >= 0.0f ? 1.0f : -1.0f, projected.y >= 0.0f ? 1.0f : -1.0f);
+        projected = (1.0f - glm::abs(glm::vec2(projected.y, projected.x))) * sign;
+    }
+    return projected;
+}
+
+glm::vec3 VertexQuantizer::decodeOctahedral(const glm::vec2& encoded) {
+    // Same as decodeOctahedral in object_quantized.vert
+    glm::vec3 direction(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    float fold = std::max(-direction.z, 0.0f);
+    direction.x += direction.x >= 0.0f ? -fold : fold;
+    direction.y += direction.y >= 0.0f ? -fold : fold;
+    return glm::normalize(direction);
+}
+
+uint16_t VertexQuantizer::floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    int32_t exponent = static_cast<int32_t>(float_exponent) - 127 + 15;
+
+    if (float_exponent == 0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0)); // Infinity and NaN
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7c00); // Too big, becomes infinity
+
+    if (exponent <= 0) {
+        // Denormal half, shift the mantissa (with its implicit 1) down and round to nearest even
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Rounding up can carry into the exponent, which is still the right answer (up to infinity)
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+int16_t VertexQuantizer::floatToSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint16_t VertexQuantizer::floatToUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
@@ -44,13 +44,11 @@ void Window::setupCallbacks() {
     });
 
     glfwSetWindowSizeCallback(m_window, [](GLFWwindow* window, int width, int height) {
-        WindowResizeEvent e(width, height);
-        Application::get().getEventDispatcher()->dispatch(e);
+        Application::get().getEventDispatcher()->queue(WindowResizeEvent(width, height));
     });
 
     glfwSetWindowCloseCallback(m_window, [](GLFWwindow* window) {
-        WindowCloseEvent e;
-        Application::get().getEventDispatcher()->dispatch(e);
+        Application::get().getEventDispatcher()->queue(WindowCloseEvent());
     });
 }
 
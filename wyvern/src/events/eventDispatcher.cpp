@@ -0,0 +1,114 @@
+#include "events/Event.hpp"
+
+EventDispatcher::EventDispatcher() {
+    m_queues[0].create(QUEUE_ARENA_SIZE);
+    m_queues[1].create(QUEUE_ARENA_SIZE);
+}
+
+EventDispatcher::~EventDispatcher() {
+    m_queues[0].destroy();
+    m_queues[1].destroy();
+}
+
+ListenerHandle EventDispatcher::addListener(EventID id, void* instance, ListenerFn function) {
+    ListenerList& list = m_lists[id];
+
+    // Reuse a free slot if there is one, otherwise add a new one
+    uint32_t slot = list.free_slot;
+    if (slot != UINT32_MAX) list.free_slot = list.slots[slot].index;
+    else {
+        slot = static_cast<uint32_t>(list.slots.size());
+        list.slots.push_back({0, 0});
+    }
+
+    list.slots[slot].index = static_cast<uint32_t>(list.listeners.size());
+    list.listeners.push_back({function, instance, slot});
+    Logger::debug("Added listener to event %u", id);
+
+    ListenerHandle handle;
+    handle.event_id = id;
+    handle.slot = slot;
+    handle.generation = list.slots[slot].generation;
+    return handle;
+}
+
+void EventDispatcher::unregisterListener(ListenerHandle& handle) {
+    if (!handle.isValid() || handle.event_id >= MAX_EVENT_TYPES) return;
+
+    ListenerList& list = m_lists[handle.event_id];
+    if (handle.slot >= list.slots.size() || list.slots[handle.slot].generation != handle.generation) {
+        Logger::warn("Tried to unregister a listener for event %u that was already removed", handle.event_id);
+        handle = ListenerHandle();
+        return;
+    }
+
+    Slot& slot = list.slots[handle.slot];
+    uint32_t index = slot.index;
+
+    // Bumping the generation invalidates any other copies of the handle
+    slot.generation++;
+    slot.index = list.free_slot;
+    list.free_slot = handle.slot;
+    handle = ListenerHandle();
+
+    if (m_dispatch_depth > 0) {
+        // Can't move listeners around while they are being iterated over
+        list.listeners[index].function = nullptr;
+        list.needs_compact = true;
+        m_needs_compact = true;
+        return;
+    }
+
+    list.listeners.erase(list.listeners.begin() + index);
+    for (uint32_t i = index; i < list.listeners.size(); i++) list.slots[list.listeners[i].slot].index = i;
+}
+
+void EventDispatcher::compact(ListenerList& list) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < list.listeners.size(); i++) {
+        if (!list.listeners[i].function) continue;
+        list.listeners[count] = list.listeners[i];
+        list.slots[list.listeners[count].slot].index = count;
+        count++;
+    }
+    list.listeners.resize(count);
+    list.needs_compact = false;
+}
+
+void EventDispatcher::dispatchRaw(EventID id, const void* event) {
+    ListenerList& list = m_lists[id];
+
+    // Listeners added during the dispatch don't see this event
+    size_t count = list.listeners.size();
+    m_dispatch_depth++;
+    for (size_t i = 0; i < count; i++) {
+        const Listener& listener = list.listeners[i];
+        if (listener.function && listener.function(listener.instance, event)) break; // stop propagation if handled
+    }
+    m_dispatch_depth--;
+
+    if (m_dispatch_depth == 0 && m_needs_compact) {
+        for (ListenerList& other : m_lists) {
+            if (other.needs_compact) compact(other);
+        }
+        m_needs_compact = false;
+    }
+}
+
+void EventDispatcher::processQueue() {
+    QueuedEvent* queued;
+    uint32_t read_queue;
+
+    // Take the whole batch, anything queued by the listeners goes into the other arena and waits for the next call
+    {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        queued = m_queue_head;
+        read_queue = m_write_queue;
+        m_queue_head = m_queue_tail = nullptr;
+        m_write_queue = 1 - m_write_queue;
+    }
+
+    for (; queued; queued = queued->next) dispatchRaw(queued->event_id, queued + 1);
+
+    m_queues[read_queue].reset();
+}
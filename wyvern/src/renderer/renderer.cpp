@@ -1,11 +1,12 @@
 #include "renderer/Renderer.hpp"
 
 #include "core/Logger.hpp"
+#include "core/Profiler.hpp"
 
 VulkanBackend Renderer::s_backend;
 
-void Renderer::init(const char* appName, Window* window) {
-    s_backend.init(appName, window);
+void Renderer::init(const char* appName, Window* window, uint32_t headless_width, uint32_t headless_height, const SwapchainConfig& swapchain_config) {
+    s_backend.init(appName, window, headless_width, headless_height, swapchain_config);
 }
 
 void Renderer::shutdown() {
@@ -13,7 +14,11 @@ void Renderer::shutdown() {
 }
 
 void Renderer::drawFrame(RenderPacket& renderPacket) {
-    s_backend.drawFrame(renderPacket.deltaTime);
+    WYVERN_PROFILE_SCOPE("Renderer::drawFrame");
+    if (renderPacket.framebuffer_resized) s_backend.onFramebufferResize(renderPacket.framebuffer_width, renderPacket.framebuffer_height);
+    if (renderPacket.swapchain_config_changed) s_backend.setSwapchainConfig(renderPacket.swapchain_config);
+    if (renderPacket.capture_path) s_backend.captureNextFrame(renderPacket.capture_path);
+    s_backend.drawFrame(renderPacket);
 }
 
 void Renderer::onWindowResize(u_int16_t width, u_int16_t height) {
@@ -3,7 +3,7 @@
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/Logger.hpp"
 
-void VulkanObjectShader::create(VulkanContext& context, const std::string& base_path) {
+void VulkanObjectShader::create(VulkanContext& context, const std::string& vertex_path, const std::string& fragment_path, const VulkanPipelineDescription& vertex_input) {
     m_context = &context;
 
     m_vulkan_shader_stages.resize(SHADER_STAGE_COUNT);
@@ -13,49 +13,32 @@ void VulkanObjectShader::create(VulkanContext& context, const std::string& base_
     m_vulkan_shader_stages[0].flag = VK_SHADER_STAGE_VERTEX_BIT;
     m_vulkan_shader_stages[1].flag = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; i++) {
-        VulkanShaderUtils::loadShaderStage(context, base_path + "." + std::string(m_vulkan_shader_stages[i].type) + ".spv", m_vulkan_shader_stages[i]);
-    }
+    VulkanShaderUtils::loadShaderStage(context, vertex_path, m_vulkan_shader_stages[0]);
+    VulkanShaderUtils::loadShaderStage(context, fragment_path, m_vulkan_shader_stages[1]);
 
     /// Pipeline creation ///
-    // Region of framebuffer that output will be rendered to
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) m_context->framebuffer_width;
-    viewport.height = (float) m_context->framebuffer_height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // Scissor rectangles define in which regions pixels are actually stored
-    VkRect2D scissor;
-    scissor.offset = {0, 0};
-    scissor.extent = m_context->swapchain.getSwapchainExtent();
+    VulkanPipelineDescription description;
+    description.renderpass = m_context->renderpass.getHandle();
 
-    // Attributes
-    uint32_t offset = 0;
-    const uint32_t attribute_count = 1;
-    std::vector<VkVertexInputAttributeDescription> attributes;
-    attributes.resize(attribute_count);
-    VkFormat formats[attribute_count] = { VK_FORMAT_R32G32B32_SFLOAT };
-    uint64_t sizes[attribute_count] = { sizeof(glm::vec3) };
-    for (uint32_t i = 0; i < attribute_count; ++i) {
-        attributes[i].binding = 0;
-        attributes[i].location = i;
-        attributes[i].format = formats[i];
-        attributes[i].offset = offset;
-        offset += sizes[i];
-    }
+    // Describe format of vertex data that will be passed onto vertex shader
+    description.bindings = vertex_input.bindings;
+    description.attributes = vertex_input.attributes;
+    description.push_constant_ranges = vertex_input.push_constant_ranges;
+    description.descriptor_set_layouts = vertex_input.descriptor_set_layouts;
 
     //Stages
-    std::vector<VkPipelineShaderStageCreateInfo> stage_create_info;
-    stage_create_info.resize(SHADER_STAGE_COUNT);
     for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i) {
-        stage_create_info[i].sType = m_vulkan_shader_stages[i].shader_stage_create_info.sType;
-        stage_create_info[i] = m_vulkan_shader_stages[i].shader_stage_create_info;
+        VulkanPipelineShaderStage stage;
+        stage.stage = m_vulkan_shader_stages[i].flag;
+        stage.module = m_vulkan_shader_stages[i].shader_module;
+        stage.entry_point = m_vulkan_shader_stages[i].shader_stage_create_info.pName;
+        description.stages.push_back(stage);
     }
 
-    m_context->pipeline.create(context, attributes, {}, stage_create_info, viewport, scissor, false);
+    // This is the pipeline everything else falls back to, so it has to be compiled right away
+    m_description = description;
+    m_pipeline = m_context->pipeline_states.get(description);
+    if (!m_pipeline) Logger::fatal("Failed to create object shader pipeline");
     Logger::info("Successfully created shader");
 }
 
@@ -67,5 +50,9 @@ void VulkanObjectShader::destroy() {
 }
 
 void VulkanObjectShader::use() {
-    m_context->pipeline.bind(m_context->commandBuffers[m_context->image_index], VK_PIPELINE_BIND_POINT_GRAPHICS);
+    use(m_context->commandBuffers[m_context->current_frame]);
+}
+
+void VulkanObjectShader::use(VulkanCommandBuffer& command_buffer) {
+    m_pipeline->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
 }
\ No newline at end of file
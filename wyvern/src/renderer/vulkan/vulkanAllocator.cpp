@@ -0,0 +1,415 @@
+#include "renderer/vulkan/VulkanAllocator.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+
+static inline uint32_t bitScanReverse(uint64_t value) { return 63 - __builtin_clzll(value); }
+static inline uint32_t bitScanForward(uint64_t value) { return __builtin_ctzll(value); }
+static inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+/*
+    VulkanMemoryBlock
+*/
+
+bool VulkanMemoryBlock::create(VkDevice device, uint32_t memory_type, VkDeviceSize size, bool is_linear, bool is_host_visible) {
+    m_memory_type = memory_type;
+    m_size = size;
+    m_is_linear = is_linear;
+
+    VkMemoryAllocateInfo allocate_info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+    if (vkAllocateMemory(device, &allocate_info, nullptr, &m_memory) != VK_SUCCESS) return false;
+
+    // Host visible blocks stay mapped for their whole lifetime, mapping is not free and a block can only be mapped once at a time anyway
+    if (is_host_visible && vkMapMemory(device, m_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped) != VK_SUCCESS) {
+        vkFreeMemory(device, m_memory, nullptr);
+        m_memory = VK_NULL_HANDLE;
+        return false;
+    }
+
+    for (auto& heads : m_free_heads)
+        for (auto& head : heads) head = NO_CHUNK;
+
+    // The whole block starts as a single free chunk
+    m_first_chunk = newChunk();
+    m_chunks[m_first_chunk].offset = 0;
+    m_chunks[m_first_chunk].size = size;
+    insertFree(m_first_chunk);
+
+    return true;
+}
+
+void VulkanMemoryBlock::destroy(VkDevice device) {
+    if (m_allocation_count > 0) Logger::warn("Destroying memory block with %u live allocations", m_allocation_count);
+    vkFreeMemory(device, m_memory, nullptr); // Implicitly unmaps
+    m_memory = VK_NULL_HANDLE;
+    m_mapped = nullptr;
+    m_chunks.clear();
+    m_unused_chunks.clear();
+}
+
+void VulkanMemoryBlock::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+    if (size < SL_COUNT) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+    } else {
+        uint32_t msb = bitScanReverse(size);
+        sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) ^ SL_COUNT;
+        fl = msb - SL_LOG2 + 1;
+    }
+}
+
+uint32_t VulkanMemoryBlock::findFreeChunk(VkDeviceSize size) {
+    // Round the request up to the next bucket boundary so any chunk in the list we land on is guaranteed to be big enough
+    if (size >= SL_COUNT) size += (VkDeviceSize(1) << (bitScanReverse(size) - SL_LOG2)) - 1;
+
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+    if (fl >= FL_COUNT) return NO_CHUNK;
+
+    uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        // Nothing left in this size class, take the smallest non-empty larger class
+        uint64_t fl_map = (fl + 1 < 64) ? m_fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (!fl_map) return NO_CHUNK;
+        fl = bitScanForward(fl_map);
+        sl_map = m_sl_bitmap[fl];
+    }
+    sl = bitScanForward(sl_map);
+
+    return m_free_heads[fl][sl];
+}
+
+void VulkanMemoryBlock::insertFree(uint32_t chunk) {
+    uint32_t fl, sl;
+    mapping(m_chunks[chunk].size, fl, sl);
+
+    uint32_t head = m_free_heads[fl][sl];
+    m_chunks[chunk].is_free = true;
+    m_chunks[chunk].prev_free = NO_CHUNK;
+    m_chunks[chunk].next_free = head;
+    if (head != NO_CHUNK) m_chunks[head].prev_free = chunk;
+    m_free_heads[fl][sl] = chunk;
+
+    m_fl_bitmap |= 1ull << fl;
+    m_sl_bitmap[fl] |= 1u << sl;
+}
+
+void VulkanMemoryBlock::removeFree(uint32_t chunk) {
+    uint32_t fl, sl;
+    mapping(m_chunks[chunk].size, fl, sl);
+
+    Chunk& c = m_chunks[chunk];
+    if (c.prev_free != NO_CHUNK) m_chunks[c.prev_free].next_free = c.next_free;
+    if (c.next_free != NO_CHUNK) m_chunks[c.next_free].prev_free = c.prev_free;
+
+    if (m_free_heads[fl][sl] == chunk) {
+        m_free_heads[fl][sl] = c.next_free;
+        if (c.next_free == NO_CHUNK) {
+            m_sl_bitmap[fl] &= ~(1u << sl);
+            if (!m_sl_bitmap[fl]) m_fl_bitmap &= ~(1ull << fl);
+        }
+    }
+
+    c.prev_free = c.next_free = NO_CHUNK;
+    c.is_free = false;
+}
+
+uint32_t VulkanMemoryBlock::newChunk() {
+    if (!m_unused_chunks.empty()) {
+        uint32_t index = m_unused_chunks.back();
+        m_unused_chunks.pop_back();
+        m_chunks[index] = Chunk{};
+        return index;
+    }
+
+    m_chunks.emplace_back();
+    return static_cast<uint32_t>(m_chunks.size() - 1);
+}
+
+uint32_t VulkanMemoryBlock::splitChunk(uint32_t chunk, VkDeviceSize size) {
+    uint32_t split = newChunk(); // May grow m_chunks, so only take references after this
+
+    Chunk& a = m_chunks[chunk];
+    Chunk& b = m_chunks[split];
+    b.offset = a.offset + size;
+    b.size = a.size - size;
+    a.size = size;
+
+    b.prev_phys = chunk;
+    b.next_phys = a.next_phys;
+    if (a.next_phys != NO_CHUNK) m_chunks[a.next_phys].prev_phys = split;
+    a.next_phys = split;
+
+    return split;
+}
+
+bool VulkanMemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, VulkanAllocation& out_allocation) {
+    // Ask for enough room to be able to align the start of whatever chunk we get
+    uint32_t chunk = findFreeChunk(size + alignment - 1);
+    if (chunk == NO_CHUNK) return false;
+    removeFree(chunk);
+
+    // Give the bytes skipped for alignment back to the free lists
+    VkDeviceSize padding = alignUp(m_chunks[chunk].offset, alignment) - m_chunks[chunk].offset;
+    if (padding > 0) {
+        uint32_t aligned = splitChunk(chunk, padding);
+        insertFree(chunk);
+        chunk = aligned;
+    }
+
+    // Return the tail if it is worth keeping
+    if (m_chunks[chunk].size - size >= MIN_CHUNK_SIZE) {
+        uint32_t tail = splitChunk(chunk, size);
+        insertFree(tail);
+    }
+
+    Chunk& c = m_chunks[chunk];
+    c.is_free = false;
+    m_used += c.size;
+    m_allocation_count++;
+
+    out_allocation = makeAllocation(chunk);
+    return true;
+}
+
+void VulkanMemoryBlock::free(uint32_t chunk) {
+    m_used -= m_chunks[chunk].size;
+    m_allocation_count--;
+
+    // Merge with free neighbours so the address space doesn't fragment into tiny pieces
+    uint32_t next = m_chunks[chunk].next_phys;
+    if (next != NO_CHUNK && m_chunks[next].is_free) {
+        removeFree(next);
+        m_chunks[chunk].size += m_chunks[next].size;
+        m_chunks[chunk].next_phys = m_chunks[next].next_phys;
+        if (m_chunks[next].next_phys != NO_CHUNK) m_chunks[m_chunks[next].next_phys].prev_phys = chunk;
+        m_unused_chunks.push_back(next);
+    }
+
+    uint32_t prev = m_chunks[chunk].prev_phys;
+    if (prev != NO_CHUNK && m_chunks[prev].is_free) {
+        removeFree(prev);
+        m_chunks[prev].size += m_chunks[chunk].size;
+        m_chunks[prev].next_phys = m_chunks[chunk].next_phys;
+        if (m_chunks[chunk].next_phys != NO_CHUNK) m_chunks[m_chunks[chunk].next_phys].prev_phys = prev;
+        m_unused_chunks.push_back(chunk);
+        chunk = prev;
+    }
+
+    insertFree(chunk);
+}
+
+VulkanAllocation VulkanMemoryBlock::makeAllocation(uint32_t chunk) const {
+    VulkanAllocation allocation;
+    allocation.memory = m_memory;
+    allocation.offset = m_chunks[chunk].offset;
+    allocation.size = m_chunks[chunk].size;
+    allocation.mapped = m_mapped ? static_cast<char*>(m_mapped) + allocation.offset : nullptr;
+    allocation.memory_type = m_memory_type;
+    allocation.block = const_cast<VulkanMemoryBlock*>(this);
+    allocation.chunk = chunk;
+    return allocation;
+}
+
+/*
+    VulkanAllocator
+*/
+
+void VulkanAllocator::create(VulkanContext& context, VkPhysicalDevice physical_device, VkDevice device) {
+    m_context = &context;
+    m_device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &m_memory_properties);
+
+    m_buffer_image_granularity = properties.limits.bufferImageGranularity;
+    m_max_allocation_count = properties.limits.maxMemoryAllocationCount;
+    m_non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+
+    Logger::info("Created device memory allocator (bufferImageGranularity: %llu, maxMemoryAllocationCount: %u)", (unsigned long long)m_buffer_image_granularity, m_max_allocation_count);
+}
+
+void VulkanAllocator::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_dedicated.empty()) Logger::warn("%zu dedicated allocations were not freed", m_dedicated.size());
+    for (auto& allocation : m_dedicated) vkFreeMemory(m_device, allocation.memory, nullptr);
+    m_dedicated.clear();
+
+    for (auto& block : m_blocks) block->destroy(m_device);
+    m_blocks.clear();
+    m_device_allocation_count = 0;
+}
+
+uint32_t VulkanAllocator::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++) {
+        if ((type_filter & (1 << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+
+    Logger::fatal("Failed to find suitable memory type!");
+    return 0;
+}
+
+VkDeviceSize VulkanAllocator::preferredBlockSize(uint32_t memory_type) {
+    // Small heaps (e.g. the 256MB host visible device local BAR) get proportionally smaller blocks so one block can't eat the heap
+    const VkDeviceSize large_block_size = 64ull * 1024 * 1024;
+    VkDeviceSize heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[memory_type].heapIndex].size;
+    return heap_size <= 1024ull * 1024 * 1024 ? heap_size / 8 : large_block_size;
+}
+
+VulkanAllocation VulkanAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool is_linear) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t memory_type = findMemoryType(requirements.memoryTypeBits, properties);
+
+    // Anything bigger than half a block would waste most of a block anyway, so give it its own memory
+    if (requirements.size > preferredBlockSize(memory_type) / 2) return allocateDedicated(requirements.size, memory_type);
+
+    VulkanAllocation allocation = allocateFromBlocks(requirements, memory_type, is_linear);
+    if (!allocation.isValid()) allocation = allocateDedicated(requirements.size, memory_type);
+    return allocation;
+}
+
+VulkanAllocation VulkanAllocator::allocateFromBlocks(const VkMemoryRequirements& requirements, uint32_t memory_type, bool is_linear) {
+    VkMemoryPropertyFlags flags = m_memory_properties.memoryTypes[memory_type].propertyFlags;
+    bool is_host_visible = flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    bool segregate = m_buffer_image_granularity > 1;
+
+    // Flushes of non coherent memory work in nonCoherentAtomSize units, so keep allocations from sharing an atom
+    VkDeviceSize alignment = requirements.alignment > 0 ? requirements.alignment : 1;
+    if (is_host_visible && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) alignment = std::max(alignment, m_non_coherent_atom_size);
+
+    VulkanAllocation allocation;
+    for (auto& block : m_blocks) {
+        if (block->getMemoryType() != memory_type) continue;
+        if (segregate && block->isLinear() != is_linear) continue;
+        if (block->allocate(requirements.size, alignment, allocation)) return allocation;
+    }
+
+    // No room in existing blocks, if the preferred size fails try smaller blocks before giving up
+    VkDeviceSize block_size = preferredBlockSize(memory_type);
+    for (int attempt = 0; attempt < 3 && block_size >= requirements.size + alignment; attempt++, block_size /= 2) {
+        auto block = std::make_unique<VulkanMemoryBlock>();
+        if (!block->create(m_device, memory_type, block_size, is_linear, is_host_visible)) continue;
+
+        m_device_allocation_count++;
+        if (!block->allocate(requirements.size, alignment, allocation)) {
+            // Alignment padding can still leave it short, don't hand out an invalid allocation from a block nobody keeps
+            block->destroy(m_device);
+            m_device_allocation_count--;
+            continue;
+        }
+        m_blocks.push_back(std::move(block));
+        Logger::debug("Allocated %llu MB memory block for memory type %u", (unsigned long long)(block_size >> 20), memory_type);
+        return allocation;
+    }
+
+    return VulkanAllocation{};
+}
+
+VulkanAllocation VulkanAllocator::allocateDedicated(VkDeviceSize size, uint32_t memory_type) {
+    VulkanAllocation allocation;
+    allocation.size = size;
+    allocation.memory_type = memory_type;
+
+    if (m_max_allocation_count && m_device_allocation_count + 1 >= m_max_allocation_count)
+        Logger::warn("Approaching maxMemoryAllocationCount (%u)", m_max_allocation_count);
+
+    VkMemoryAllocateInfo allocate_info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+    VkResult result = vkAllocateMemory(m_device, &allocate_info, nullptr, &allocation.memory);
+    if (result != VK_SUCCESS) {
+        Logger::error("Dedicated allocation of %llu bytes failed. Error: %i", (unsigned long long)size, result);
+        return VulkanAllocation{};
+    }
+
+    if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vkMapMemory(m_device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+
+    m_device_allocation_count++;
+    m_dedicated.push_back(allocation);
+    return allocation;
+}
+
+void VulkanAllocator::free(VulkanAllocation& allocation) {
+    if (!allocation.isValid()) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (allocation.block) {
+        allocation.block->free(allocation.chunk);
+        if (allocation.block->isEmpty()) releaseEmptyBlocks(true);
+    } else {
+        for (size_t i = 0; i < m_dedicated.size(); i++) {
+            if (m_dedicated[i].memory != allocation.memory) continue;
+            vkFreeMemory(m_device, allocation.memory, nullptr);
+            m_dedicated[i] = m_dedicated.back();
+            m_dedicated.pop_back();
+            m_device_allocation_count--;
+            break;
+        }
+    }
+
+    allocation = VulkanAllocation{};
+}
+
+void VulkanAllocator::releaseEmptyBlocks(bool keep_one) {
+    // Keeping one empty block per memory type avoids thrashing vkAllocateMemory when a single resource is created and destroyed repeatedly
+    std::vector<uint32_t> kept_types;
+    for (size_t i = 0; i < m_blocks.size();) {
+        VulkanMemoryBlock* block = m_blocks[i].get();
+        if (!block->isEmpty()) { i++; continue; }
+
+        uint32_t key = block->getMemoryType() * 2 + (block->isLinear() ? 1 : 0);
+        if (keep_one && std::find(kept_types.begin(), kept_types.end(), key) == kept_types.end()) {
+            kept_types.push_back(key);
+            i++;
+            continue;
+        }
+
+        block->destroy(m_device);
+        m_blocks.erase(m_blocks.begin() + i);
+        m_device_allocation_count--;
+    }
+}
+
+std::vector<VulkanHeapStats> VulkanAllocator::getHeapStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<VulkanHeapStats> stats(m_memory_properties.memoryHeapCount);
+    for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++) stats[i].heap_size = m_memory_properties.memoryHeaps[i].size;
+
+    for (auto& block : m_blocks) {
+        VulkanHeapStats& heap = stats[m_memory_properties.memoryTypes[block->getMemoryType()].heapIndex];
+        heap.block_count++;
+        heap.block_bytes += block->getSize();
+        heap.used_bytes += block->getUsedBytes();
+        heap.allocation_count += block->getAllocationCount();
+    }
+
+    for (auto& allocation : m_dedicated) {
+        VulkanHeapStats& heap = stats[m_memory_properties.memoryTypes[allocation.memory_type].heapIndex];
+        heap.dedicated_count++;
+        heap.allocation_count++;
+        heap.block_bytes += allocation.size;
+        heap.used_bytes += allocation.size;
+    }
+
+    return stats;
+}
+
+void VulkanAllocator::logStats() {
+    std::vector<VulkanHeapStats> stats = getHeapStats();
+    for (size_t i = 0; i < stats.size(); i++) {
+        const VulkanHeapStats& heap = stats[i];
+        if (heap.block_bytes == 0) continue;
+        Logger::info("Heap %zu: %.2f / %.2f MB used in %u blocks (%u allocations, %u dedicated), heap size %.0f MB", i,
+            heap.used_bytes / (1024.0 * 1024.0), heap.block_bytes / (1024.0 * 1024.0), heap.block_count,
+            heap.allocation_count, heap.dedicated_count, heap.heap_size / (1024.0 * 1024.0));
+    }
+}
@@ -1,55 +1,88 @@
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/glfw/Window.hpp"
 #include "core/Logger.hpp"
+#include "core/Profiler.hpp"
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/Vertex.hpp"
+#include "renderer/vulkan/VulkanVertexLayout.hpp"
+
+#include <chrono>
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
 
 /*
     Vulkan setup functions
 */
 
-void VulkanBackend::uploadDataRange(void* data, VulkanBuffer& buffer, VkDeviceSize size, VkQueue queue) {
+UploadToken VulkanBackend::uploadDataRange(const void* data, VulkanBuffer& buffer, VkDeviceSize offset, VkDeviceSize size) {
     /*
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT is used for the vertex buffer, which creates a GPU onlu buffer with the most optimal memory type for the graphics card to read from. However, this is not accessible by the CPU
-        So a staging buffer is used in CPU accessible memory to upload data from the vertex array to. Then we copy the data from the staging buffer to the vertex buffer using a buffer copy command.
+        So the data is written into the persistently mapped staging ring, and the copy into the vertex buffer is batched with every other upload this frame and submitted at the start of the next frame.
+        Nothing is known about who reads the range, so the copy waits for the frames in flight in case they still do.
     */
-    VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    VulkanBuffer staging_buffer;
-    staging_buffer.create(m_context, size, usage_flags, flags);
-    staging_buffer.loadData(data);
-    staging_buffer.copyBufferTo(buffer, queue, size);
-    staging_buffer.destroy();
+    return m_context.staging_ring.upload(data, size, buffer, offset, true);
 }
 
-void VulkanBackend::init(const char* appName, Window* window) {
+void VulkanBackend::init(const char* appName, Window* window, uint32_t headless_width, uint32_t headless_height, const SwapchainConfig& swapchain_config) {
+    auto init_start = std::chrono::steady_clock::now();
     m_context.window = window;
-    int width, height;
+    m_context.headless = window == nullptr;
+    int width = headless_width, height = headless_height;
 
     createInstance(appName);
     createDebugCallback();
 
-    window->createVulkanSurface(m_context.instance, m_context.surface);
-    window->getFramebufferSize(width, height);
+    if (!m_context.headless) {
+        window->createVulkanSurface(m_context.instance, m_context.surface);
+        window->getFramebufferSize(width, height);
+    } else {
+        Logger::info("Rendering headless at %dx%d", width, height);
+    }
 
     m_context.framebuffer_width = width;
     m_context.framebuffer_height = height;
 
     m_context.device.create(m_context);
+    m_context.frame_timeline.create(m_context);
+    m_context.deletion_queue.create(m_context);
+    m_context.swapchain.setConfig(swapchain_config);
     m_context.swapchain.create(width, height, m_context);
     m_context.renderpass.create(m_context, glm::vec2(width, height), glm::vec2(0, 0), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), 1.0f, 0);
     m_context.swapchain.regenerateFramebuffers();
 
     createCommandBuffers();
-    createSyncObjects();
-
+    createFrameSyncObjects();
+    createFrameArenas();
+    createPresentSemaphores();
+    m_context.draw_recorder.create(m_context, m_context.max_frames_in_flight);
+    m_context.instance_ring.create(m_context, m_context.max_frames_in_flight, 16 * 1024);
+    m_context.gpu_profiler.create(m_context, m_context.max_frames_in_flight);
+
+    m_context.pipeline_states.create(m_context);
     std::string path = std::string(SHADER_DIR) + "object";
-    
-    m_context.object_shader.create(m_context, path);
 
-    createBuffers();
+    VulkanPipelineDescription vertex_input;
+    setVertexLayout<Vertex3D>(vertex_input);
+    m_context.object_shader.create(m_context, path + ".vert.spv", path + ".frag.spv", vertex_input);
+
+    setVertexLayout<VertexQuantized>(vertex_input);
+    vertex_input.push_constant_ranges.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization) });
+    m_context.quantized_object_shader.create(m_context, path + "_quantized.vert.spv", path + ".frag.spv", vertex_input);
+
+    setVertexLayout<Vertex3D>(vertex_input);
+    addInstanceLayout<InstanceData>(vertex_input);
+    vertex_input.push_constant_ranges.clear();
+    m_context.instanced_object_shader.create(m_context, path + "_instanced.vert.spv", path + ".frag.spv", vertex_input);
 
-    // TODO: Temporary
+    m_context.staging_ring.create(m_context, 32 * 1024 * 1024);
+    m_context.geometry.create(m_context, 1024 * 1024 * sizeof(Vertex3D), 1024 * 1024);
+    m_context.gpu_scene.create(m_context, m_context.max_frames_in_flight, SHADER_DIR);
+
+    /*
+        The test triangle is drawn in place of an empty frame, so an empty scene still shows that the pipeline works (the benchmark's cull scene relies on it)
+        It's the first mesh in the pool, so compacting never moves it
+    */
     const uint32_t vertex_count = 3;
     Vertex3D vertices[vertex_count] = {};
     vertices[0].position.x = 0.0;
@@ -61,8 +94,10 @@ void VulkanBackend::init(const char* appName, Window* window) {
     const uint32_t index_count = 3;
     uint32_t indices[index_count] = { 0,1,2 };
 
-    uploadDataRange(vertices, m_context.object_vertex_buffer, sizeof(Vertex3D) * vertex_count, m_context.device.getGraphicsQueue());
-    uploadDataRange(indices, m_context.object_index_buffer, sizeof(uint32_t) * index_count, m_context.device.getGraphicsQueue());
+    m_context.test_triangle = uploadMesh(vertices, vertex_count, indices, index_count);
+
+    std::chrono::duration<double, std::milli> init_time = std::chrono::steady_clock::now() - init_start;
+    Logger::info("Vulkan backend initialised in %.2f ms (%s pipeline cache)", init_time.count(), m_context.device.isPipelineCacheWarm() ? "warm" : "cold");
 }
 
 void VulkanBackend::createInstance(const char* appName) {
@@ -108,8 +143,8 @@ std::vector<const char*> VulkanBackend::getRequiredInstanceExtensions() {
         - Debug utils added is validaion layers are enabled
     */
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = m_context.window->getGLFWExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = nullptr;
+    if (m_context.window) glfwExtensions = m_context.window->getGLFWExtensions(&glfwExtensionCount); // Headless doesn't need any surface extensions
 
     std::vector<const char*> extensions;
     for(uint32_t i = 0; i < glfwExtensionCount; i++)
@@ -149,7 +184,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
             Logger::error("Default debug callback");
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-            Logger::info("%s", pCallbackData->pMessage);
+            Logger::debug("%s", pCallbackData->pMessage);
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
             Logger::info("%s", pCallbackData->pMessage);
@@ -185,74 +220,119 @@ void VulkanBackend::createDebugCallback() {
 }
 
 void VulkanBackend::createCommandBuffers() {
-    m_context.commandBuffers.resize(m_context.swapchain.getImageCount());
-    for (int i = 0; i < m_context.commandBuffers.size(); i++) {
-        if (m_context.commandBuffers[i].getHandle() != VK_NULL_HANDLE) m_context.commandBuffers[i].free();
-        m_context.commandBuffers[i].allocate(m_context, m_context.device.getCommandPool(), true);
+    for (auto& command_buffer : m_context.commandBuffers) {
+        if (command_buffer.getHandle() != VK_NULL_HANDLE) command_buffer.free();
     }
+
+    m_context.commandBuffers.resize(m_context.max_frames_in_flight);
+    for (auto& command_buffer : m_context.commandBuffers) command_buffer.allocate(m_context, m_context.device.getCommandPool(), true);
 }
 
-void VulkanBackend::createSyncObjects() {
+void VulkanBackend::createFrameSyncObjects() {
+    // Only called when no frame is in flight, so the old semaphores aren't in use
+    for (auto& semaphore : m_context.image_acquire_semaphores) vkDestroySemaphore(m_context.device.getLogicalDevice(), semaphore, nullptr);
+
     int frame_count = m_context.max_frames_in_flight;
     m_context.image_acquire_semaphores.resize(frame_count);
-    m_context.queue_submit_semaphores.resize(m_context.swapchain.getImageCount());
-    m_context.in_flight_fences.resize(frame_count);
-    m_context.images_in_flight.resize(m_context.swapchain.getImageCount(), nullptr);
+    m_context.frame_values.assign(frame_count, 0);
 
     for (int i = 0; i < frame_count; i++) {
         VkSemaphoreCreateInfo semaphore_create_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
         vkCreateSemaphore(m_context.device.getLogicalDevice(), &semaphore_create_info, nullptr, &m_context.image_acquire_semaphores[i]);
-
-        m_context.in_flight_fences[i].create(m_context, true);
     }
+}
 
-    for (int i = 0; i < m_context.swapchain.getImageCount(); i++) {
+void VulkanBackend::createPresentSemaphores() {
+    /*
+        A present waits on its image's semaphore some time after the frame was submitted, and normally acquiring the image again is what shows that the wait has happened
+        Images of a replaced swapchain are never acquired again, so on recreation the old semaphores are retired through the deletion queue a frame after their last present, and the new images get new ones
+    */
+    for (auto& semaphore : m_context.queue_submit_semaphores) m_context.deletion_queue.pushSemaphore(semaphore);
+    m_context.queue_submit_semaphores.resize(m_context.swapchain.getImageCount());
+
+    for (auto& semaphore : m_context.queue_submit_semaphores) {
         VkSemaphoreCreateInfo semaphore_create_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-        vkCreateSemaphore(m_context.device.getLogicalDevice(), &semaphore_create_info, nullptr, &m_context.queue_submit_semaphores[i]);
+        vkCreateSemaphore(m_context.device.getLogicalDevice(), &semaphore_create_info, nullptr, &semaphore);
     }
 }
 
-void VulkanBackend::createBuffers() {
-    VkMemoryPropertyFlagBits memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; // This is a GPU only buffer and is the most optimal memory type for graphics cards to read from
-    VkBufferUsageFlags vertex_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    VkBufferUsageFlags index_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-    const u_int64_t vertex_buffer_size = sizeof(Vertex3D) * 1024 * 1024;
-    m_context.object_vertex_buffer.create(m_context, vertex_buffer_size, vertex_flags, memory_property_flags);
-    m_context.geometry_vertex_offset = 0;
-
-    const u_int64_t index_buffer_size = sizeof(uint32_t) * 1024 * 1024;
-    m_context.object_index_buffer.create(m_context, index_buffer_size, index_flags, memory_property_flags);
-    m_context.geometry_index_offset = 0;
+void VulkanBackend::createFrameArenas() {
+    // Arenas keep their memory (and any growth) if the number of frames in flight didn't change
+    while (m_context.frame_arenas.size() > m_context.max_frames_in_flight) {
+        m_context.frame_arenas.back()->destroy();
+        m_context.frame_arenas.pop_back();
+    }
+    while (m_context.frame_arenas.size() < m_context.max_frames_in_flight) {
+        m_context.frame_arenas.push_back(std::make_unique<LinearAllocator>());
+        m_context.frame_arenas.back()->create(1024 * 1024);
+    }
 }
 
 void VulkanBackend::recreateSwapchain() {
-    vkDeviceWaitIdle(m_context.device.getLogicalDevice());
+    /*
+        Only the size dependent state is recreated, and nothing waits for the GPU:
+        - The swapchain hands over to the new one, and the old one, its views, framebuffers and depth image go through the deletion queue
+        - Command buffers, acquire semaphores, frame arenas, draw recorder pools, query pools, instance buffers and GPU scene buffers are per frame in flight and don't care about the size
+        So a window being resized continuously just builds a few new objects per frame while the old frames keep rendering
+    */
+    WYVERN_PROFILE_SCOPE("Recreate swapchain");
+    unsigned int frames_in_flight = m_context.max_frames_in_flight;
+
     m_context.swapchain.recreate(m_context.framebuffer_width, m_context.framebuffer_height);
     m_context.renderpass.setNewSize(m_context.framebuffer_width, m_context.framebuffer_height);
     m_context.swapchain.regenerateFramebuffers();
+    createPresentSemaphores();
+
+    # if defined(_DEBUG)
+        m_context.frames_since_recreate = 0;
+    # endif
+
+    if (m_context.max_frames_in_flight == frames_in_flight) return;
+
+    // The new swapchain has a different number of images, so there's a different number of frames in flight and everything per frame has to be rebuilt
+    Logger::info("Frames in flight changed from %u to %u", frames_in_flight, m_context.max_frames_in_flight);
+    m_context.frame_timeline.wait(m_context.frame_timeline.getLastSubmittedValue());
+    m_context.current_frame = 0;
 
     createCommandBuffers();
-    cleanupSyncObjects();
-    createSyncObjects();
+    createFrameSyncObjects();
+    createFrameArenas();
+    m_context.draw_recorder.destroy();
+    m_context.draw_recorder.create(m_context, m_context.max_frames_in_flight);
+    m_context.instance_ring.recreateFrames(m_context.max_frames_in_flight);
+    m_context.gpu_profiler.destroy();
+    m_context.gpu_profiler.create(m_context, m_context.max_frames_in_flight);
+    m_context.gpu_scene.recreateFrames(m_context.max_frames_in_flight);
 }
 
 /*
     Vulkan cleanup functions
 */
 void VulkanBackend::shutdown() {
-    m_context.object_vertex_buffer.destroy();
-    m_context.object_index_buffer.destroy();
-    m_context.pipeline.destroy();
+    m_context.staging_ring.destroy();
+    if (m_context.readback_size > 0) m_context.readback_buffer.destroy();
+    m_context.geometry.destroy();
+    m_context.instance_ring.destroy();
+    m_context.pipeline_states.destroy();
+    m_context.device.savePipelineCache(); // After the state cache has waited for background compiles, so they're saved too
     m_context.object_shader.destroy();
+    m_context.quantized_object_shader.destroy();
+    m_context.instanced_object_shader.destroy();
     vkDeviceWaitIdle(m_context.device.getLogicalDevice());
 
     cleanupSyncObjects();
+    m_context.draw_recorder.destroy();
+    m_context.gpu_scene.destroy();
+    m_context.gpu_profiler.destroy();
+    for (auto& arena : m_context.frame_arenas) arena->destroy();
+    m_context.frame_arenas.clear();
     
     for (auto& command_buffer : m_context.commandBuffers) command_buffer.free();
 
     m_context.renderpass.destroy();
     m_context.swapchain.destroy();
+    m_context.deletion_queue.destroy(); // The device is idle, so everything left can go
+    m_context.frame_timeline.destroy();
     m_context.device.destroy();
 
     # if defined(_DEBUG)
@@ -269,95 +349,159 @@ void VulkanBackend::shutdown() {
 void VulkanBackend::cleanupSyncObjects() {
     for (auto& semaphore : m_context.image_acquire_semaphores) vkDestroySemaphore(m_context.device.getLogicalDevice(), semaphore, nullptr);
     for (auto& semaphore : m_context.queue_submit_semaphores) vkDestroySemaphore(m_context.device.getLogicalDevice(), semaphore, nullptr);
-    for (auto& fence : m_context.in_flight_fences) fence.destroy();
 
     m_context.image_acquire_semaphores.clear();
     m_context.queue_submit_semaphores.clear();
-    m_context.in_flight_fences.clear();
+    m_context.frame_values.clear();
 }
 
 /*
     Vulkan drawing functions
 */
 
-bool VulkanBackend::beginFrame(float dt) {
+bool VulkanBackend::beginFrame(const RenderPacket& packet) {
+    WYVERN_PROFILE_SCOPE("VulkanBackend::beginFrame");
+
+    /*
+        Resizes are handled before acquiring, since an acquired image has to be presented before the swapchain can move on
+        They also come before anything per frame is looked up: if the number of frames in flight changes, current_frame goes back to 0
+        and the command buffers, semaphores and arenas are rebuilt
+    */
+    if (m_context.window_resized) {
+        m_context.window_resized = false;
+        recreateSwapchain();
+    }
+
     int current_frame = m_context.current_frame;
 
-    // Once fence is free it will be allowed to move on, if fence taking long time return
-    if (!m_context.in_flight_fences[current_frame].wait(UINT64_MAX)) return false;
-    
+    // Wait for the last frame submitted from this frame in flight, the one frames_in_flight frames ago
+    {
+        WYVERN_PROFILE_SCOPE("Wait for frame");
+        uint64_t frame_value = m_context.frame_values[current_frame];
+        if (frame_value > 0 && !m_context.frame_timeline.wait(frame_value)) return false;
+    }
+    m_context.deletion_queue.collect();
+    m_context.geometry.collect();
+    m_context.gpu_profiler.collect(current_frame);
+
+    // Nothing from the last time this frame was in flight is in use anymore
+    m_context.frame_arenas[current_frame]->reset();
+    LinearAllocator& arena = *m_context.frame_arenas[current_frame];
+
+    WYVERN_PROFILE_SCOPE("Acquire swapchain image");
     VkResult result = m_context.swapchain.acquireNextImageIndex(m_context.image_acquire_semaphores[current_frame], &m_context.image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_context.window_resized) {
-        recreateSwapchain();
-        m_context.window_resized = false;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        recreateSwapchain(); // Nothing was acquired, so the semaphore stays unsignalled and the frame can be retried
         return false;
+    } else if (result == VK_SUBOPTIMAL_KHR) {
+        m_context.window_resized = true; // The image is still usable, so this frame is drawn and the swapchain recreated before the next one
     } else if (result != VK_SUCCESS) {
         Logger::fatal("Failed to acquire swapchain image!");
         return false;
     }
 
+    m_context.frame_wait_semaphores.clear();
+    m_context.frame_wait_stages.clear();
+    if (!m_context.headless) { // Offscreen images are ready straight away
+        m_context.frame_wait_semaphores.push_back(m_context.image_acquire_semaphores[current_frame]);
+        m_context.frame_wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+
+    /*
+        Submit everything uploaded since the last frame as one batch
+        This happens after the image is acquired so this frame is guaranteed to be submitted, and to wait on the batch if it went to the transfer queue
+    */
+    m_context.gpu_scene.update(current_frame);
+    m_context.staging_ring.flush();
+
     // Begin recording commands and then renderpass for current frame
-    VulkanCommandBuffer* command_buffer = &m_context.commandBuffers[m_context.image_index];
+    VulkanCommandBuffer* command_buffer = &m_context.commandBuffers[current_frame];
     command_buffer->reset();
     command_buffer->beginRecording();
-    m_context.renderpass.begin(command_buffer, m_context.swapchain.getFrameBuffer(m_context.image_index).getHandle());
-
-    // Dynamic state
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) m_context.framebuffer_width;
-    viewport.height = (float) m_context.framebuffer_height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // Scissor
-    VkRect2D scissor;
-    scissor.offset.x = scissor.offset.y = 0;
-    scissor.extent.width = m_context.framebuffer_width;
-    scissor.extent.height = m_context.framebuffer_height;
-
-    // TODO: Temp
-    m_context.object_shader.use();
-    vkCmdSetViewport(command_buffer->getHandle(), 0, 1, &viewport);
-    vkCmdSetScissor(command_buffer->getHandle(), 0, 1, &scissor);
-
-    VkDeviceSize offsets[1] = {0};
-    vkCmdBindVertexBuffers(command_buffer->getHandle(), 0, 1, &m_context.object_vertex_buffer.getHandle(), (VkDeviceSize*)offsets);
-    vkCmdBindIndexBuffer(command_buffer->getHandle(), m_context.object_index_buffer.getHandle(), 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(command_buffer->getHandle(), 3, 1, 0, 0, 0);
+    m_context.gpu_profiler.beginFrame(*command_buffer, current_frame); // First, so the GPU frame scope also covers the acquires, moves and culling
+    m_context.staging_ring.recordAcquires(*command_buffer, m_context.frame_wait_semaphores, m_context.frame_wait_stages); // Has to be outside the renderpass
+    m_context.geometry.recordMoves(*command_buffer);
+    m_context.gpu_scene.recordCull(current_frame, *command_buffer);
+    VkFramebuffer& framebuffer = m_context.swapchain.getFrameBuffer(m_context.image_index).getHandle();
+    m_context.renderpass_gpu_scope = m_context.gpu_profiler.beginScope(*command_buffer, "Renderpass");
+    m_context.renderpass.begin(command_buffer, framebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    const VulkanDrawCommand* draws = packet.draws;
+    size_t draw_count = packet.draw_count;
+    FrameVector<VulkanDrawCommand> draw_commands(arena);
+    if (draw_count == 0 && !m_context.gpu_scene.hasDraws(current_frame)) {
+        // Nothing to draw at all, show the test triangle instead
+        draw_commands.push_back(m_context.test_triangle.getDrawCommand());
+        draws = draw_commands.data();
+        draw_count = draw_commands.size();
+    }
+
+    // Draws with instance data are merged into instanced draws before recording
+    size_t batched_count = 0;
+    const VulkanDrawCommand* batched_draws = m_context.instance_ring.batch(current_frame, arena, draws, draw_count, batched_count);
+    m_context.draw_recorder.record(current_frame, *command_buffer, framebuffer, batched_draws, batched_count);
+    m_context.gpu_scene.recordDraws(current_frame, *command_buffer, framebuffer);
 
     return true;
 }
 
 void VulkanBackend::endFrame(float dt) {
-    VulkanCommandBuffer* command_buffer = &m_context.commandBuffers[m_context.image_index];
+    WYVERN_PROFILE_SCOPE("VulkanBackend::endFrame");
+    VulkanCommandBuffer* command_buffer = &m_context.commandBuffers[m_context.current_frame];
 
     m_context.renderpass.end(command_buffer);
-    command_buffer->endRecording();
-
-    // Make sure previous frame was not using this image, if it was then wait for it to complete
-    if (m_context.images_in_flight[m_context.image_index] != VK_NULL_HANDLE) m_context.images_in_flight[m_context.image_index]->wait(UINT64_MAX);
+    m_context.gpu_profiler.endScope(*command_buffer, m_context.renderpass_gpu_scope);
+    m_context.gpu_profiler.endFrame(*command_buffer);
+
+    const char* capture_path = m_capture_path;
+    m_capture_path = nullptr;
+    if (capture_path && !m_context.headless) {
+        Logger::warn("Frame capture is only supported when rendering headless");
+        capture_path = nullptr;
+    }
+    if (capture_path) recordCapture(*command_buffer);
 
-    m_context.images_in_flight[m_context.image_index] = &m_context.in_flight_fences[m_context.current_frame];
-    m_context.in_flight_fences[m_context.current_frame].reset();
+    command_buffer->endRecording();
 
     VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    VkPipelineStageFlags flags[1] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submit_info.pWaitDstStageMask = flags;
+    submit_info.pWaitDstStageMask = m_context.frame_wait_stages.data();
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &command_buffer->getHandle();
-    submit_info.signalSemaphoreCount = 1;
+    submit_info.signalSemaphoreCount = m_context.headless ? 0 : 1; // Nothing waits for it without a present
     submit_info.pSignalSemaphores = &m_context.queue_submit_semaphores[m_context.image_index];
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &m_context.image_acquire_semaphores[m_context.current_frame];
-
-    VkResult result = vkQueueSubmit(m_context.device.getGraphicsQueue(), 1, &submit_info, m_context.in_flight_fences[m_context.current_frame].getHandle());
-    if (result != VK_SUCCESS) Logger::error("vkQueueSubmit failed with result: %s", result);
-    command_buffer->updateSubmitted();
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(m_context.frame_wait_semaphores.size());
+    submit_info.pWaitSemaphores = m_context.frame_wait_semaphores.data();
+
+    {
+        WYVERN_PROFILE_SCOPE("Queue submit");
+        m_context.frame_values[m_context.current_frame] = m_context.frame_timeline.submit(m_context.device.getGraphicsQueue(), submit_info);
+        command_buffer->updateSubmitted();
+        m_context.gpu_profiler.onSubmit();
+    }
 
-    m_context.swapchain.present(m_context.device.getPresentQueue(), m_context.queue_submit_semaphores[m_context.image_index], m_context.image_index);
+    {
+        WYVERN_PROFILE_SCOPE("Present");
+        VkResult result = m_context.swapchain.present(m_context.device.getPresentQueue(), m_context.queue_submit_semaphores[m_context.image_index], m_context.image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) m_context.window_resized = true;
+    }
     
+    # if defined(_DEBUG)
+        /*
+            Once warmed up a frame shouldn't touch the heap, per frame data belongs in the frame arena
+            The arena counts the allocations that didn't fit and went to the heap, after a few frames it has grown to fit a steady state frame
+        */
+        size_t heap_allocations = m_context.frame_arenas[m_context.current_frame]->getOverflowCount();
+        if (m_context.frames_since_recreate++ > 2 * m_context.max_frames_in_flight && heap_allocations > 0) {
+            Logger::error("%zu heap allocations during a frame", heap_allocations);
+            assert(heap_allocations == 0);
+        }
+    # endif
+
+    if (capture_path) {
+        m_context.frame_timeline.wait(m_context.frame_values[m_context.current_frame]);
+        writeCapture(capture_path);
+    }
+
     m_context.current_frame = (m_context.current_frame + 1) % m_context.max_frames_in_flight;
 }
 
@@ -367,8 +511,92 @@ void VulkanBackend::onWindowResize(int width, int height) {
 
     int w, h;
     m_context.window->getFramebufferSize(w, h);
-    m_context.framebuffer_width = w;
-    m_context.framebuffer_height = h;
+    onFramebufferResize(w, h);
+}
+
+void VulkanBackend::onFramebufferResize(int width, int height) {
+    m_context.framebuffer_width = width;
+    m_context.framebuffer_height = height;
 
     m_context.window_resized = true;
-}
\ No newline at end of file
+}
+
+/*
+    Frame capture
+*/
+
+void VulkanBackend::recordCapture(VulkanCommandBuffer& command_buffer) {
+    VkExtent2D extent = m_context.swapchain.getSwapchainExtent();
+    VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+
+    if (m_context.readback_size < size) {
+        if (m_context.readback_size > 0) m_context.readback_buffer.destroy();
+        m_context.readback_buffer.create(m_context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_context.readback_size = size;
+    }
+
+    // The renderpass leaves the image in TRANSFER_SRC_OPTIMAL, but the copy still has to wait for the color writes
+    VkImage image = m_context.swapchain.getImage(m_context.image_index);
+    VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(command_buffer.getHandle(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(command_buffer.getHandle(), image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_context.readback_buffer.getHandle(), 1, &region);
+
+    // Make the copy visible to the host once the frame retires
+    VkBufferMemoryBarrier host_barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.buffer = m_context.readback_buffer.getHandle();
+    host_barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &host_barrier, 0, nullptr);
+}
+
+bool VulkanBackend::writeCapture(const char* path) {
+    VkExtent2D extent = m_context.swapchain.getSwapchainExtent();
+    const uint8_t* pixels = static_cast<const uint8_t*>(m_context.readback_buffer.getAllocation().mapped);
+    if (!pixels) {
+        Logger::error("Readback buffer isn't host visible, can't capture the frame");
+        return false;
+    }
+
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        Logger::error("Failed to open %s to write the captured frame", path);
+        return false;
+    }
+
+    // Binary PPM is RGB with no padding, the offscreen images are BGRA
+    std::fprintf(file, "P6\n%u %u\n255\n", extent.width, extent.height);
+    uint8_t row[3 * 4096];
+    for (uint32_t y = 0; y < extent.height; y++) {
+        const uint8_t* src = pixels + VkDeviceSize(y) * extent.width * 4;
+        for (uint32_t x = 0; x < extent.width; x += 4096) {
+            uint32_t count = std::min(extent.width - x, 4096u);
+            for (uint32_t i = 0; i < count; i++) {
+                row[i * 3 + 0] = src[(x + i) * 4 + 2];
+                row[i * 3 + 1] = src[(x + i) * 4 + 1];
+                row[i * 3 + 2] = src[(x + i) * 4 + 0];
+            }
+            std::fwrite(row, 3, count, file);
+        }
+    }
+
+    bool success = std::ferror(file) == 0;
+    std::fclose(file);
+    if (success) Logger::info("Captured frame to %s", path);
+    else Logger::error("Failed to write captured frame to %s", path);
+    return success;
+}
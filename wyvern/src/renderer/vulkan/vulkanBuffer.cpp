@@ -21,13 +21,9 @@ void VulkanBuffer::create(VulkanContext& context, VkDeviceSize size, VkBufferUsa
     VkMemoryRequirements mem_requirements;
     vkGetBufferMemoryRequirements(m_context->device.getLogicalDevice(), m_buffer, &mem_requirements);
 
-    VkMemoryAllocateInfo allocate_info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    allocate_info.allocationSize = mem_requirements.size;
-    allocate_info.memoryTypeIndex = m_context->device.findMemoryType(mem_requirements.memoryTypeBits, properties);
-
-    result = vkAllocateMemory(m_context->device.getLogicalDevice(), &allocate_info, nullptr, &m_memory);
-    if (result != VK_SUCCESS) {
-        Logger::error("Unable to create vulkan buffer because the required memory allocation failed. Error: %i", result);
+    m_allocation = m_context->device.getAllocator().allocate(mem_requirements, properties, true);
+    if (!m_allocation.isValid()) {
+        Logger::error("Unable to create vulkan buffer because the required memory allocation failed");
         return;
     }
 
@@ -35,22 +31,30 @@ void VulkanBuffer::create(VulkanContext& context, VkDeviceSize size, VkBufferUsa
 }
 
 void VulkanBuffer::destroy() {
-    vkDeviceWaitIdle(m_context->device.getLogicalDevice());
+    // Frames in flight may still read the buffer, so it's only really destroyed once they've retired
     is_bound = false;
-    vkDestroyBuffer(m_context->device.getLogicalDevice(), m_buffer, nullptr);
-    vkFreeMemory(m_context->device.getLogicalDevice(), m_memory, nullptr);
+    m_context->deletion_queue.pushBuffer(m_buffer);
+    m_context->deletion_queue.pushAllocation(m_allocation);
+    m_buffer = VK_NULL_HANDLE;
+    m_allocation = VulkanAllocation();
 }
 
 void VulkanBuffer::bind(VkDeviceSize offset) {
-    VkResult result = vkBindBufferMemory(m_context->device.getLogicalDevice(), m_buffer, m_memory, offset);
+    VkResult result = vkBindBufferMemory(m_context->device.getLogicalDevice(), m_buffer, m_allocation.memory, m_allocation.offset + offset);
     if (result != VK_SUCCESS) Logger::error("Failed to bind buffer");
 }
 
-void VulkanBuffer::loadData(const void* data, VkDeviceSize offset) {
-    void* data_ptr;
-    VkResult result = vkMapMemory(m_context->device.getLogicalDevice(), m_memory, offset, m_size, 0, &data_ptr);
-    memcpy(data_ptr, data, m_size);
-    vkUnmapMemory(m_context->device.getLogicalDevice(), m_memory);
+void VulkanBuffer::loadData(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+    // Host visible memory is persistently mapped by the allocator, so this is just a copy
+    if (!m_allocation.mapped) {
+        Logger::error("Tried to load data into a buffer that is not host visible");
+        return;
+    }
+    if (offset > m_size || size > m_size - offset) {
+        Logger::error("Tried to load %llu bytes at offset %llu into a buffer of %llu bytes", (unsigned long long)size, (unsigned long long)offset, (unsigned long long)m_size);
+        return;
+    }
+    memcpy(static_cast<char*>(m_allocation.mapped) + offset, data, size);
 }
 
 void VulkanBuffer::copyBufferFrom(VulkanBuffer& src_buffer, VkQueue queue, VkDeviceSize size, VkDeviceSize src_offset, VkDeviceSize dst_offset) {
@@ -37,6 +37,23 @@ void VulkanCommandBuffer::beginRecording(bool is_single_use, bool is_renderpass_
     m_state = CommandBufferState::RECORDING;
 }
 
+void VulkanCommandBuffer::beginRecordingSecondary(VkRenderPass renderpass, uint32_t subpass, VkFramebuffer framebuffer, bool is_single_use) {
+    VkCommandBufferInheritanceInfo inheritance_info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance_info.renderPass = renderpass;
+    inheritance_info.subpass = subpass;
+    inheritance_info.framebuffer = framebuffer; // Optional, but lets the driver optimise for the exact framebuffer
+
+    VkCommandBufferBeginInfo begin_info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    if (is_single_use) begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VkResult result = vkBeginCommandBuffer(m_commandBuffer, &begin_info);
+    if (result != VK_SUCCESS) Logger::fatal("Failed to begin recording secondary command buffer!");
+
+    m_state = CommandBufferState::IN_RENDER_PASS;
+}
+
 void VulkanCommandBuffer::endRecording() {
     VkResult result = vkEndCommandBuffer(m_commandBuffer);
     if (result != VK_SUCCESS) Logger::fatal("Failed to record command buffer");
@@ -0,0 +1,140 @@
+#include "renderer/vulkan/VulkanDeletionQueue.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+
+void VulkanDeletionQueue::create(VulkanContext& context) {
+    m_context = &context;
+    m_entries.reserve(256);
+}
+
+void VulkanDeletionQueue::destroy() {
+    flush();
+    m_entries.shrink_to_fit();
+}
+
+void VulkanDeletionQueue::pushBuffer(VkBuffer buffer) {
+    if (buffer == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::BUFFER;
+    entry.buffer = buffer;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushImage(VkImage image) {
+    if (image == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::IMAGE;
+    entry.image = image;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushImageView(VkImageView image_view) {
+    if (image_view == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::IMAGE_VIEW;
+    entry.image_view = image_view;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushFramebuffer(VkFramebuffer framebuffer) {
+    if (framebuffer == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::FRAMEBUFFER;
+    entry.framebuffer = framebuffer;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushPipeline(VkPipeline pipeline) {
+    if (pipeline == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::PIPELINE;
+    entry.pipeline = pipeline;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushPipelineLayout(VkPipelineLayout pipeline_layout) {
+    if (pipeline_layout == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::PIPELINE_LAYOUT;
+    entry.pipeline_layout = pipeline_layout;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushSwapchain(VkSwapchainKHR swapchain) {
+    if (swapchain == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::SWAPCHAIN;
+    entry.swapchain = swapchain;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushSemaphore(VkSemaphore semaphore) {
+    if (semaphore == VK_NULL_HANDLE) return;
+    Entry entry;
+    entry.type = ResourceType::SEMAPHORE;
+    entry.semaphore = semaphore;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushAllocation(const VulkanAllocation& allocation) {
+    if (!allocation.isValid()) return;
+    Entry entry;
+    entry.type = ResourceType::ALLOCATION;
+    entry.allocation = allocation;
+    pushEntry(entry);
+}
+
+void VulkanDeletionQueue::pushEntry(Entry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The frame being recorded might already use the resource, so it has to wait for that frame rather than the last submitted one
+    entry.frame_value = m_context->frame_timeline.getNextValue();
+    m_entries.push_back(entry);
+}
+
+void VulkanDeletionQueue::collect() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while (m_first < m_entries.size() && m_context->frame_timeline.isRetired(m_entries[m_first].frame_value)) {
+        destroyEntry(m_entries[m_first]);
+        m_first++;
+    }
+
+    // Only move the live entries down once the destroyed ones make up most of the vector, so collecting stays cheap
+    if (m_first == m_entries.size()) {
+        m_entries.clear();
+        m_first = 0;
+    } else if (m_first > m_entries.size() / 2) {
+        m_entries.erase(m_entries.begin(), m_entries.begin() + m_first);
+        m_first = 0;
+    }
+}
+
+void VulkanDeletionQueue::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = m_first; i < m_entries.size(); i++) destroyEntry(m_entries[i]);
+    m_entries.clear();
+    m_first = 0;
+}
+
+size_t VulkanDeletionQueue::getPendingCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size() - m_first;
+}
+
+void VulkanDeletionQueue::destroyEntry(Entry& entry) {
+    VkDevice device = m_context->device.getLogicalDevice();
+
+    switch (entry.type) {
+        case ResourceType::BUFFER: vkDestroyBuffer(device, entry.buffer, nullptr); break;
+        case ResourceType::IMAGE: vkDestroyImage(device, entry.image, nullptr); break;
+        case ResourceType::IMAGE_VIEW: vkDestroyImageView(device, entry.image_view, nullptr); break;
+        case ResourceType::FRAMEBUFFER: vkDestroyFramebuffer(device, entry.framebuffer, nullptr); break;
+        case ResourceType::PIPELINE: vkDestroyPipeline(device, entry.pipeline, nullptr); break;
+        case ResourceType::PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, entry.pipeline_layout, nullptr); break;
+        case ResourceType::SWAPCHAIN: vkDestroySwapchainKHR(device, entry.swapchain, nullptr); break;
+        case ResourceType::SEMAPHORE: vkDestroySemaphore(device, entry.semaphore, nullptr); break;
+        case ResourceType::ALLOCATION: m_context->device.getAllocator().free(entry.allocation); break;
+    }
+}
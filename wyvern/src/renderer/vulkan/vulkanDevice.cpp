@@ -3,15 +3,31 @@
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/Logger.hpp"
 
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
 void VulkanDevice::create(VulkanContext& context) {
     m_context = &context;
+
+    // Without a surface nothing is presented, so the swapchain extension isn't needed (software drivers may not even have it)
+    if (m_context->headless) m_deviceExtensions.erase(std::remove(m_deviceExtensions.begin(), m_deviceExtensions.end(), std::string(VK_KHR_SWAPCHAIN_EXTENSION_NAME)), m_deviceExtensions.end());
+
     if (selectPhysicalDevice(m_context->instance, m_context->surface)) Logger::info("Successfully selected physical device");
     createLogicalDevice(m_context->surface);
+    m_allocator.create(context, m_physicalDevice, m_logicalDevice);
     createGraphicsCommandPool();
+    createTransferCommandPool();
     findSupportedDepthFormat();
+    createPipelineCache();
 }
 
 void VulkanDevice::destroy() {
+    vkDestroyPipelineCache(m_logicalDevice, m_pipeline_cache, nullptr);
+    m_allocator.logStats();
+    m_allocator.destroy();
+    if (m_transferCommandPool != VK_NULL_HANDLE) vkDestroyCommandPool(m_context->device.getLogicalDevice(), m_transferCommandPool, nullptr);
     vkDestroyCommandPool(m_context->device.getLogicalDevice(), m_graphicsCommandPool, nullptr);
     vkDestroyDevice(m_logicalDevice, nullptr);
 }
@@ -41,6 +57,11 @@ bool VulkanDevice::selectPhysicalDevice(VkInstance& instance, VkSurfaceKHR& surf
         return false;
     }
 
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &features);
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memory);
+    Logger::info("Selected GPU: %s", properties.deviceName);
+
     return true;
 }
 
@@ -52,8 +73,8 @@ bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR& surfa
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = m_context->headless;
+    if (extensionsSupported && !m_context->headless) {
         m_swapChainSupport = querySwapChainSupport(device, surface);
         swapChainAdequate = !m_swapChainSupport.formats.empty() && !m_swapChainSupport.presentModes.empty();
     }
@@ -91,17 +112,33 @@ QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device, VkSu
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) m_queueFamilyIndices.graphicsFamily = i; // Check for graphics support
+    m_queueFamilyIndices = QueueFamilyIndices();
+    for (uint32_t i = 0; i < queueFamilyCount && !m_queueFamilyIndices.isComplete(); i++) {
+        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) m_queueFamilyIndices.graphicsFamily = i; // Check for graphics support
+
+        // Headless has nothing to present to, the graphics queue stands in for the present queue
+        if (m_context->headless) {
+            m_queueFamilyIndices.presentFamily = m_queueFamilyIndices.graphicsFamily;
+            continue;
+        }
 
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
 
         if (presentSupport) m_queueFamilyIndices.presentFamily = i;
+    }
 
-        if (m_queueFamilyIndices.isComplete()) break;
-        i++;
+    /*
+        Many GPUs have a family of queues that can only do transfers, which map to the DMA engines and run alongside rendering
+        Prefer a transfer only family, then an async compute family, and otherwise leave transferFamily empty so uploads use the graphics queue
+    */
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+        bool is_transfer_only = !(flags & VK_QUEUE_COMPUTE_BIT);
+        if (is_transfer_only || !m_queueFamilyIndices.transferFamily.has_value()) m_queueFamilyIndices.transferFamily = i;
+        if (is_transfer_only) break;
     }
 
     return m_queueFamilyIndices;
@@ -146,6 +183,7 @@ void VulkanDevice::createLogicalDevice(VkSurfaceKHR& surface) {
     // Describes number of queues we want for a single queue family
     std::vector<VkDeviceQueueCreateInfo> create_infos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    if (indices.transferFamily.has_value()) uniqueQueueFamilies.insert(indices.transferFamily.value());
 
     // Priorities influence scheduling of command buffer execution
     float queuePriority = 1.0f;
@@ -157,11 +195,22 @@ void VulkanDevice::createLogicalDevice(VkSurfaceKHR& surface) {
         create_infos.push_back(create_info);
     }
 
-    // Specify the set of device features to be used (none for now)
-    VkPhysicalDeviceFeatures deviceFeatures{};
+    // Specify the set of device features to be used, only optional ones for indirect drawing so far
+    m_enabled_features = {};
+    m_enabled_features.multiDrawIndirect = features.multiDrawIndirect;
+    m_enabled_features.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
 
     VkDeviceCreateInfo create_info = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
-    create_info.pEnabledFeatures = &deviceFeatures;
+    create_info.pEnabledFeatures = &m_enabled_features;
+
+    // Timeline semaphores are core in Vulkan 1.2, but the instance asks for 1.0 so they come from the extension, which also needs the feature turned on
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR };
+    m_timeline_semaphores = checkTimelineSemaphoreSupport();
+    if (m_timeline_semaphores) {
+        timeline_features.timelineSemaphore = VK_TRUE;
+        create_info.pNext = &timeline_features;
+    }
+    m_draw_indirect_count = checkDrawIndirectCountSupport();
     create_info.queueCreateInfoCount = static_cast<uint32_t>(create_infos.size());
     create_info.pQueueCreateInfos = create_infos.data();
     create_info.enabledLayerCount = 0;
@@ -175,6 +224,55 @@ void VulkanDevice::createLogicalDevice(VkSurfaceKHR& surface) {
 
     vkGetDeviceQueue(m_logicalDevice, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_logicalDevice, indices.presentFamily.value(), 0, &m_presentQueue);
+    if (indices.transferFamily.has_value()) vkGetDeviceQueue(m_logicalDevice, indices.transferFamily.value(), 0, &m_transferQueue);
+}
+
+bool VulkanDevice::checkTimelineSemaphoreSupport() {
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extension_count, extensions.data());
+
+    bool has_extension = false;
+    for (const auto& extension : extensions)
+        if (strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0) has_extension = true;
+
+    // The extension being listed doesn't mean the feature is there, that has to be queried through VK_KHR_get_physical_device_properties2
+    auto get_features = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(m_context->instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (!has_extension || !get_features) {
+        Logger::info("Timeline semaphores aren't supported, frames will be tracked with fences");
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR };
+    VkPhysicalDeviceFeatures2KHR features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR };
+    features2.pNext = &timeline_features;
+    get_features(m_physicalDevice, &features2);
+    if (!timeline_features.timelineSemaphore) {
+        Logger::info("Timeline semaphores aren't supported, frames will be tracked with fences");
+        return false;
+    }
+
+    m_deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    return true;
+}
+
+bool VulkanDevice::checkDrawIndirectCountSupport() {
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extension_count, extensions.data());
+
+    // Core in Vulkan 1.2, but like timeline semaphores it comes from the extension on our 1.0 instance
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+            m_deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            return true;
+        }
+    }
+
+    Logger::info("Draw indirect count isn't supported, culled draws will be zeroed instead of compacted");
+    return false;
 }
 
 std::vector<const char*> VulkanDevice::getRequiredDeviceExtensions() {
@@ -230,17 +328,115 @@ void VulkanDevice::createGraphicsCommandPool() {
     Logger::info("Created graphics command pool");
 }
 
-uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+void VulkanDevice::createTransferCommandPool() {
+    if (!hasDedicatedTransferQueue()) {
+        Logger::info("No dedicated transfer queue family, uploads will use the graphics queue");
+        return;
+    }
+
+    VkCommandPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    createInfo.queueFamilyIndex = m_queueFamilyIndices.transferFamily.value();
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    VkResult result = vkCreateCommandPool(m_logicalDevice, &createInfo, nullptr, &m_transferCommandPool);
+    if (result != VK_SUCCESS) Logger::fatal("Failed to create transfer command pool!");
+
+    Logger::info("Created transfer command pool on queue family %u", m_queueFamilyIndices.transferFamily.value());
+}
+
+uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memory.memoryTypeCount; i++) {
         if ((typeFilter & (1 << i)) && 
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            (memory.memoryTypes[i].propertyFlags & properties) == properties) {
             return i;
         }
     }
 
     Logger::fatal("Failed to find suitable memory type!");
     return 0;
-}
\ No newline at end of file
+}
+
+std::string VulkanDevice::getPipelineCachePath() {
+    char name[96];
+    snprintf(name, sizeof(name), "pipeline_cache_%04x_%04x_%08x.bin", properties.vendorID, properties.deviceID, properties.driverVersion);
+    return std::string(name);
+}
+
+bool VulkanDevice::isPipelineCacheDataValid(const std::vector<char>& data) {
+    /*
+        Drivers are supposed to reject incompatible data themselves, but some crash or silently misbehave instead, so check the header first
+        The header layout is defined by the spec (VkPipelineCacheHeaderVersionOne), the rest of the data is driver specific
+    */
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || header.headerSize > data.size()) return false;
+    if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) return false;
+    if (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+
+    return true;
+}
+
+void VulkanDevice::createPipelineCache() {
+    std::string path = getPipelineCachePath();
+    std::vector<char> data;
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        if (!file || !isPipelineCacheDataValid(data)) {
+            Logger::warn("Ignoring invalid or outdated pipeline cache %s", path.c_str());
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkResult result = vkCreatePipelineCache(m_logicalDevice, &create_info, nullptr, &m_pipeline_cache);
+    if (result != VK_SUCCESS && !data.empty()) {
+        // Header looked fine but the driver still didn't like it, start from an empty cache instead
+        Logger::warn("Driver rejected pipeline cache %s", path.c_str());
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        data.clear();
+        result = vkCreatePipelineCache(m_logicalDevice, &create_info, nullptr, &m_pipeline_cache);
+    }
+    if (result != VK_SUCCESS) Logger::fatal("Failed to create pipeline cache");
+
+    m_pipeline_cache_warm = !data.empty();
+    if (m_pipeline_cache_warm) Logger::info("Loaded pipeline cache %s (%zu KB)", path.c_str(), data.size() / 1024);
+    else Logger::info("Starting with a cold pipeline cache");
+}
+
+void VulkanDevice::savePipelineCache() {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_logicalDevice, m_pipeline_cache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(m_logicalDevice, m_pipeline_cache, &size, data.data()) != VK_SUCCESS) {
+        Logger::error("Failed to read back pipeline cache data");
+        return;
+    }
+
+    // Write to a temporary file first so a crash halfway through can't leave a truncated cache behind
+    std::string path = getPipelineCachePath();
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), size);
+    file.close();
+
+    if (!file || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        Logger::error("Failed to write pipeline cache %s", path.c_str());
+        std::remove(temp_path.c_str());
+        return;
+    }
+
+    Logger::info("Saved pipeline cache %s (%zu KB)", path.c_str(), size / 1024);
+}
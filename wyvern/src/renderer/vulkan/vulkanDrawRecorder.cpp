@@ -0,0 +1,122 @@
+#include "renderer/vulkan/VulkanDrawRecorder.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+#include "core/JobSystem.hpp"
+#include "core/Profiler.hpp"
+#include "core/Vertex.hpp"
+
+#include <algorithm>
+
+void VulkanDrawRecorder::create(VulkanContext& context, uint32_t frame_count) {
+    m_context = &context;
+    m_frame_count = frame_count;
+    m_thread_count = std::min(JobSystem::getThreadCount(), MAX_THREADS);
+
+    // Size the vector once, command buffers keep a pointer to their pool
+    m_thread_data.resize(m_frame_count * m_thread_count);
+    for (auto& thread_data : m_thread_data) {
+        VkCommandPoolCreateInfo create_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Buffers are re-recorded every frame, and only ever reset through the pool
+        create_info.queueFamilyIndex = m_context->device.getQueueFamilyIndices().graphicsFamily.value();
+
+        VkResult result = vkCreateCommandPool(m_context->device.getLogicalDevice(), &create_info, nullptr, &thread_data.command_pool);
+        if (result != VK_SUCCESS) Logger::fatal("Failed to create per thread command pool!");
+
+        thread_data.command_buffer.allocate(context, thread_data.command_pool, false);
+    }
+
+    Logger::info("Created draw recorder with %u threads for %u frames in flight", m_thread_count, m_frame_count);
+}
+
+void VulkanDrawRecorder::destroy() {
+    for (auto& thread_data : m_thread_data) {
+        thread_data.command_buffer.free();
+        vkDestroyCommandPool(m_context->device.getLogicalDevice(), thread_data.command_pool, nullptr);
+    }
+    m_thread_data.clear();
+}
+
+void VulkanDrawRecorder::record(uint32_t frame, VulkanCommandBuffer& primary, VkFramebuffer framebuffer, const VulkanDrawCommand* draws, size_t draw_count) {
+    if (draw_count == 0) return;
+    WYVERN_PROFILE_SCOPE("Record draws");
+
+    // Split the draws into contiguous batches so they still execute in submission order
+    size_t batch_count = std::min<size_t>(m_thread_count, (draw_count + MIN_DRAWS_PER_BATCH - 1) / MIN_DRAWS_PER_BATCH);
+    size_t batch_size = (draw_count + batch_count - 1) / batch_count;
+    ThreadData* frame_data = &m_thread_data[frame * m_thread_count];
+
+    // Every batch is a job, the caller thread records the first batch itself so small scenes never touch another thread
+    JobSystem::parallelFor(static_cast<uint32_t>(draw_count), static_cast<uint32_t>(batch_size), [&](uint32_t begin, uint32_t end) {
+        recordBatch(frame_data[begin / batch_size], framebuffer, draws + begin, end - begin);
+    });
+
+    VkCommandBuffer secondaries[MAX_THREADS];
+    for (size_t i = 0; i < batch_count; i++) secondaries[i] = frame_data[i].command_buffer.getHandle();
+    vkCmdExecuteCommands(primary.getHandle(), static_cast<uint32_t>(batch_count), secondaries);
+}
+
+void VulkanDrawRecorder::recordBatch(ThreadData& thread_data, VkFramebuffer framebuffer, const VulkanDrawCommand* draws, size_t draw_count) {
+    WYVERN_PROFILE_SCOPE("Record draw batch");
+    // The frame has already been waited on, so nothing from this pool is still executing
+    vkResetCommandPool(m_context->device.getLogicalDevice(), thread_data.command_pool, 0);
+
+    VulkanCommandBuffer& command_buffer = thread_data.command_buffer;
+    command_buffer.reset();
+    command_buffer.beginRecordingSecondary(m_context->renderpass.getHandle(), 0, framebuffer);
+
+    // Secondary command buffers don't inherit any state from the primary, so everything has to be bound again
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) m_context->framebuffer_width;
+    viewport.height = (float) m_context->framebuffer_height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor;
+    scissor.offset.x = scissor.offset.y = 0;
+    scissor.extent.width = m_context->framebuffer_width;
+    scissor.extent.height = m_context->framebuffer_height;
+
+    VulkanPipeline* bound_pipeline = m_context->object_shader.getPipeline();
+    bound_pipeline->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    vkCmdSetViewport(command_buffer.getHandle(), 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer.getHandle(), 0, 1, &scissor);
+
+    uint32_t bound_page = draw_count > 0 ? draws[0].geometry_page : 0;
+    m_context->geometry.bind(command_buffer.getHandle(), bound_page);
+    m_context->instance_ring.bind(command_buffer.getHandle()); // Batches find their instances through firstInstance, so this is bound once
+    const VertexDequantization* pushed_dequantization = nullptr;
+    bool bound_quantized = false;
+
+    for (size_t i = 0; i < draw_count; i++) {
+        const VulkanDrawCommand& draw = draws[i];
+
+        // Without a pipeline the object shader reading the draw's vertex format is used
+        VulkanPipeline* pipeline = draw.pipeline;
+        if (!pipeline) {
+            if (draw.instance) pipeline = m_context->instanced_object_shader.getPipeline();
+            else if (draw.dequantization) pipeline = m_context->quantized_object_shader.getPipeline();
+            else pipeline = m_context->object_shader.getPipeline();
+        }
+        if (pipeline != bound_pipeline) {
+            pipeline->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS); // Viewport and scissor are dynamic so they survive the rebind
+            bound_pipeline = pipeline;
+            bound_quantized = pipeline->hasPushConstants(VK_SHADER_STAGE_VERTEX_BIT, sizeof(VertexDequantization));
+            pushed_dequantization = nullptr;
+        }
+        if (draw.geometry_page != bound_page) {
+            m_context->geometry.bind(command_buffer.getHandle(), draw.geometry_page);
+            bound_page = draw.geometry_page;
+        }
+        // Meshes sharing a VertexDequantization (e.g. instances of the same mesh) only push it once, and only pipelines reading VertexQuantized take it
+        if (bound_quantized && draw.dequantization && draw.dequantization != pushed_dequantization) {
+            vkCmdPushConstants(command_buffer.getHandle(), bound_pipeline->getLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization), draw.dequantization);
+            pushed_dequantization = draw.dequantization;
+        }
+
+        vkCmdDrawIndexed(command_buffer.getHandle(), draw.index_count, draw.instance_count, draw.first_index, draw.vertex_offset, draw.first_instance);
+    }
+
+    command_buffer.endRecording();
+}
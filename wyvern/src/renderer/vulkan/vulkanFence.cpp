@@ -50,6 +50,11 @@ bool VulkanFence::wait(uint64_t nanosec) {
     return false;
 }
 
+bool VulkanFence::poll() {
+    if (!is_signaled && vkGetFenceStatus(m_context->device.getLogicalDevice(), m_fence) == VK_SUCCESS) is_signaled = true;
+    return is_signaled;
+}
+
 void VulkanFence::reset() {
     if (is_signaled) {
         VkResult result = vkResetFences(m_context->device.getLogicalDevice(), 1, &m_fence);
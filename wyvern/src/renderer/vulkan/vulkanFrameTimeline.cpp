@@ -0,0 +1,143 @@
+#include "renderer/vulkan/VulkanFrameTimeline.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+
+void VulkanFrameTimeline::create(VulkanContext& context) {
+    m_context = &context;
+    VkDevice device = context.device.getLogicalDevice();
+
+    if (context.device.hasTimelineSemaphores()) {
+        m_wait_semaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+        m_get_counter_value = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    }
+
+    if (m_wait_semaphores && m_get_counter_value) {
+        VkSemaphoreTypeCreateInfoKHR type_info = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR };
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        type_info.initialValue = m_completed_value.load();
+
+        VkSemaphoreCreateInfo create_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        create_info.pNext = &type_info;
+        if (vkCreateSemaphore(device, &create_info, nullptr, &m_timeline) != VK_SUCCESS) Logger::fatal("Failed to create frame timeline semaphore");
+
+        Logger::info("Frames are tracked with a timeline semaphore");
+        return;
+    }
+
+    for (auto& fence : m_fences) fence.create(context, false);
+    Logger::info("Frames are tracked with %u fences", FENCE_COUNT);
+}
+
+void VulkanFrameTimeline::destroy() {
+    if (m_timeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_context->device.getLogicalDevice(), m_timeline, nullptr);
+        m_timeline = VK_NULL_HANDLE;
+        return;
+    }
+
+    for (auto& fence : m_fences) fence.destroy();
+}
+
+uint64_t VulkanFrameTimeline::submit(VkQueue queue, const VkSubmitInfo& submit_info) {
+    uint64_t value = m_next_value;
+    VkSubmitInfo info = submit_info;
+    m_submit_thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    VkFence fence = VK_NULL_HANDLE;
+
+    // Fixed size arrays so submitting never touches the heap
+    VkSemaphore signal_semaphores[MAX_SIGNAL_SEMAPHORES];
+    uint64_t signal_values[MAX_SIGNAL_SEMAPHORES] = {}; // Binary semaphores ignore their value
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR };
+
+    if (m_timeline != VK_NULL_HANDLE) {
+        uint32_t signal_count = submit_info.signalSemaphoreCount;
+        if (signal_count >= MAX_SIGNAL_SEMAPHORES) Logger::fatal("Frame submit signals too many semaphores");
+        std::copy(submit_info.pSignalSemaphores, submit_info.pSignalSemaphores + signal_count, signal_semaphores);
+        signal_semaphores[signal_count] = m_timeline;
+        signal_values[signal_count] = value;
+
+        // Every wait is on a binary semaphore, so there are no wait values
+        timeline_info.pNext = submit_info.pNext;
+        timeline_info.signalSemaphoreValueCount = signal_count + 1;
+        timeline_info.pSignalSemaphoreValues = signal_values;
+
+        info.pNext = &timeline_info;
+        info.signalSemaphoreCount = signal_count + 1;
+        info.pSignalSemaphores = signal_semaphores;
+    } else {
+        // The fence's last frame has to be finished before the fence can be reset and used again
+        uint32_t slot = value % FENCE_COUNT;
+        if (m_fence_values[slot] != 0) {
+            m_fences[slot].wait(UINT64_MAX);
+            advanceCompletedValue(m_fence_values[slot]);
+        }
+        m_fences[slot].reset();
+        m_fence_values[slot] = value;
+        fence = m_fences[slot].getHandle();
+    }
+
+    VkResult result = vkQueueSubmit(queue, 1, &info, fence);
+    if (result != VK_SUCCESS) {
+        Logger::error("vkQueueSubmit failed with result: %d", result);
+        return 0;
+    }
+
+    m_next_value++;
+    return value;
+}
+
+void VulkanFrameTimeline::advanceCompletedValue(uint64_t value) {
+    // Several threads can poll at once, so only ever move the value forward
+    uint64_t completed = m_completed_value.load(std::memory_order_relaxed);
+    while (value > completed && !m_completed_value.compare_exchange_weak(completed, value, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+uint64_t VulkanFrameTimeline::pollCompletedValue() {
+    if (m_timeline != VK_NULL_HANDLE) {
+        // Reading a semaphore's counter needs no synchronisation
+        uint64_t value = 0;
+        if (m_get_counter_value(m_context->device.getLogicalDevice(), m_timeline, &value) == VK_SUCCESS) advanceCompletedValue(value);
+        return m_completed_value.load(std::memory_order_acquire);
+    }
+
+    if (std::this_thread::get_id() != m_submit_thread.load(std::memory_order_relaxed)) return m_completed_value.load(std::memory_order_acquire);
+
+    // Newest signalled fence wins, every frame before it has finished too
+    for (uint32_t i = 0; i < FENCE_COUNT; i++) {
+        if (m_fence_values[i] > m_completed_value.load(std::memory_order_relaxed) && m_fences[i].poll()) advanceCompletedValue(m_fence_values[i]);
+    }
+    return m_completed_value.load(std::memory_order_acquire);
+}
+
+bool VulkanFrameTimeline::wait(uint64_t value, uint64_t timeout) {
+    if (value <= m_completed_value.load(std::memory_order_acquire)) return true;
+    if (value >= m_next_value) {
+        Logger::error("Waiting on frame %llu which hasn't been submitted yet", (unsigned long long)value);
+        return false;
+    }
+
+    if (m_timeline != VK_NULL_HANDLE) {
+        VkSemaphoreWaitInfoKHR wait_info = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR };
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &m_timeline;
+        wait_info.pValues = &value;
+
+        VkResult result = m_wait_semaphores(m_context->device.getLogicalDevice(), &wait_info, timeout);
+        if (result == VK_TIMEOUT) {
+            Logger::warn("Timed out waiting for frame %llu", (unsigned long long)value);
+            return false;
+        } else if (result != VK_SUCCESS) {
+            Logger::error("vkWaitSemaphores failed with result: %d", result);
+            return false;
+        }
+    } else {
+        // If the frame's fence has been reused since, it was waited on before that so the frame is done
+        uint32_t slot = value % FENCE_COUNT;
+        if (m_fence_values[slot] == value && !m_fences[slot].wait(timeout)) return false;
+    }
+
+    advanceCompletedValue(value);
+    return true;
+}
@@ -3,14 +3,14 @@
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/Logger.hpp"
 
-void VulkanFramebuffer::create(VulkanContext& context, uint32_t width, uint32_t height, const std::vector<VkImageView>& imageViews) {
+void VulkanFramebuffer::create(VulkanContext& context, uint32_t width, uint32_t height, const VkImageView* imageViews, uint32_t imageViewCount) {
     m_context = &context;
 
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = m_context->renderpass.getHandle();
-    framebufferInfo.attachmentCount = static_cast<uint32_t>(imageViews.size());
-    framebufferInfo.pAttachments = imageViews.data();
+    framebufferInfo.attachmentCount = imageViewCount;
+    framebufferInfo.pAttachments = imageViews;
     framebufferInfo.width = width;
     framebufferInfo.height = height;
     framebufferInfo.layers = 1;
@@ -22,5 +22,6 @@ void VulkanFramebuffer::create(VulkanContext& context, uint32_t width, uint32_t
 }
 
 void VulkanFramebuffer::destroy() {
-    vkDestroyFramebuffer(m_context->device.getLogicalDevice(), m_framebuffer, nullptr);
+    m_context->deletion_queue.pushFramebuffer(m_framebuffer);
+    m_framebuffer = VK_NULL_HANDLE;
 }
\ No newline at end of file
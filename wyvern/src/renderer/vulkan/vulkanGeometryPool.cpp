@@ -0,0 +1,376 @@
+#include "renderer/vulkan/VulkanGeometryPool.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+
+/*
+    RangeAllocator
+*/
+
+void VulkanGeometryPool::RangeAllocator::create(uint32_t size) {
+    m_size = size;
+    m_free_total = size;
+    m_free.clear();
+    m_free.push_back({ 0, size });
+}
+
+bool VulkanGeometryPool::RangeAllocator::allocate(uint32_t size, uint32_t alignment, uint32_t& out_offset) {
+    // First fit, the list is in offset order so this is also the lowest address that fits
+    for (size_t i = 0; i < m_free.size(); i++) {
+        Range& range = m_free[i];
+        uint32_t aligned = (range.offset + alignment - 1) / alignment * alignment;
+        if (aligned + size > range.offset + range.size) continue;
+
+        // Whatever is skipped for alignment stays free in front of the allocation
+        Range before = { range.offset, aligned - range.offset };
+        Range after = { aligned + size, range.offset + range.size - (aligned + size) };
+        if (before.size > 0 && after.size > 0) {
+            range = before;
+            m_free.insert(m_free.begin() + i + 1, after);
+        } else if (before.size > 0) {
+            range = before;
+        } else if (after.size > 0) {
+            range = after;
+        } else {
+            m_free.erase(m_free.begin() + i);
+        }
+
+        out_offset = aligned;
+        m_free_total -= size;
+        return true;
+    }
+    return false;
+}
+
+void VulkanGeometryPool::RangeAllocator::free(uint32_t offset, uint32_t size) {
+    auto next = std::lower_bound(m_free.begin(), m_free.end(), offset, [](const Range& range, uint32_t value) { return range.offset < value; });
+    m_free_total += size;
+
+    // Merge with the free range just before and/or just after
+    bool merges_prev = next != m_free.begin() && (next - 1)->offset + (next - 1)->size == offset;
+    bool merges_next = next != m_free.end() && offset + size == next->offset;
+
+    if (merges_prev && merges_next) {
+        (next - 1)->size += size + next->size;
+        m_free.erase(next);
+    } else if (merges_prev) {
+        (next - 1)->size += size;
+    } else if (merges_next) {
+        next->offset = offset;
+        next->size += size;
+    } else {
+        m_free.insert(next, { offset, size });
+    }
+}
+
+/*
+    VulkanGeometryPool
+*/
+
+void VulkanGeometryPool::create(VulkanContext& context, uint32_t page_vertex_bytes, uint32_t page_index_count) {
+    m_context = &context;
+    m_page_vertex_bytes = page_vertex_bytes;
+    m_page_index_count = page_index_count;
+
+    uint32_t page;
+    createPage(page); // The first page always exists
+}
+
+void VulkanGeometryPool::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Buffers go through the deletion queue, so frames still in flight can finish drawing from them
+    for (auto& page : m_pages) {
+        if (!page.in_use) continue;
+        page.vertex_buffer.destroy();
+        page.index_buffer.destroy();
+        page.in_use = false;
+    }
+
+    m_meshes.clear();
+    m_free_ids.clear();
+    m_pending_frees.clear();
+    m_pending_moves.clear();
+}
+
+bool VulkanGeometryPool::createPage(uint32_t& out_page) {
+    for (uint32_t i = 0; i < MAX_PAGES; i++) {
+        Page& page = m_pages[i];
+        if (page.in_use) continue;
+
+        VkMemoryPropertyFlagBits memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; // This is a GPU only buffer and is the most optimal memory type for graphics cards to read from
+        VkBufferUsageFlags vertex_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        VkBufferUsageFlags index_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        page.vertex_buffer.create(*m_context, m_page_vertex_bytes, vertex_flags, memory_property_flags);
+        page.index_buffer.create(*m_context, sizeof(uint32_t) * static_cast<VkDeviceSize>(m_page_index_count), index_flags, memory_property_flags);
+        page.vertices.create(m_page_vertex_bytes);
+        page.indices.create(m_page_index_count);
+        page.range_count = 0;
+        page.in_use = true;
+
+        if (i > 0) Logger::info("Added geometry page %u (%u KB of vertices, %u indices)", i, m_page_vertex_bytes / 1024, m_page_index_count);
+        out_page = i;
+        return true;
+    }
+    return false;
+}
+
+bool VulkanGeometryPool::allocateInPage(uint32_t page, uint32_t vertex_count, uint32_t vertex_stride, uint32_t index_count, uint32_t& out_vertex_byte_offset, uint32_t& out_first_index) {
+    Page& p = m_pages[page];
+    if (!p.vertices.allocate(vertex_count * vertex_stride, vertex_stride, out_vertex_byte_offset)) return false;
+    if (!p.indices.allocate(index_count, 1, out_first_index)) {
+        p.vertices.free(out_vertex_byte_offset, vertex_count * vertex_stride);
+        return false;
+    }
+    return true;
+}
+
+VulkanMesh VulkanGeometryPool::allocate(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count) {
+    VulkanMesh mesh;
+    uint64_t vertex_bytes = static_cast<uint64_t>(vertex_count) * vertex_stride;
+    if (vertex_bytes == 0 || index_count == 0 || vertex_bytes > m_page_vertex_bytes || index_count > m_page_index_count) {
+        Logger::error("Can't upload a mesh with %u vertices and %u indices, a geometry page holds %u KB of vertices and %u indices", vertex_count, index_count, m_page_vertex_bytes / 1024, m_page_index_count);
+        return mesh;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t page = MAX_PAGES, vertex_byte_offset = 0, first_index = 0;
+    for (uint32_t i = 0; i < MAX_PAGES; i++) {
+        if (m_pages[i].in_use && allocateInPage(i, vertex_count, vertex_stride, index_count, vertex_byte_offset, first_index)) {
+            page = i;
+            break;
+        }
+    }
+    if (page == MAX_PAGES && (!createPage(page) || !allocateInPage(page, vertex_count, vertex_stride, index_count, vertex_byte_offset, first_index))) {
+        Logger::error("Geometry pool is full, can't upload a mesh with %u vertices and %u indices", vertex_count, index_count);
+        return mesh;
+    }
+    m_pages[page].range_count += 2;
+
+    if (m_free_ids.empty()) {
+        mesh.id = static_cast<uint32_t>(m_meshes.size());
+        m_meshes.emplace_back();
+    } else {
+        mesh.id = m_free_ids.back();
+        m_free_ids.pop_back();
+    }
+
+    // Indices stay relative to the mesh, vertex_offset moves them to where its vertices ended up
+    mesh.page = page;
+    mesh.first_index = first_index;
+    mesh.vertex_offset = static_cast<int32_t>(vertex_byte_offset / vertex_stride);
+    mesh.index_count = index_count;
+    mesh.vertex_count = vertex_count;
+    mesh.vertex_stride = vertex_stride;
+
+    MeshEntry& entry = m_meshes[mesh.id];
+    entry.mesh = mesh;
+    entry.live = true;
+    m_context->staging_ring.upload(vertices, vertex_bytes, m_pages[page].vertex_buffer, vertex_byte_offset);
+    entry.upload = m_context->staging_ring.upload(indices, index_count * sizeof(uint32_t), m_pages[page].index_buffer, first_index * sizeof(uint32_t));
+
+    return mesh;
+}
+
+void VulkanGeometryPool::free(const VulkanMesh& mesh) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!mesh.isValid() || mesh.id >= m_meshes.size() || !m_meshes[mesh.id].live) {
+        Logger::warn("Freeing a mesh that isn't in the geometry pool");
+        return;
+    }
+
+    // The handle passed in may be from before a move, the entry knows where the mesh is now
+    MeshEntry& entry = m_meshes[mesh.id];
+    retireRange(entry.mesh.page, VERTICES, entry.mesh.vertex_offset * entry.mesh.vertex_stride, entry.mesh.vertex_count * entry.mesh.vertex_stride);
+    retireRange(entry.mesh.page, INDICES, entry.mesh.first_index, entry.mesh.index_count);
+    entry.live = false;
+    m_free_ids.push_back(mesh.id);
+}
+
+VulkanMesh VulkanGeometryPool::getMesh(uint32_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_meshes.size() || !m_meshes[id].live) return VulkanMesh();
+    return m_meshes[id].mesh;
+}
+
+UploadToken VulkanGeometryPool::updateVertices(const VulkanMesh& mesh, const void* vertices, uint32_t vertex_count) {
+    if (vertex_count > mesh.vertex_count) {
+        Logger::error("Can't write %u vertices into a mesh with %u", vertex_count, mesh.vertex_count);
+        return 0;
+    }
+    // Frames in flight may be drawing the mesh, so the copy waits for them
+    return m_context->staging_ring.upload(vertices, static_cast<VkDeviceSize>(vertex_count) * mesh.vertex_stride, m_pages[mesh.page].vertex_buffer, static_cast<VkDeviceSize>(mesh.vertex_offset) * mesh.vertex_stride, true);
+}
+
+uint64_t VulkanGeometryPool::getRetireValue() {
+    /*
+        The frame being recorded may draw the range, and with pipelined rendering one more packet may already be waiting for the render thread
+        Anything after that was built by the caller after the free or move, so it doesn't use the old range
+    */
+    return m_context->frame_timeline.getNextValue() + 1;
+}
+
+void VulkanGeometryPool::retireRange(uint32_t page, RangeKind kind, uint32_t offset, uint32_t size) {
+    PendingFree pending;
+    pending.frame_value = getRetireValue();
+    pending.page = page;
+    pending.kind = kind;
+    pending.offset = offset;
+    pending.size = size;
+    m_pending_frees.push_back(pending);
+}
+
+bool VulkanGeometryPool::moveRange(MeshEntry& entry, uint32_t src_page, uint32_t dst_page, RangeKind kind, uint32_t dst_offset) {
+    // Vertex ranges are already in bytes
+    VulkanMesh& mesh = entry.mesh;
+    uint32_t src_offset = kind == VERTICES ? mesh.vertex_offset * mesh.vertex_stride : mesh.first_index;
+    uint32_t count = kind == VERTICES ? mesh.vertex_count * mesh.vertex_stride : mesh.index_count;
+    VkDeviceSize stride = kind == VERTICES ? 1 : sizeof(uint32_t);
+
+    PendingMove move;
+    move.src_buffer = kind == VERTICES ? m_pages[src_page].vertex_buffer.getHandle() : m_pages[src_page].index_buffer.getHandle();
+    move.dst_buffer = kind == VERTICES ? m_pages[dst_page].vertex_buffer.getHandle() : m_pages[dst_page].index_buffer.getHandle();
+    move.region.srcOffset = src_offset * stride;
+    move.region.dstOffset = dst_offset * stride;
+    move.region.size = count * stride;
+    m_pending_moves.push_back(move);
+
+    // Frames in flight keep drawing from the old range until they retire
+    retireRange(src_page, kind, src_offset, count);
+    m_pages[dst_page].range_count++;
+
+    if (kind == VERTICES) mesh.vertex_offset = static_cast<int32_t>(dst_offset / mesh.vertex_stride);
+    else mesh.first_index = dst_offset;
+    return true;
+}
+
+uint32_t VulkanGeometryPool::compact(VkDeviceSize max_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Meshes furthest from the start go first, moving those is what empties out the ends of pages
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < m_meshes.size(); i++) {
+        if (m_meshes[i].live) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const VulkanMesh& mesh_a = m_meshes[a].mesh;
+        const VulkanMesh& mesh_b = m_meshes[b].mesh;
+        if (mesh_a.page != mesh_b.page) return mesh_a.page > mesh_b.page;
+        return mesh_a.vertex_offset * mesh_a.vertex_stride > mesh_b.vertex_offset * mesh_b.vertex_stride;
+    });
+
+    VkDeviceSize moved_bytes = 0;
+    uint32_t moved_meshes = 0;
+    for (uint32_t id : order) {
+        if (moved_bytes >= max_bytes) break;
+
+        MeshEntry& entry = m_meshes[id];
+        if (!m_context->staging_ring.isComplete(entry.upload)) continue; // The copy would read the range before the upload has written it
+        VulkanMesh& mesh = entry.mesh;
+        bool moved = false;
+
+        // A lower page with room for the whole mesh
+        for (uint32_t page = 0; page < mesh.page && !moved; page++) {
+            uint32_t vertex_byte_offset, first_index;
+            if (!m_pages[page].in_use || !allocateInPage(page, mesh.vertex_count, mesh.vertex_stride, mesh.index_count, vertex_byte_offset, first_index)) continue;
+
+            uint32_t src_page = mesh.page;
+            moveRange(entry, src_page, page, VERTICES, vertex_byte_offset);
+            moveRange(entry, src_page, page, INDICES, first_index);
+            mesh.page = page;
+            moved = true;
+        }
+
+        // Otherwise further down its own page, the vertices and indices can move separately
+        if (!moved) {
+            Page& page = m_pages[mesh.page];
+            uint32_t offset;
+            uint32_t vertex_bytes = mesh.vertex_count * mesh.vertex_stride;
+            if (page.vertices.allocate(vertex_bytes, mesh.vertex_stride, offset)) {
+                if (offset < mesh.vertex_offset * mesh.vertex_stride) moved = moveRange(entry, mesh.page, mesh.page, VERTICES, offset);
+                else page.vertices.free(offset, vertex_bytes);
+            }
+            if (page.indices.allocate(mesh.index_count, 1, offset)) {
+                if (offset < mesh.first_index) moved = moveRange(entry, mesh.page, mesh.page, INDICES, offset);
+                else page.indices.free(offset, mesh.index_count);
+            }
+        }
+
+        if (moved) {
+            moved_meshes++;
+            moved_bytes += mesh.vertex_count * mesh.vertex_stride + mesh.index_count * sizeof(uint32_t);
+        }
+    }
+
+    if (moved_meshes > 0) {
+        m_generation.fetch_add(1, std::memory_order_release);
+        Logger::info("Geometry compaction moved %u meshes (%llu KB)", moved_meshes, (unsigned long long)(moved_bytes / 1024));
+    }
+    return moved_meshes;
+}
+
+void VulkanGeometryPool::collect() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t released = 0;
+    while (released < m_pending_frees.size() && m_context->frame_timeline.isRetired(m_pending_frees[released].frame_value)) {
+        const PendingFree& pending = m_pending_frees[released];
+        Page& page = m_pages[pending.page];
+        if (pending.kind == VERTICES) page.vertices.free(pending.offset, pending.size);
+        else page.indices.free(pending.offset, pending.size);
+        page.range_count--;
+        released++;
+    }
+    if (released > 0) m_pending_frees.erase(m_pending_frees.begin(), m_pending_frees.begin() + released);
+
+    // Pages past the first are given back once nothing is in them and no frame can be drawing from them
+    for (uint32_t i = 1; i < MAX_PAGES; i++) {
+        Page& page = m_pages[i];
+        if (!page.in_use || page.range_count > 0) continue;
+
+        page.vertex_buffer.destroy();
+        page.index_buffer.destroy();
+        page.in_use = false;
+        Logger::info("Released empty geometry page %u", i);
+    }
+}
+
+void VulkanGeometryPool::recordMoves(VulkanCommandBuffer& command_buffer) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending_moves.empty()) return;
+
+    for (const auto& move : m_pending_moves) vkCmdCopyBuffer(command_buffer.getHandle(), move.src_buffer, move.dst_buffer, 1, &move.region);
+    m_pending_moves.clear();
+
+    // Draws read the new ranges as vertices and indices, and later moves may copy out of them
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanGeometryPool::bind(VkCommandBuffer command_buffer, uint32_t page) {
+    VkDeviceSize offsets[1] = {0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_pages[page].vertex_buffer.getHandle(), offsets);
+    vkCmdBindIndexBuffer(command_buffer, m_pages[page].index_buffer.getHandle(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+VulkanGeometryStats VulkanGeometryPool::getStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VulkanGeometryStats stats;
+    for (const auto& page : m_pages) {
+        if (!page.in_use) continue;
+        stats.page_count++;
+        stats.vertex_bytes_capacity += m_page_vertex_bytes;
+        stats.vertex_bytes_used += page.vertices.getUsed();
+        stats.index_capacity += m_page_index_count;
+        stats.indices_used += page.indices.getUsed();
+        stats.free_ranges += page.vertices.getFreeRangeCount() + page.indices.getFreeRangeCount();
+    }
+    for (const auto& entry : m_meshes) stats.mesh_count += entry.live ? 1 : 0;
+    return stats;
+}
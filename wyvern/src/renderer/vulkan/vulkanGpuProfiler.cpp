@@ -0,0 +1,150 @@
+#include "renderer/vulkan/VulkanGpuProfiler.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+
+#include <algorithm>
+
+void VulkanGpuProfiler::create(VulkanContext& context, uint32_t frame_count) {
+    m_context = &context;
+
+    // Timestamps need a non zero period and valid bits on the queue family the frame is submitted to
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(context.device.getPhysicalDevice(), &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(context.device.getPhysicalDevice(), &family_count, families.data());
+
+    uint32_t graphics_family = context.device.getQueueFamilyIndices().graphicsFamily.value();
+    uint32_t valid_bits = families[graphics_family].timestampValidBits;
+    float period = context.device.getProperties().limits.timestampPeriod;
+
+    m_supported = valid_bits > 0 && period > 0.0f;
+    if (!m_supported) {
+        Logger::warn("GPU timestamps aren't supported on the graphics queue, GPU profiling is disabled");
+        return;
+    }
+
+    m_ns_per_tick = period;
+    m_timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    m_frames.resize(frame_count);
+    for (auto& frame : m_frames) {
+        VkQueryPoolCreateInfo create_info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = MAX_SCOPES * 2;
+        if (vkCreateQueryPool(context.device.getLogicalDevice(), &create_info, nullptr, &frame.pool) != VK_SUCCESS) Logger::fatal("Failed to create timestamp query pool");
+        frame.scopes.reserve(MAX_SCOPES);
+    }
+
+    // Everything is sized up front so recording and collecting never allocate
+    m_results.resize(MAX_SCOPES * 2);
+    m_last_scopes.reserve(MAX_SCOPES);
+}
+
+void VulkanGpuProfiler::destroy() {
+    for (auto& frame : m_frames) vkDestroyQueryPool(m_context->device.getLogicalDevice(), frame.pool, nullptr);
+    m_frames.clear();
+    m_recording = nullptr;
+}
+
+void VulkanGpuProfiler::collect(uint32_t frame) {
+    if (!m_supported) return;
+
+    FrameQueries& queries = m_frames[frame];
+    if (!queries.submitted || queries.scopes.empty()) return;
+    queries.submitted = false;
+
+    uint32_t query_count = static_cast<uint32_t>(queries.scopes.size()) * 2;
+    VkResult result = vkGetQueryPoolResults(m_context->device.getLogicalDevice(), queries.pool, 0, query_count, query_count * sizeof(uint64_t), m_results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return; // Frame has retired so this shouldn't happen, but skip the frame rather than wait
+
+    uint64_t frame_begin = m_results[0] & m_timestamp_mask;
+    int64_t frame_begin_ns = static_cast<int64_t>(frame_begin * m_ns_per_tick);
+
+    // The GPU starts after the submit, so the smallest shift that keeps every frame after its submit is the best estimate of the clock offset
+    m_gpu_to_cpu_offset = std::max(m_gpu_to_cpu_offset, static_cast<int64_t>(queries.cpu_submit_time) - frame_begin_ns);
+
+    m_last_scopes.clear();
+    for (uint32_t i = 0; i < queries.scopes.size(); i++) {
+        // Timestamps only have timestampValidBits bits, so differences are taken modulo that in case the counter wrapped during the frame
+        uint64_t begin_ticks = (m_results[i * 2] - frame_begin) & m_timestamp_mask;
+        uint64_t duration_ticks = (m_results[i * 2 + 1] - m_results[i * 2]) & m_timestamp_mask;
+
+        GpuScopeTiming timing;
+        timing.name = queries.scopes[i].name;
+        timing.start_ms = begin_ticks * m_ns_per_tick / 1000000.0;
+        timing.duration_ms = duration_ticks * m_ns_per_tick / 1000000.0;
+        timing.depth = queries.scopes[i].depth;
+        m_last_scopes.push_back(timing);
+
+        int64_t begin_ns = frame_begin_ns + static_cast<int64_t>(begin_ticks * m_ns_per_tick) + m_gpu_to_cpu_offset;
+        int64_t end_ns = begin_ns + static_cast<int64_t>(duration_ticks * m_ns_per_tick);
+        Profiler::recordGpuEvent(timing.name, std::max<int64_t>(begin_ns, 0), std::max<int64_t>(end_ns, 0), timing.depth);
+    }
+
+    m_history[m_history_next] = static_cast<float>(m_last_scopes[0].duration_ms);
+    m_history_next = (m_history_next + 1) % HISTORY_SIZE;
+    m_history_count = std::min(m_history_count + 1, HISTORY_SIZE);
+    m_collected_frames++;
+}
+
+void VulkanGpuProfiler::beginFrame(VulkanCommandBuffer& command_buffer, uint32_t frame) {
+    if (!m_supported) return;
+
+    m_recording = &m_frames[frame];
+    m_recording->scopes.clear();
+    m_recording->submitted = false;
+    m_depth = 0;
+
+    vkCmdResetQueryPool(command_buffer.getHandle(), m_recording->pool, 0, MAX_SCOPES * 2);
+    beginScope(command_buffer, "GPU frame"); // Always scope 0, endFrame closes it last
+}
+
+void VulkanGpuProfiler::endFrame(VulkanCommandBuffer& command_buffer) {
+    if (!m_recording) return;
+
+    // Any scope left open ends with the frame, innermost first. Otherwise its end query is never written and reading the frame back fails
+    for (uint32_t scope = static_cast<uint32_t>(m_recording->scopes.size()); scope-- > 0;) {
+        if (!m_recording->scopes[scope].closed) endScope(command_buffer, scope);
+    }
+}
+
+void VulkanGpuProfiler::onSubmit() {
+    if (!m_recording) return;
+    m_recording->cpu_submit_time = Profiler::getTime();
+    m_recording->submitted = true;
+    m_recording = nullptr;
+}
+
+uint32_t VulkanGpuProfiler::beginScope(VulkanCommandBuffer& command_buffer, const char* name) {
+    if (!m_recording || m_recording->scopes.size() >= MAX_SCOPES) return UINT32_MAX;
+
+    uint32_t scope = static_cast<uint32_t>(m_recording->scopes.size());
+    m_recording->scopes.push_back({name, m_depth++, false});
+    vkCmdWriteTimestamp(command_buffer.getHandle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_recording->pool, scope * 2);
+    return scope;
+}
+
+void VulkanGpuProfiler::endScope(VulkanCommandBuffer& command_buffer, uint32_t scope) {
+    if (!m_recording || scope == UINT32_MAX || m_recording->scopes[scope].closed) return;
+
+    // Bottom of pipe is written once all previous commands have finished
+    vkCmdWriteTimestamp(command_buffer.getHandle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_recording->pool, scope * 2 + 1);
+    m_recording->scopes[scope].closed = true;
+    m_depth--;
+}
+
+uint32_t VulkanGpuProfiler::getHistory(float* out_ms, uint32_t max_count) const {
+    uint32_t count = std::min(max_count, m_history_count);
+    uint32_t first = (m_history_next + HISTORY_SIZE - count) % HISTORY_SIZE;
+    for (uint32_t i = 0; i < count; i++) out_ms[i] = m_history[(first + i) % HISTORY_SIZE];
+    return count;
+}
+
+float VulkanGpuProfiler::getAverageFrameTime() const {
+    if (m_history_count == 0) return 0.0f;
+
+    float total = 0.0f;
+    for (uint32_t i = 0; i < m_history_count; i++) total += m_history[i];
+    return total / m_history_count;
+}
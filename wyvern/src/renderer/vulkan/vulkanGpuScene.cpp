@@ -0,0 +1,445 @@
+#include "renderer/vulkan/VulkanGpuScene.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "renderer/vulkan/VulkanVertexLayout.hpp"
+#include "renderer/vulkan/shaders/VulkanShaderUtils.hpp"
+#include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+#include "core/FrustumCuller.hpp"
+
+#include <algorithm>
+
+// Instances, buckets, commands and counts, in the order of the bindings in cull.comp
+static const uint32_t BINDING_COUNT = 4;
+
+void VulkanGpuScene::create(VulkanContext& context, uint32_t frame_count, const std::string& shader_dir) {
+    m_context = &context;
+    setViewProjection(glm::mat4(1.0f));
+
+    const VkPhysicalDeviceFeatures& features = context.device.getEnabledFeatures();
+    m_supported = features.drawIndirectFirstInstance == VK_TRUE;
+    if (!m_supported) Logger::warn("drawIndirectFirstInstance isn't supported, GPU driven instances won't be drawn");
+
+    // Without multiDrawIndirect every indirect draw is a single command
+    m_max_draw_count = features.multiDrawIndirect ? context.device.getProperties().limits.maxDrawIndirectCount : 1;
+    if (context.device.hasDrawIndirectCount() && features.multiDrawIndirect) {
+        m_draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(context.device.getLogicalDevice(), "vkCmdDrawIndexedIndirectCountKHR");
+    }
+    m_use_count = m_draw_indexed_indirect_count != nullptr;
+
+    // One set for both the cull shader and the vertex shader, which only reads the instances
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT] = {};
+    for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layout_info.bindingCount = BINDING_COUNT;
+    layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(context.device.getLogicalDevice(), &layout_info, nullptr, &m_descriptor_set_layout) != VK_SUCCESS) {
+        Logger::fatal("Failed to create GPU scene descriptor set layout");
+    }
+
+    createCullPipeline(shader_dir + "cull.comp.spv");
+
+    VulkanPipelineDescription vertex_input;
+    setVertexLayout<Vertex3D>(vertex_input);
+    vertex_input.descriptor_set_layouts.push_back(m_descriptor_set_layout);
+    m_shader.create(context, shader_dir + "object_indirect.vert.spv", shader_dir + "object.frag.spv", vertex_input);
+
+    createFrames(frame_count);
+    Logger::info("GPU scene culls into %s", m_use_count ? "draw indirect count" : "zeroed indirect draws");
+}
+
+void VulkanGpuScene::destroy() {
+    VkDevice device = m_context->device.getLogicalDevice();
+    destroyFrames();
+
+    vkDestroyPipeline(device, m_cull_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_cull_layout, nullptr);
+    vkDestroyShaderModule(device, m_cull_stage.shader_module, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptor_set_layout, nullptr);
+    m_cull_pipeline = VK_NULL_HANDLE;
+    m_cull_layout = VK_NULL_HANDLE;
+    m_descriptor_set_layout = VK_NULL_HANDLE;
+    m_shader.destroy();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_instances.clear();
+    m_free_ids.clear();
+    m_materials.clear();
+}
+
+void VulkanGpuScene::createCullPipeline(const std::string& path) {
+    VkDevice device = m_context->device.getLogicalDevice();
+
+    m_cull_stage.type = "comp";
+    m_cull_stage.flag = VK_SHADER_STAGE_COMPUTE_BIT;
+    VulkanShaderUtils::loadShaderStage(*m_context, path, m_cull_stage);
+
+    VkPushConstantRange push_constants = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants) };
+    VkPipelineLayoutCreateInfo layout_info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &m_descriptor_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constants;
+    if (vkCreatePipelineLayout(device, &layout_info, nullptr, &m_cull_layout) != VK_SUCCESS) Logger::fatal("Failed to create cull pipeline layout");
+
+    VkComputePipelineCreateInfo create_info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    create_info.stage = m_cull_stage.shader_stage_create_info;
+    create_info.layout = m_cull_layout;
+    if (vkCreateComputePipelines(device, m_context->device.getPipelineCache(), 1, &create_info, nullptr, &m_cull_pipeline) != VK_SUCCESS) {
+        Logger::fatal("Failed to create cull pipeline");
+    }
+}
+
+void VulkanGpuScene::recreateFrames(uint32_t frame_count) {
+    destroyFrames();
+    createFrames(frame_count);
+}
+
+void VulkanGpuScene::createFrames(uint32_t frame_count) {
+    VkDevice device = m_context->device.getLogicalDevice();
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, BINDING_COUNT * frame_count };
+    VkDescriptorPoolCreateInfo pool_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    pool_info.maxSets = frame_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if (vkCreateDescriptorPool(device, &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) Logger::fatal("Failed to create GPU scene descriptor pool");
+
+    // Sized once, the command buffers keep a pointer to their frame's pool
+    m_frames.resize(frame_count);
+    for (auto& frame : m_frames) {
+        VkDescriptorSetAllocateInfo allocate_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocate_info.descriptorPool = m_descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &m_descriptor_set_layout;
+        if (vkAllocateDescriptorSets(device, &allocate_info, &frame.descriptor_set) != VK_SUCCESS) Logger::fatal("Failed to allocate GPU scene descriptor set");
+
+        // Storage buffer descriptors can't be empty, so every frame starts with some room
+        createFrameBuffers(frame, MIN_INSTANCE_CAPACITY, MIN_BUCKET_CAPACITY);
+
+        VkCommandPoolCreateInfo command_pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        command_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        command_pool_info.queueFamilyIndex = m_context->device.getQueueFamilyIndices().graphicsFamily.value();
+        if (vkCreateCommandPool(device, &command_pool_info, nullptr, &frame.command_pool) != VK_SUCCESS) Logger::fatal("Failed to create GPU scene command pool");
+        frame.draw_commands.allocate(*m_context, frame.command_pool, false);
+    }
+}
+
+void VulkanGpuScene::destroyFrames() {
+    VkDevice device = m_context->device.getLogicalDevice();
+    for (auto& frame : m_frames) {
+        frame.instance_buffer.destroy();
+        frame.bucket_buffer.destroy();
+        frame.command_buffer.destroy();
+        frame.count_buffer.destroy();
+        frame.draw_commands.free();
+        vkDestroyCommandPool(device, frame.command_pool, nullptr);
+    }
+    m_frames.clear();
+
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr); // Frees the sets too
+    m_descriptor_pool = VK_NULL_HANDLE;
+}
+
+void VulkanGpuScene::createFrameBuffers(Frame& frame, uint32_t instance_capacity, uint32_t bucket_capacity) {
+    // The frame has retired, so the old buffers only have to wait for the deletion queue
+    if (frame.instance_capacity > 0) {
+        frame.instance_buffer.destroy();
+        frame.bucket_buffer.destroy();
+        frame.command_buffer.destroy();
+        frame.count_buffer.destroy();
+    }
+
+    VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    frame.instance_buffer.create(*m_context, sizeof(VulkanGpuInstance) * static_cast<VkDeviceSize>(instance_capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags);
+    frame.command_buffer.create(*m_context, sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(instance_capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, memory_property_flags);
+    frame.bucket_buffer.create(*m_context, sizeof(Bucket) * static_cast<VkDeviceSize>(bucket_capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags);
+    frame.count_buffer.create(*m_context, sizeof(uint32_t) * static_cast<VkDeviceSize>(bucket_capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags);
+    frame.instance_capacity = instance_capacity;
+    frame.bucket_capacity = bucket_capacity;
+
+    writeDescriptorSet(frame);
+}
+
+void VulkanGpuScene::writeDescriptorSet(Frame& frame) {
+    VulkanBuffer* buffers[BINDING_COUNT] = { &frame.instance_buffer, &frame.bucket_buffer, &frame.command_buffer, &frame.count_buffer };
+
+    VkDescriptorBufferInfo buffer_infos[BINDING_COUNT];
+    VkWriteDescriptorSet writes[BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+        buffer_infos[i] = { buffers[i]->getHandle(), 0, VK_WHOLE_SIZE };
+        writes[i] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        writes[i].dstSet = frame.descriptor_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(m_context->device.getLogicalDevice(), BINDING_COUNT, writes, 0, nullptr);
+}
+
+uint32_t VulkanGpuScene::addInstance(const VulkanMesh& mesh, const glm::vec4& bounds, const glm::vec3& position, float scale, const VulkanPipelineDescription* pipeline_description) {
+    if (!m_supported) return UINT32_MAX;
+    if (!mesh.isValid()) {
+        Logger::warn("Can't add an instance of a mesh that isn't in the geometry pool");
+        return UINT32_MAX;
+    }
+    if (mesh.vertex_stride != sizeof(Vertex3D)) {
+        Logger::error("GPU scene instances have to be meshes of Vertex3D, this one has a vertex stride of %u", mesh.vertex_stride);
+        return UINT32_MAX;
+    }
+
+    // Hashed before taking the lock, it serialises the whole description
+    uint64_t hash = pipeline_description ? VulkanPipelineStateCache::hash(*pipeline_description) : 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t material = UINT32_MAX;
+    if (pipeline_description) {
+        for (uint32_t i = 0; i < m_materials.size() && material == UINT32_MAX; i++) {
+            if (m_materials[i].hash == hash) material = i;
+        }
+        if (material == UINT32_MAX) {
+            material = static_cast<uint32_t>(m_materials.size());
+            m_materials.push_back({ hash, *pipeline_description, nullptr });
+        }
+    }
+
+    uint32_t id;
+    if (m_free_ids.empty()) {
+        id = static_cast<uint32_t>(m_instances.size());
+        m_instances.emplace_back();
+    } else {
+        id = m_free_ids.back();
+        m_free_ids.pop_back();
+    }
+
+    Instance& instance = m_instances[id];
+    instance.mesh_id = mesh.id;
+    instance.bounds = bounds;
+    instance.position = position;
+    instance.scale = scale;
+    instance.material = material;
+    instance.live = true;
+    m_version++;
+    return id;
+}
+
+void VulkanGpuScene::removeInstance(uint32_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_instances.size() || !m_instances[id].live) {
+        Logger::warn("Removing an instance that isn't in the GPU scene");
+        return;
+    }
+    m_instances[id].live = false;
+    m_free_ids.push_back(id);
+    m_version++;
+}
+
+void VulkanGpuScene::setInstanceTransform(uint32_t id, const glm::vec3& position, float scale) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_instances.size() || !m_instances[id].live) return;
+    m_instances[id].position = position;
+    m_instances[id].scale = scale;
+    m_version++;
+}
+
+void VulkanGpuScene::setViewProjection(const glm::mat4& view_projection) {
+    Frustum frustum = Frustum::fromViewProjection(view_projection);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::copy(frustum.planes, frustum.planes + 6, m_planes);
+}
+
+uint32_t VulkanGpuScene::getInstanceCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<uint32_t>(m_instances.size() - m_free_ids.size());
+}
+
+void VulkanGpuScene::build() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Compaction moves meshes, so their draws have to be fetched again even if no instance changed
+    uint64_t generation = m_context->geometry.getGeneration();
+    if (generation != m_geometry_generation) {
+        m_geometry_generation = generation;
+        m_version++;
+    }
+    if (resolveMaterials()) m_version++;
+    if (m_built_version == m_version) return;
+    m_built_version = m_version;
+    WYVERN_PROFILE_SCOPE("Build GPU scene");
+
+    // Group by pipeline and page, counting sort since there are only ever a handful of buckets
+    std::vector<VulkanGpuInstance> unsorted;
+    m_buckets.clear();
+    for (const auto& instance : m_instances) {
+        if (!instance.live) continue;
+        VulkanMesh mesh = m_context->geometry.getMesh(instance.mesh_id);
+        if (!mesh.isValid()) continue; // Mesh was freed before the instance was removed
+
+        VulkanPipeline* pipeline = instance.material == UINT32_MAX ? m_shader.getPipeline() : m_materials[instance.material].pipeline;
+        uint32_t bucket = 0;
+        while (bucket < m_buckets.size() && (m_buckets[bucket].pipeline != pipeline || m_buckets[bucket].page != mesh.page)) bucket++;
+        if (bucket == m_buckets.size()) m_buckets.push_back({ pipeline, mesh.page, { 0, 0 } });
+        m_buckets[bucket].range.count++;
+
+        VulkanGpuInstance gpu_instance;
+        gpu_instance.position_scale = glm::vec4(instance.position, instance.scale);
+        gpu_instance.bounding_sphere = glm::vec4(instance.position + glm::vec3(instance.bounds) * instance.scale, instance.bounds.w * instance.scale);
+        gpu_instance.index_count = mesh.index_count;
+        gpu_instance.first_index = mesh.first_index;
+        gpu_instance.vertex_offset = mesh.vertex_offset;
+        gpu_instance.bucket = bucket;
+        unsorted.push_back(gpu_instance);
+    }
+
+    uint32_t first = 0;
+    std::vector<uint32_t> next(m_buckets.size());
+    for (size_t i = 0; i < m_buckets.size(); i++) {
+        m_buckets[i].range.first = first;
+        next[i] = first;
+        first += m_buckets[i].range.count;
+    }
+
+    m_sorted_instances.resize(unsorted.size());
+    for (const auto& gpu_instance : unsorted) m_sorted_instances[next[gpu_instance.bucket]++] = gpu_instance;
+
+    m_bucket_ranges.resize(m_buckets.size());
+    for (size_t i = 0; i < m_buckets.size(); i++) m_bucket_ranges[i] = m_buckets[i].range;
+}
+
+bool VulkanGpuScene::resolveMaterials() {
+    /*
+        A lookup per material each build, which is a hash of the description in the cache, so pipelines that finish compiling are picked up
+        Pipelines that failed to compile keep returning the fallback, so they never cause a rebuild
+    */
+    bool changed = false;
+    for (auto& material : m_materials) {
+        VulkanPipeline* pipeline = m_context->pipeline_states.get(material.description, m_shader.getPipeline());
+        if (pipeline == material.pipeline) continue;
+        material.pipeline = pipeline;
+        changed = true;
+    }
+    return changed;
+}
+
+void VulkanGpuScene::update(uint32_t frame_index) {
+    if (!m_supported) return;
+    build();
+
+    Frame& frame = m_frames[frame_index];
+    if (frame.version == m_built_version) return;
+
+    uint32_t instance_count = static_cast<uint32_t>(m_sorted_instances.size());
+    uint32_t bucket_count = static_cast<uint32_t>(m_buckets.size());
+    if (instance_count > frame.instance_capacity || bucket_count > frame.bucket_capacity) {
+        createFrameBuffers(frame, std::max(instance_count + instance_count / 2, frame.instance_capacity), std::max(bucket_count * 2, frame.bucket_capacity));
+    }
+
+    if (instance_count > 0) {
+        m_context->staging_ring.upload(m_sorted_instances.data(), sizeof(VulkanGpuInstance) * instance_count, frame.instance_buffer);
+        m_context->staging_ring.upload(m_bucket_ranges.data(), sizeof(Bucket) * bucket_count, frame.bucket_buffer);
+    }
+
+    frame.version = m_built_version;
+    frame.instance_count = instance_count;
+    frame.buckets = m_buckets;
+}
+
+void VulkanGpuScene::recordCull(uint32_t frame_index, VulkanCommandBuffer& command_buffer) {
+    Frame& frame = m_frames[frame_index];
+    if (frame.buckets.empty()) return;
+    VkCommandBuffer cmd = command_buffer.getHandle();
+
+    // Counts start from zero every frame, the shader appends to them
+    if (m_use_count) {
+        vkCmdFillBuffer(cmd, frame.count_buffer.getHandle(), 0, sizeof(uint32_t) * frame.buckets.size(), 0);
+
+        VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    CullConstants constants;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::copy(m_planes, m_planes + 6, constants.planes);
+    }
+    constants.instance_count = frame.instance_count;
+    constants.use_count = m_use_count ? 1 : 0;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_layout, 0, 1, &frame.descriptor_set, 0, nullptr);
+    vkCmdPushConstants(cmd, m_cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+    vkCmdDispatch(cmd, (frame.instance_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    // The draws read the commands and counts as indirect arguments
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanGpuScene::recordDraws(uint32_t frame_index, VulkanCommandBuffer& primary, VkFramebuffer framebuffer) {
+    Frame& frame = m_frames[frame_index];
+    if (frame.buckets.empty()) return;
+    WYVERN_PROFILE_SCOPE("Record GPU scene draws");
+
+    // The frame has retired, so nothing from this pool is still executing
+    vkResetCommandPool(m_context->device.getLogicalDevice(), frame.command_pool, 0);
+    VulkanCommandBuffer& command_buffer = frame.draw_commands;
+    command_buffer.reset();
+    command_buffer.beginRecordingSecondary(m_context->renderpass.getHandle(), 0, framebuffer);
+    VkCommandBuffer cmd = command_buffer.getHandle();
+
+    VkViewport viewport = { 0.0f, 0.0f, (float) m_context->framebuffer_width, (float) m_context->framebuffer_height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { m_context->framebuffer_width, m_context->framebuffer_height } };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    VulkanPipeline* bound_pipeline = nullptr;
+    uint32_t bound_page = UINT32_MAX;
+    for (uint32_t i = 0; i < frame.buckets.size(); i++) {
+        const BucketDraw& bucket = frame.buckets[i];
+
+        VulkanPipeline* pipeline = bucket.pipeline;
+        if (pipeline != bound_pipeline) {
+            pipeline->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getLayout(), 0, 1, &frame.descriptor_set, 0, nullptr);
+            bound_pipeline = pipeline;
+        }
+        if (bucket.page != bound_page) {
+            m_context->geometry.bind(cmd, bucket.page);
+            bound_page = bucket.page;
+        }
+
+        drawBucket(cmd, frame, i);
+    }
+
+    command_buffer.endRecording();
+    vkCmdExecuteCommands(primary.getHandle(), 1, &command_buffer.getHandle());
+}
+
+void VulkanGpuScene::drawBucket(VkCommandBuffer command_buffer, Frame& frame, uint32_t bucket_index) {
+    const Bucket& range = frame.buckets[bucket_index].range;
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize offset = static_cast<VkDeviceSize>(range.first) * stride;
+
+    if (m_use_count) {
+        m_draw_indexed_indirect_count(command_buffer, frame.command_buffer.getHandle(), offset, frame.count_buffer.getHandle(), bucket_index * sizeof(uint32_t), range.count, stride);
+        return;
+    }
+
+    // Every slot is drawn, culled ones have an instance count of 0
+    for (uint32_t drawn = 0; drawn < range.count; drawn += m_max_draw_count) {
+        uint32_t draw_count = std::min(m_max_draw_count, range.count - drawn);
+        vkCmdDrawIndexedIndirect(command_buffer, frame.command_buffer.getHandle(), offset + static_cast<VkDeviceSize>(drawn) * stride, draw_count, stride);
+    }
+}
@@ -30,13 +30,10 @@ void VulkanImage::create(VulkanContext& context, VkImageType imageType, int widt
     VkMemoryRequirements memory_requirements;
     vkGetImageMemoryRequirements(context.device.getLogicalDevice(), m_image, &memory_requirements);
 
-    VkMemoryAllocateInfo memory_allocate_info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    memory_allocate_info.allocationSize = memory_requirements.size;
-    memory_allocate_info.memoryTypeIndex = context.device.findMemoryType(memory_requirements.memoryTypeBits, memory_flags);
-    result = vkAllocateMemory(context.device.getLogicalDevice(), &memory_allocate_info, nullptr, &m_deviceMemory);
-    if (result != VK_SUCCESS) Logger::fatal("Failed to allocate image memory");
+    m_allocation = context.device.getAllocator().allocate(memory_requirements, memory_flags, tiling == VK_IMAGE_TILING_LINEAR);
+    if (!m_allocation.isValid()) Logger::fatal("Failed to allocate image memory");
 
-    vkBindImageMemory(context.device.getLogicalDevice(), m_image, m_deviceMemory, 0);
+    vkBindImageMemory(context.device.getLogicalDevice(), m_image, m_allocation.memory, m_allocation.offset);
 
     Logger::info("Successfully created image");
 
@@ -66,7 +63,10 @@ void VulkanImage::createImageView(VkFormat format, VkImageAspectFlags view_aspec
 }
 
 void VulkanImage::destroy() {
-    if (m_imageView != VK_NULL_HANDLE) vkDestroyImageView(m_context->device.getLogicalDevice(), m_imageView, nullptr);
-    if (m_image != VK_NULL_HANDLE) vkDestroyImage(m_context->device.getLogicalDevice(), m_image, nullptr);
-    if (m_deviceMemory != VK_NULL_HANDLE) vkFreeMemory(m_context->device.getLogicalDevice(), m_deviceMemory, nullptr);
+    m_context->deletion_queue.pushImageView(m_imageView);
+    m_context->deletion_queue.pushImage(m_image);
+    m_context->deletion_queue.pushAllocation(m_allocation);
+    m_imageView = VK_NULL_HANDLE;
+    m_image = VK_NULL_HANDLE;
+    m_allocation = VulkanAllocation();
 }
\ No newline at end of file
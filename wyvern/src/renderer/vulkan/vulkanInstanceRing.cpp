@@ -0,0 +1,149 @@
+#include "renderer/vulkan/VulkanInstanceRing.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Everything that has to match for two draws to become instances of one draw, first_instance is overwritten so it doesn't count
+static bool isSameBatch(const VulkanDrawCommand& a, const VulkanDrawCommand& b) {
+    return a.index_count == b.index_count && a.first_index == b.first_index && a.vertex_offset == b.vertex_offset &&
+           a.geometry_page == b.geometry_page && a.pipeline == b.pipeline && a.dequantization == b.dequantization;
+}
+
+static uint64_t hashBatch(const VulkanDrawCommand& draw) {
+    // Mesh and material are what differ between batches, so they're mixed in with a multiply and shift each
+    uint64_t values[6] = {
+        draw.index_count, draw.first_index, static_cast<uint32_t>(draw.vertex_offset), draw.geometry_page,
+        reinterpret_cast<uintptr_t>(draw.pipeline), reinterpret_cast<uintptr_t>(draw.dequantization),
+    };
+    uint64_t hash = 0;
+    for (uint64_t value : values) {
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+void VulkanInstanceRing::create(VulkanContext& context, uint32_t frame_count, uint32_t instances_per_frame) {
+    m_context = &context;
+    m_instances_per_frame = instances_per_frame;
+    recreateFrames(frame_count);
+
+    Logger::info("Created instance ring of %u instances per frame", m_instances_per_frame);
+}
+
+void VulkanInstanceRing::destroy() {
+    for (auto& frame : m_frames) {
+        if (frame.capacity > 0) frame.buffer.destroy();
+    }
+    m_frames.clear();
+}
+
+void VulkanInstanceRing::recreateFrames(uint32_t frame_count) {
+    destroy();
+    m_frames.resize(frame_count);
+    for (auto& frame : m_frames) createFrameBuffer(frame, m_instances_per_frame);
+    m_current_frame = 0;
+    m_last_instance_count = 0;
+}
+
+void VulkanInstanceRing::createFrameBuffer(Frame& frame, uint32_t capacity) {
+    // The frame has retired, so the old buffer only has to wait for the deletion queue
+    if (frame.capacity > 0) frame.buffer.destroy();
+
+    // Written once by the CPU and read once per instance by the GPU, so there's no point staging it into device local memory
+    VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    frame.buffer.create(*m_context, sizeof(InstanceData) * static_cast<VkDeviceSize>(capacity), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memory_property_flags);
+    frame.mapped = static_cast<InstanceData*>(frame.buffer.getAllocation().mapped);
+    frame.capacity = capacity;
+}
+
+const VulkanDrawCommand* VulkanInstanceRing::batch(uint32_t frame_index, LinearAllocator& arena, const VulkanDrawCommand* draws, size_t draw_count, size_t& out_draw_count) {
+    m_current_frame = frame_index;
+    m_last_instance_count = 0;
+    m_last_batch_count = 0;
+
+    size_t instanced_count = 0;
+    for (size_t i = 0; i < draw_count; i++) instanced_count += draws[i].instance ? 1 : 0;
+    if (instanced_count == 0) {
+        out_draw_count = draw_count;
+        return draws;
+    }
+    WYVERN_PROFILE_SCOPE("Batch instances");
+
+    /*
+        First pass: find the batch of every instanced draw and count its instances
+        Batches are found through an open addressing table of indices into out_draws, at most half full so probes stay short
+    */
+    uint32_t table_size = 1;
+    while (table_size < instanced_count * 2) table_size *= 2;
+    uint32_t* table = arena.allocateArray<uint32_t>(table_size);
+    std::fill(table, table + table_size, UINT32_MAX);
+
+    VulkanDrawCommand* out_draws = arena.allocateArray<VulkanDrawCommand>(draw_count);
+    uint32_t* batch_of_draw = arena.allocateArray<uint32_t>(draw_count);
+    size_t out_count = 0;
+    uint32_t instance_count = 0;
+
+    for (size_t i = 0; i < draw_count; i++) {
+        const VulkanDrawCommand& draw = draws[i];
+        batch_of_draw[i] = UINT32_MAX;
+        if (!draw.instance) {
+            out_draws[out_count++] = draw;
+            continue;
+        }
+        if (draw.instance_count == 0) continue;
+
+        uint32_t slot = static_cast<uint32_t>(hashBatch(draw)) & (table_size - 1);
+        while (table[slot] != UINT32_MAX && !isSameBatch(out_draws[table[slot]], draw)) slot = (slot + 1) & (table_size - 1);
+
+        if (table[slot] == UINT32_MAX) {
+            // Drawn where the first draw of the batch was
+            table[slot] = static_cast<uint32_t>(out_count);
+            out_draws[out_count] = draw;
+            out_draws[out_count].instance_count = 0;
+            out_count++;
+            m_last_batch_count++;
+        }
+        batch_of_draw[i] = table[slot];
+        out_draws[table[slot]].instance_count += draw.instance_count;
+        instance_count += draw.instance_count;
+    }
+
+    Frame& frame = m_frames[frame_index];
+    if (instance_count > frame.capacity) {
+        uint32_t capacity = std::max(instance_count, frame.capacity * 2);
+        Logger::info("Growing frame %u's instance buffer from %u to %u instances", frame_index, frame.capacity, capacity);
+        createFrameBuffer(frame, capacity);
+    }
+
+    // Second pass: give every batch its run of the buffer, then copy each draw's instances to the end of its batch's run
+    uint32_t* batch_cursors = arena.allocateArray<uint32_t>(out_count);
+    uint32_t first_instance = 0;
+    for (size_t i = 0; i < out_count; i++) {
+        if (!out_draws[i].instance) continue;
+        out_draws[i].first_instance = first_instance;
+        batch_cursors[i] = first_instance;
+        first_instance += out_draws[i].instance_count;
+    }
+
+    for (size_t i = 0; i < draw_count; i++) {
+        uint32_t batch = batch_of_draw[i];
+        if (batch == UINT32_MAX) continue;
+        memcpy(frame.mapped + batch_cursors[batch], draws[i].instance, sizeof(InstanceData) * draws[i].instance_count);
+        batch_cursors[batch] += draws[i].instance_count;
+    }
+
+    m_last_instance_count = instance_count;
+    out_draw_count = out_count;
+    return out_draws;
+}
+
+void VulkanInstanceRing::bind(VkCommandBuffer command_buffer) {
+    if (m_last_instance_count == 0) return;
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, INSTANCE_BINDING, 1, &m_frames[m_current_frame].buffer.getHandle(), &offset);
+}
@@ -1,25 +1,26 @@
 #include "renderer/vulkan/VulkanPipeline.hpp"
 #include "renderer/vulkan/VulkanBackend.hpp"
 #include "core/Logger.hpp"
-#include "core/Vertex.hpp"
 
-void VulkanPipeline::create(VulkanContext& context, const std::vector<VkVertexInputAttributeDescription>& attributes, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const std::vector<VkPipelineShaderStageCreateInfo>& stages, VkViewport viewport, VkRect2D scissor, bool is_wireframe) {
+#include <chrono>
+
+bool VulkanPipeline::create(VulkanContext& context, const VulkanPipelineDescription& description) {
     m_context = &context;
-    // Viewport state
+    // Viewport state, the actual viewport and scissor are dynamic and set when recording
     VkPipelineViewportStateCreateInfo viewport_state = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
 
     // Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizer = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
     rasterizer.depthClampEnable = VK_FALSE; 
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = is_wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+    rasterizer.polygonMode = description.polygon_mode;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.cullMode = description.cull_mode;
+    rasterizer.frontFace = description.front_face;
     rasterizer.depthBiasEnable = VK_FALSE;
 
     // Multisamplign is one way to reduce anti aliasing, basically combines fragment shader results of multiple polygons that rasterize to the same pixel
@@ -29,9 +30,9 @@ void VulkanPipeline::create(VulkanContext& context, const std::vector<VkVertexIn
 
     // Depth and stencil testing
     VkPipelineDepthStencilStateCreateInfo depth_stencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
-    depth_stencil.depthTestEnable = VK_TRUE;
-    depth_stencil.depthWriteEnable = VK_TRUE;
-    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depth_stencil.depthTestEnable = description.depth_test ? VK_TRUE : VK_FALSE;
+    depth_stencil.depthWriteEnable = description.depth_write ? VK_TRUE : VK_FALSE;
+    depth_stencil.depthCompareOp = description.depth_compare;
     depth_stencil.depthBoundsTestEnable = VK_FALSE;
     depth_stencil.stencilTestEnable = VK_FALSE;
 
@@ -42,7 +43,13 @@ void VulkanPipeline::create(VulkanContext& context, const std::vector<VkVertexIn
     */
     VkPipelineColorBlendAttachmentState color_blend_attachment{};
     color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment.blendEnable = VK_FALSE;
+    color_blend_attachment.blendEnable = description.blend_enable ? VK_TRUE : VK_FALSE;
+    color_blend_attachment.srcColorBlendFactor = description.src_color_blend;
+    color_blend_attachment.dstColorBlendFactor = description.dst_color_blend;
+    color_blend_attachment.colorBlendOp = description.color_blend_op;
+    color_blend_attachment.srcAlphaBlendFactor = description.src_alpha_blend;
+    color_blend_attachment.dstAlphaBlendFactor = description.dst_alpha_blend;
+    color_blend_attachment.alphaBlendOp = description.alpha_blend_op;
     VkPipelineColorBlendStateCreateInfo color_blending = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
     color_blending.logicOpEnable = VK_FALSE;
     color_blending.logicOp = VK_LOGIC_OP_COPY; // Optional
@@ -63,30 +70,40 @@ void VulkanPipeline::create(VulkanContext& context, const std::vector<VkVertexIn
     dynamic_state.pDynamicStates = dynamic_states.data();
 
     // Describe format of vertex data that will be passed onto vertex shader
-    VkVertexInputBindingDescription vertex_input_binding;
-    vertex_input_binding.binding = 0;
-    vertex_input_binding.stride = sizeof(Vertex3D);
-    vertex_input_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // Move to next data entry for each vertex
     VkPipelineVertexInputStateCreateInfo vertex_input_info ={VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &vertex_input_binding; // Optional
-    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-    vertex_input_info.pVertexAttributeDescriptions = attributes.data(); // Optional
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(description.bindings.size());
+    vertex_input_info.pVertexBindingDescriptions = description.bindings.data(); // Optional
+    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.attributes.size());
+    vertex_input_info.pVertexAttributeDescriptions = description.attributes.data(); // Optional
 
     // Describe geometry that will be drawn from the vertices
     VkPipelineInputAssemblyStateCreateInfo input_assembly={VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
-    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly.topology = description.topology;
     input_assembly.primitiveRestartEnable = VK_FALSE;
 
     /*
         Uniform values need to be specified during pipeline creation
     */
     VkPipelineLayoutCreateInfo pipeline_layout = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-    pipeline_layout.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
-    pipeline_layout.pSetLayouts = descriptor_set_layouts.data();
+    pipeline_layout.setLayoutCount = static_cast<uint32_t>(description.descriptor_set_layouts.size());
+    pipeline_layout.pSetLayouts = description.descriptor_set_layouts.data();
+    pipeline_layout.pushConstantRangeCount = static_cast<uint32_t>(description.push_constant_ranges.size());
+    pipeline_layout.pPushConstantRanges = description.push_constant_ranges.data();
+    m_push_constant_ranges = description.push_constant_ranges;
     
     VkResult result = vkCreatePipelineLayout(m_context->device.getLogicalDevice(), &pipeline_layout, nullptr, &m_pipeline_layout);
-    if (result != VK_SUCCESS) Logger::error("Failed to create pipeline layout");
+    if (result != VK_SUCCESS) {
+        Logger::error("Failed to create pipeline layout");
+        return false;
+    }
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages(description.stages.size());
+    for (size_t i = 0; i < stages.size(); i++) {
+        stages[i] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        stages[i].stage = description.stages[i].stage;
+        stages[i].module = description.stages[i].module;
+        stages[i].pName = description.stages[i].entry_point.c_str();
+    }
 
     /*
         Finally, we can combine everything to create the pipeline
@@ -103,19 +120,39 @@ void VulkanPipeline::create(VulkanContext& context, const std::vector<VkVertexIn
     pipeline_create_info.pColorBlendState = &color_blending;
     pipeline_create_info.pDynamicState = &dynamic_state;
     pipeline_create_info.layout = m_pipeline_layout;
-    pipeline_create_info.renderPass = m_context->renderpass.getHandle();
-    pipeline_create_info.subpass = 0;
+    pipeline_create_info.renderPass = description.renderpass != VK_NULL_HANDLE ? description.renderpass : m_context->renderpass.getHandle();
+    pipeline_create_info.subpass = description.subpass;
     pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_create_info.basePipelineIndex = -1;
 
-    result = vkCreateGraphicsPipelines(m_context->device.getLogicalDevice(), VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &m_graphics_pipeline);
-    if (result != VK_SUCCESS) Logger::error("vkCreateGraphicsPipelines failed with %s", result);
-    else Logger::debug("Successfully created graphics pipeline");
+    // The pipeline cache lets the driver skip compiling shaders it has already seen on a previous run
+    auto compile_start = std::chrono::steady_clock::now();
+    result = vkCreateGraphicsPipelines(m_context->device.getLogicalDevice(), m_context->device.getPipelineCache(), 1, &pipeline_create_info, nullptr, &m_graphics_pipeline);
+    std::chrono::duration<double, std::milli> compile_time = std::chrono::steady_clock::now() - compile_start;
+
+    if (result != VK_SUCCESS) {
+        Logger::error("vkCreateGraphicsPipelines failed with %d", result);
+        vkDestroyPipelineLayout(m_context->device.getLogicalDevice(), m_pipeline_layout, nullptr);
+        m_pipeline_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    Logger::debug("Successfully created graphics pipeline in %.2f ms (%s pipeline cache)", compile_time.count(), m_context->device.isPipelineCacheWarm() ? "warm" : "cold");
+    return true;
+}
+
+bool VulkanPipeline::hasPushConstants(VkShaderStageFlags stage, uint32_t size) const {
+    for (const auto& range : m_push_constant_ranges) {
+        if ((range.stageFlags & stage) == stage && range.offset == 0 && range.size >= size) return true;
+    }
+    return false;
 }
 
 void VulkanPipeline::destroy() {
-    vkDestroyPipeline(m_context->device.getLogicalDevice(), m_graphics_pipeline, nullptr);
-    vkDestroyPipelineLayout(m_context->device.getLogicalDevice(), m_pipeline_layout, nullptr);
+    m_context->deletion_queue.pushPipeline(m_graphics_pipeline);
+    m_context->deletion_queue.pushPipelineLayout(m_pipeline_layout);
+    m_graphics_pipeline = VK_NULL_HANDLE;
+    m_pipeline_layout = VK_NULL_HANDLE;
 }
 
 void VulkanPipeline::bind(VulkanCommandBuffer& command_buffer, VkPipelineBindPoint bind_point) {
@@ -0,0 +1,162 @@
+#include "renderer/vulkan/VulkanPipelineStateCache.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+
+#include <cstring>
+#include <thread>
+
+// Appends the raw bytes of a value, only used on types without padding
+template<typename T>
+static void append(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void VulkanPipelineStateCache::create(VulkanContext& context) {
+    m_context = &context;
+}
+
+void VulkanPipelineStateCache::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& bucket : m_entries) {
+        for (auto& entry : bucket.second) {
+            JobSystem::wait(entry->compile_counter); // Can't destroy a pipeline that a worker is still creating
+            entry->pipeline.destroy();
+        }
+    }
+
+    Logger::info("Pipeline state cache: %u hits, %u misses", m_hits, m_misses);
+    m_entries.clear();
+    m_hits = m_misses = 0;
+}
+
+void VulkanPipelineStateCache::serialise(const VulkanPipelineDescription& description, std::vector<uint8_t>& out) {
+    /*
+        Fields are written one by one rather than copying whole structs, so padding bytes never end up in the key
+        Vector sizes are included so e.g. two bindings and one attribute can't produce the same bytes as one binding and two attributes
+    */
+    out.clear();
+
+    append(out, description.stages.size());
+    for (const auto& stage : description.stages) {
+        append(out, stage.stage);
+        append(out, stage.module);
+        out.insert(out.end(), stage.entry_point.begin(), stage.entry_point.end());
+        out.push_back(0);
+    }
+
+    append(out, description.bindings.size());
+    for (const auto& binding : description.bindings) {
+        append(out, binding.binding);
+        append(out, binding.stride);
+        append(out, binding.inputRate);
+    }
+
+    append(out, description.attributes.size());
+    for (const auto& attribute : description.attributes) {
+        append(out, attribute.location);
+        append(out, attribute.binding);
+        append(out, attribute.format);
+        append(out, attribute.offset);
+    }
+
+    append(out, description.descriptor_set_layouts.size());
+    for (const auto& layout : description.descriptor_set_layouts) append(out, layout);
+
+    append(out, description.push_constant_ranges.size());
+    for (const auto& range : description.push_constant_ranges) {
+        append(out, range.stageFlags);
+        append(out, range.offset);
+        append(out, range.size);
+    }
+
+    append(out, description.topology);
+    append(out, description.polygon_mode);
+    append(out, description.cull_mode);
+    append(out, description.front_face);
+    append(out, description.depth_test);
+    append(out, description.depth_write);
+    append(out, description.depth_compare);
+    append(out, description.blend_enable);
+    append(out, description.src_color_blend);
+    append(out, description.dst_color_blend);
+    append(out, description.color_blend_op);
+    append(out, description.src_alpha_blend);
+    append(out, description.dst_alpha_blend);
+    append(out, description.alpha_blend_op);
+    append(out, description.renderpass);
+    append(out, description.subpass);
+}
+
+static uint64_t hashBytes(const std::vector<uint8_t>& bytes) {
+    // FNV-1a, descriptions are small and this only runs on lookups
+    uint64_t hash = 14695981039346656037ull;
+    for (uint8_t byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t VulkanPipelineStateCache::hash(const VulkanPipelineDescription& description) {
+    std::vector<uint8_t> key;
+    serialise(description, key);
+    return hashBytes(key);
+}
+
+VulkanPipeline* VulkanPipelineStateCache::get(const VulkanPipelineDescription& description, VulkanPipeline* fallback) {
+    Entry* entry = nullptr;
+    bool is_new = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        serialise(description, m_key);
+        uint64_t key_hash = hashBytes(m_key);
+
+        auto& bucket = m_entries[key_hash];
+        for (auto& candidate : bucket) {
+            if (candidate->key == m_key) {
+                entry = candidate.get();
+                break;
+            }
+        }
+
+        if (!entry) {
+            bucket.push_back(std::make_unique<Entry>());
+            entry = bucket.back().get();
+            entry->key = m_key;
+            entry->description = description;
+            is_new = true;
+            m_misses++;
+            Logger::debug("Pipeline %016llx not cached, compiling %s", (unsigned long long)key_hash, fallback ? "in the background" : "now");
+        } else {
+            m_hits++;
+        }
+    }
+
+    if (is_new) {
+        if (fallback) JobSystem::run([this, entry]() { compile(*entry); }, &entry->compile_counter);
+        else compile(*entry);
+    }
+
+    PipelineState state = entry->state.load(std::memory_order_acquire);
+    if (state == PipelineState::READY) return &entry->pipeline;
+    if (fallback) return fallback;
+
+    /*
+        Someone else is compiling it, either as a job or on their own thread without a fallback
+        The second kind never touches compile_counter, so wait on the state and only help out with jobs while there's a compile job to wait for
+    */
+    while (entry->state.load(std::memory_order_acquire) == PipelineState::COMPILING) {
+        if (!entry->compile_counter.isDone()) JobSystem::wait(entry->compile_counter);
+        else std::this_thread::yield();
+    }
+    return entry->state.load(std::memory_order_acquire) == PipelineState::READY ? &entry->pipeline : nullptr;
+}
+
+void VulkanPipelineStateCache::compile(Entry& entry) {
+    bool success = entry.pipeline.create(*m_context, entry.description);
+    if (!success) Logger::error("Failed to compile pipeline, draws using it will keep using the fallback");
+    entry.state.store(success ? PipelineState::READY : PipelineState::FAILED, std::memory_order_release);
+}
@@ -26,6 +26,7 @@ void VulkanRenderpass::create(VulkanContext& context, glm::vec2 size, glm::vec2
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // images to be presented in the swap chain
+    if (m_context->headless) color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // Nothing is presented, leave it ready to be read back
     VkAttachmentDescription depth_attachment{};
     depth_attachment.format = m_context->device.getDepthFormat();
     depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -78,7 +79,7 @@ void VulkanRenderpass::destroy() {
     vkDestroyRenderPass(m_context->device.getLogicalDevice(), m_renderPass, nullptr);
 }
 
-void VulkanRenderpass::begin(VulkanCommandBuffer* commandBuffer, VkFramebuffer& framebuffer) {
+void VulkanRenderpass::begin(VulkanCommandBuffer* commandBuffer, VkFramebuffer& framebuffer, VkSubpassContents contents) {
     VkRenderPassBeginInfo renderpass_begin_info = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
     renderpass_begin_info.renderPass = m_renderPass;
     renderpass_begin_info.framebuffer = framebuffer;
@@ -91,7 +92,7 @@ void VulkanRenderpass::begin(VulkanCommandBuffer* commandBuffer, VkFramebuffer&
     renderpass_begin_info.clearValueCount = 2;
     renderpass_begin_info.pClearValues = clear_values;
 
-    vkCmdBeginRenderPass(commandBuffer->getHandle(), &renderpass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer->getHandle(), &renderpass_begin_info, contents);
     commandBuffer->setState(CommandBufferState::IN_RENDER_PASS);
 }
 
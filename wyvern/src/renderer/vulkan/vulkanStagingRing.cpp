@@ -0,0 +1,379 @@
+#include "renderer/vulkan/VulkanStagingRing.hpp"
+#include "renderer/vulkan/VulkanBackend.hpp"
+#include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+
+#include <algorithm>
+
+// Everything that may read uploaded data on the graphics queue
+static const VkAccessFlags UPLOAD_DST_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+static const VkPipelineStageFlags UPLOAD_DST_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+static VkCommandPool createCommandPool(VkDevice device, uint32_t queue_family) {
+    VkCommandPoolCreateInfo create_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    create_info.queueFamilyIndex = queue_family;
+
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    if (vkCreateCommandPool(device, &create_info, nullptr, &command_pool) != VK_SUCCESS) Logger::fatal("Failed to create staging ring command pool");
+    return command_pool;
+}
+
+void VulkanStagingRing::create(VulkanContext& context, VkDeviceSize size) {
+    m_context = &context;
+    m_capacity = size;
+
+    VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_buffer.create(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, flags);
+    m_mapped = static_cast<char*>(m_buffer.getAllocation().mapped);
+
+    m_dedicated_transfer = context.device.hasDedicatedTransferQueue() && context.frame_timeline.usesTimelineSemaphore();
+    if (context.device.hasDedicatedTransferQueue() && !m_dedicated_transfer) Logger::info("Transfer queue can't wait on frames without timeline semaphores, staging uploads will use the graphics queue");
+    QueueFamilyIndices indices = context.device.getQueueFamilyIndices();
+    m_graphics_family = indices.graphicsFamily.value();
+    m_transfer_family = m_dedicated_transfer ? indices.transferFamily.value() : m_graphics_family;
+    m_submit_thread = std::this_thread::get_id();
+
+    VkSemaphoreCreateInfo semaphore_create_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    m_command_pool = createCommandPool(context.device.getLogicalDevice(), m_transfer_family);
+    for (auto& submission : m_submissions) {
+        submission.command_buffer.allocate(context, m_command_pool, true);
+        submission.fence.create(context, false);
+        if (m_dedicated_transfer) vkCreateSemaphore(context.device.getLogicalDevice(), &semaphore_create_info, nullptr, &submission.semaphore);
+    }
+
+    if (m_dedicated_transfer) {
+        m_acquire_command_pool = createCommandPool(context.device.getLogicalDevice(), m_graphics_family);
+        m_acquire_command_buffer.allocate(context, m_acquire_command_pool, true);
+        m_acquire_fence.create(context, false);
+    }
+
+    Logger::info("Created %llu MB staging ring on the %s queue", (unsigned long long)(size >> 20), m_dedicated_transfer ? "transfer" : "graphics");
+}
+
+void VulkanStagingRing::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& submission : m_submissions) {
+        if (submission.in_flight) submission.fence.wait(UINT64_MAX);
+        submission.command_buffer.free();
+        submission.fence.destroy();
+        if (submission.semaphore != VK_NULL_HANDLE) vkDestroySemaphore(m_context->device.getLogicalDevice(), submission.semaphore, nullptr);
+        submission.semaphore = VK_NULL_HANDLE;
+        submission.acquire_barriers.clear();
+        submission.acquire_pending = false;
+        submission.in_flight = false;
+        for (auto& buffer : submission.overflow_buffers) buffer->destroy();
+        submission.overflow_buffers.clear();
+    }
+
+    if (m_dedicated_transfer) {
+        if (m_acquire_in_flight) m_acquire_fence.wait(UINT64_MAX);
+        m_acquire_command_buffer.free();
+        m_acquire_fence.destroy();
+        m_acquire_in_flight = false;
+        vkDestroyCommandPool(m_context->device.getLogicalDevice(), m_acquire_command_pool, nullptr);
+        m_acquire_command_pool = VK_NULL_HANDLE;
+    }
+    vkDestroyCommandPool(m_context->device.getLogicalDevice(), m_command_pool, nullptr);
+    m_command_pool = VK_NULL_HANDLE;
+
+    for (auto& buffer : m_overflow_buffers) buffer->destroy();
+    m_overflow_buffers.clear();
+    m_pending.clear();
+    m_buffer.destroy();
+}
+
+UploadToken VulkanStagingRing::upload(const void* data, VkDeviceSize size, VulkanBuffer& dst_buffer, VkDeviceSize dst_offset, bool in_use) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Uploads larger than the ring are split up, on the thread that draws frames reserve() will flush and wait for space as needed
+    const char* src = static_cast<const char*>(data);
+    VkDeviceSize remaining = size;
+    while (remaining > 0) {
+        VkDeviceSize chunk_size = std::min(remaining, m_capacity / 2);
+        VkDeviceSize ring_offset;
+        if (!reserve(chunk_size, ring_offset)) {
+            // Everything left goes in one buffer, this thread can't make room in the ring before the next flush
+            uploadOverflow(src, remaining, dst_buffer.getHandle(), dst_offset, in_use);
+            break;
+        }
+        memcpy(m_mapped + ring_offset, src, chunk_size);
+
+        PendingCopy copy;
+        copy.src_buffer = m_buffer.getHandle();
+        copy.dst_buffer = dst_buffer.getHandle();
+        copy.region.srcOffset = ring_offset;
+        copy.region.dstOffset = dst_offset;
+        copy.region.size = chunk_size;
+        copy.in_use = in_use;
+        m_pending.push_back(copy);
+
+        src += chunk_size;
+        dst_offset += chunk_size;
+        remaining -= chunk_size;
+    }
+
+    return m_current_token;
+}
+
+void VulkanStagingRing::uploadOverflow(const char* data, VkDeviceSize size, VkBuffer dst_buffer, VkDeviceSize dst_offset, bool in_use) {
+    auto buffer = std::make_unique<VulkanBuffer>();
+    buffer->create(*m_context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memcpy(buffer->getAllocation().mapped, data, size);
+
+    PendingCopy copy;
+    copy.src_buffer = buffer->getHandle();
+    copy.dst_buffer = dst_buffer;
+    copy.region.srcOffset = 0;
+    copy.region.dstOffset = dst_offset;
+    copy.region.size = size;
+    copy.in_use = in_use;
+    m_pending.push_back(copy);
+    m_overflow_buffers.push_back(std::move(buffer));
+}
+
+bool VulkanStagingRing::reserve(VkDeviceSize size, VkDeviceSize& out_offset) {
+    size = (size + 15) & ~VkDeviceSize(15); // Keep every copy 16 byte aligned
+
+    while (true) {
+        // When nothing is in use, restart from the beginning so we never have to skip the end of the ring
+        if (m_head == m_tail) m_head = m_tail = (m_head + m_capacity - 1) / m_capacity * m_capacity;
+
+        // A copy source has to be contiguous, so if it doesn't fit before the end of the ring skip to the start
+        uint64_t position = m_head % m_capacity;
+        uint64_t skip = position + size > m_capacity ? m_capacity - position : 0;
+
+        if (m_head + skip + size - m_tail <= m_capacity) {
+            m_head += skip;
+            out_offset = m_head % m_capacity;
+            m_head += size;
+            return true;
+        }
+
+        // Ring is full, make sure what's queued is on its way to the GPU, then wait until the oldest batch frees its space
+        retireCompleted();
+        if (m_head + skip + size - m_tail <= m_capacity) continue;
+        if (std::this_thread::get_id() != m_submit_thread) return false;
+        if (!m_pending.empty()) flushLocked();
+        waitOldest();
+    }
+}
+
+UploadToken VulkanStagingRing::flush() {
+    WYVERN_PROFILE_SCOPE("Flush staging ring");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_submit_thread = std::this_thread::get_id();
+    retireCompleted();
+    return flushLocked();
+}
+
+UploadToken VulkanStagingRing::flushLocked() {
+    if (m_pending.empty()) return m_current_token - 1;
+
+    Submission& submission = m_submissions[m_next_submission];
+    if (submission.in_flight) waitOldest(); // Slots are used round robin, so the next slot is always the oldest
+    if (submission.acquire_pending) submitAcquiresLocked(); // The semaphore can't be signalled again until something waited on it
+    submission.fence.reset();
+
+    VulkanCommandBuffer& command_buffer = submission.command_buffer;
+    command_buffer.reset();
+    command_buffer.beginRecording(true, false, false);
+
+    /*
+        Write after read, frames submitted earlier may still be reading the ranges about to be overwritten. Only execution has to be ordered, so there's no memory barrier
+        Ranges nothing has read yet (e.g. a mesh that was just allocated) don't need it, so a batch of only those doesn't wait on the frames in flight
+    */
+    bool overwrites_in_use = std::any_of(m_pending.begin(), m_pending.end(), [](const PendingCopy& copy) { return copy.in_use; });
+    if (overwrites_in_use && !m_dedicated_transfer) vkCmdPipelineBarrier(command_buffer.getHandle(), UPLOAD_DST_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    // Group the regions by source and destination so every pair of buffers gets a single vkCmdCopyBuffer
+    std::sort(m_pending.begin(), m_pending.end(), [](const PendingCopy& a, const PendingCopy& b) {
+        return a.src_buffer != b.src_buffer ? a.src_buffer < b.src_buffer : a.dst_buffer < b.dst_buffer;
+    });
+    m_regions.clear();
+    for (size_t i = 0; i < m_pending.size(); i++) {
+        m_regions.push_back(m_pending[i].region);
+        bool last_for_buffers = i + 1 == m_pending.size() || m_pending[i + 1].src_buffer != m_pending[i].src_buffer || m_pending[i + 1].dst_buffer != m_pending[i].dst_buffer;
+        if (last_for_buffers) {
+            vkCmdCopyBuffer(command_buffer.getHandle(), m_pending[i].src_buffer, m_pending[i].dst_buffer, static_cast<uint32_t>(m_regions.size()), m_regions.data());
+            m_regions.clear();
+        }
+    }
+
+    if (m_dedicated_transfer) {
+        /*
+            Release the written ranges to the graphics family, the graphics queue acquires them with an identical barrier
+            Visibility is handled by the acquire, so the release doesn't need a destination access or stage
+        */
+        m_barriers.clear();
+        for (const PendingCopy& copy : m_pending) {
+            VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+            barrier.buffer = copy.dst_buffer;
+            barrier.offset = copy.region.dstOffset;
+            barrier.size = copy.region.size;
+            m_barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(command_buffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(m_barriers.size()), m_barriers.data(), 0, nullptr);
+
+        submission.acquire_barriers = m_barriers;
+        for (auto& barrier : submission.acquire_barriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = UPLOAD_DST_ACCESS;
+        }
+    } else {
+        /*
+            Make the copied data visible to anything that reads it later on this queue
+            The second scope of a barrier covers every command submitted after it, including later submissions, so frames don't need to wait on anything else
+        */
+        VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = UPLOAD_DST_ACCESS;
+        vkCmdPipelineBarrier(command_buffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_DST_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    command_buffer.endRecording();
+
+    VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer.getHandle();
+
+    // The write after read dependency on a transfer queue, wait for every frame submitted so far before copying ranges they may read
+    VkSemaphore frame_timeline = m_context->frame_timeline.getSemaphore();
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    uint64_t wait_value = m_context->frame_timeline.getLastSubmittedValue();
+    uint64_t signal_value = 0; // The signalled semaphore is binary and ignores it
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR };
+    if (m_dedicated_transfer && overwrites_in_use) {
+        timeline_info.waitSemaphoreValueCount = 1;
+        timeline_info.pWaitSemaphoreValues = &wait_value;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &signal_value;
+
+        submit_info.pNext = &timeline_info;
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &frame_timeline;
+        submit_info.pWaitDstStageMask = &wait_stage;
+    }
+    if (m_dedicated_transfer) {
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &submission.semaphore;
+    }
+    VkResult result = vkQueueSubmit(m_context->device.getTransferQueue(), 1, &submit_info, submission.fence.getHandle());
+    if (result != VK_SUCCESS) Logger::fatal("Failed to submit staging uploads");
+    command_buffer.updateSubmitted();
+
+    submission.ring_end = m_head;
+    submission.token = m_current_token;
+    submission.in_flight = true;
+    submission.acquire_pending = m_dedicated_transfer;
+    submission.overflow_buffers.swap(m_overflow_buffers);
+    m_next_submission = (m_next_submission + 1) % MAX_SUBMISSIONS;
+
+    m_pending.clear();
+    m_flush_condition.notify_all();
+    return m_current_token++;
+}
+
+void VulkanStagingRing::retireCompleted() {
+    // Walk the slots oldest first and stop at the first unfinished batch, so the tail never moves past memory still being read
+    for (uint32_t i = 0; i < MAX_SUBMISSIONS; i++) {
+        Submission& submission = m_submissions[(m_next_submission + i) % MAX_SUBMISSIONS];
+        if (!submission.in_flight) continue;
+        if (!submission.fence.poll()) break;
+
+        submission.in_flight = false;
+        for (auto& buffer : submission.overflow_buffers) buffer->destroy();
+        submission.overflow_buffers.clear();
+        m_tail = std::max<uint64_t>(m_tail, submission.ring_end);
+        m_completed_token = std::max(m_completed_token, submission.token);
+    }
+}
+
+void VulkanStagingRing::waitOldest() {
+    for (uint32_t i = 0; i < MAX_SUBMISSIONS; i++) {
+        Submission& submission = m_submissions[(m_next_submission + i) % MAX_SUBMISSIONS];
+        if (!submission.in_flight) continue;
+        submission.fence.wait(UINT64_MAX);
+        break;
+    }
+    retireCompleted();
+}
+
+bool VulkanStagingRing::isComplete(UploadToken token) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    retireCompleted();
+    return token <= m_completed_token;
+}
+
+void VulkanStagingRing::wait(UploadToken token) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (token >= m_current_token) {
+        if (std::this_thread::get_id() == m_submit_thread) flushLocked();
+        else m_flush_condition.wait(lock, [this, token]() { return token < m_current_token; });
+    }
+
+    retireCompleted();
+    while (token > m_completed_token) {
+        bool any_in_flight = false;
+        for (auto& submission : m_submissions) any_in_flight |= submission.in_flight;
+        if (!any_in_flight) break;
+        waitOldest();
+    }
+}
+
+void VulkanStagingRing::recordAcquires(VulkanCommandBuffer& command_buffer, std::vector<VkSemaphore>& wait_semaphores, std::vector<VkPipelineStageFlags>& wait_stages) {
+    if (!m_dedicated_transfer) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    recordAcquiresLocked(command_buffer.getHandle(), wait_semaphores, wait_stages);
+}
+
+void VulkanStagingRing::recordAcquiresLocked(VkCommandBuffer command_buffer, std::vector<VkSemaphore>& wait_semaphores, std::vector<VkPipelineStageFlags>& wait_stages) {
+    m_barriers.clear();
+    for (uint32_t i = 0; i < MAX_SUBMISSIONS; i++) {
+        Submission& submission = m_submissions[(m_next_submission + i) % MAX_SUBMISSIONS];
+        if (!submission.acquire_pending) continue;
+
+        m_barriers.insert(m_barriers.end(), submission.acquire_barriers.begin(), submission.acquire_barriers.end());
+        wait_semaphores.push_back(submission.semaphore);
+        wait_stages.push_back(UPLOAD_DST_STAGES);
+        submission.acquire_pending = false;
+    }
+
+    if (m_barriers.empty()) return;
+
+    // The semaphore wait blocks the destination stages until the transfer queue has released the ranges, then the acquire makes them visible
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, UPLOAD_DST_STAGES, 0, 0, nullptr, static_cast<uint32_t>(m_barriers.size()), m_barriers.data(), 0, nullptr);
+}
+
+void VulkanStagingRing::submitAcquiresLocked() {
+    /*
+        Only happens when more than MAX_SUBMISSIONS batches were flushed between two frames, e.g. while streaming in a level
+        Acquire everything with a small submission of our own so the semaphores can be reused
+    */
+    if (m_acquire_in_flight) m_acquire_fence.wait(UINT64_MAX);
+    m_acquire_fence.reset();
+
+    m_acquire_semaphores.clear();
+    m_acquire_stages.clear();
+    m_acquire_command_buffer.reset();
+    m_acquire_command_buffer.beginRecording(true, false, false);
+    recordAcquiresLocked(m_acquire_command_buffer.getHandle(), m_acquire_semaphores, m_acquire_stages);
+    m_acquire_command_buffer.endRecording();
+
+    VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(m_acquire_semaphores.size());
+    submit_info.pWaitSemaphores = m_acquire_semaphores.data();
+    submit_info.pWaitDstStageMask = m_acquire_stages.data();
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &m_acquire_command_buffer.getHandle();
+    VkResult result = vkQueueSubmit(m_context->device.getGraphicsQueue(), 1, &submit_info, m_acquire_fence.getHandle());
+    if (result != VK_SUCCESS) Logger::fatal("Failed to submit staging acquires");
+    m_acquire_command_buffer.updateSubmitted();
+    m_acquire_in_flight = true;
+}
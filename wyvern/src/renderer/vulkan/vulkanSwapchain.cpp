@@ -4,18 +4,29 @@
 
 #include "core/Logger.hpp"
 
+#include <algorithm>
+
 void VulkanSwapchain::create(uint32_t width, uint32_t height, VulkanContext& context) {
     m_context = &context;
+    createSwapchain(width, height, VK_NULL_HANDLE);
+}
+
+void VulkanSwapchain::createSwapchain(uint32_t width, uint32_t height, VkSwapchainKHR old_swapchain) {
+    if (m_context->headless) {
+        createOffscreenImages(width, height);
+        m_depthAttachment.create(*m_context, VK_IMAGE_TYPE_2D, m_swapChainExtent.width, m_swapChainExtent.height, m_context->device.getDepthFormat(), VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_IMAGE_ASPECT_DEPTH_BIT);
+        return;
+    }
     
     SwapChainSupportDetails swapchainSupport = m_context->device.getSwapchainSupportDetails();
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapchainSupport.capabilities, width, height);
 
-    uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
+    uint32_t imageCount = m_config.image_count ? m_config.image_count : swapchainSupport.capabilities.minImageCount + 1;
+    imageCount = std::max(imageCount, swapchainSupport.capabilities.minImageCount);
     if (swapchainSupport.capabilities.maxImageCount > 0 && imageCount > swapchainSupport.capabilities.maxImageCount)
         imageCount = swapchainSupport.capabilities.maxImageCount;
-    m_context->max_frames_in_flight = imageCount - 1;
 
     VkSwapchainCreateInfoKHR create_info = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
     create_info.surface = m_context->surface;
@@ -44,7 +55,7 @@ void VulkanSwapchain::create(uint32_t width, uint32_t height, VulkanContext& con
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // Usually want to ignore alpha channel
     create_info.presentMode = presentMode;
     create_info.clipped = VK_TRUE; // Don't care about obscured pixels
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = old_swapchain; // Retired by this call, it can't be acquired from anymore but images already queued are still shown
 
     VkResult result = vkCreateSwapchainKHR(m_context->device.getLogicalDevice(), &create_info, nullptr, &m_swapChain);
     if (result != VK_SUCCESS) Logger::fatal("Failed to create swap chain!");
@@ -53,10 +64,11 @@ void VulkanSwapchain::create(uint32_t width, uint32_t height, VulkanContext& con
     vkGetSwapchainImagesKHR(m_context->device.getLogicalDevice(), m_swapChain, &imageCount, nullptr);
     m_images.resize(imageCount);
     vkGetSwapchainImagesKHR(m_context->device.getLogicalDevice(), m_swapChain, &imageCount, m_images.data());
+    setFramesInFlight(imageCount); // The driver may have made more images than asked for
 
     m_imageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
-    Logger::info("Successfully created swapchain");
+    Logger::info("Successfully created swapchain (%u images, %u frames in flight, present mode %d)", imageCount, m_context->max_frames_in_flight, presentMode);
 
     createImageViews();
 
@@ -65,32 +77,80 @@ void VulkanSwapchain::create(uint32_t width, uint32_t height, VulkanContext& con
 }
 
 void VulkanSwapchain::recreate(uint32_t width, uint32_t height) {
-    destroy();
-    create(width, height, *m_context);
+    VkSwapchainKHR old_swapchain = m_swapChain;
+    retireResources();
+    createSwapchain(width, height, old_swapchain);
+
+    /*
+        Frames submitted before the recreation may still be presenting from the old swapchain
+        Without VK_EXT_swapchain_maintenance1 there's no way to know when a present has finished, so the old swapchain is kept until the frame being recorded now has retired,
+        by then every frame that presented to it has finished rendering a full frame ago
+    */
+    m_context->deletion_queue.pushSwapchain(old_swapchain);
 }
 
 void VulkanSwapchain::destroy() {
-    vkDeviceWaitIdle(m_context->device.getLogicalDevice());
-    for (int i = 0; i < getImageCount(); i++) getFrameBuffer(i).destroy();
+    retireResources();
+    m_context->deletion_queue.pushSwapchain(m_swapChain);
+    m_swapChain = VK_NULL_HANDLE;
+}
+
+void VulkanSwapchain::retireResources() {
+    // Frames still in flight may be rendering into these, so they all go through the deletion queue
+    for (auto& framebuffer : m_framebuffers) framebuffer.destroy();
+    m_framebuffers.clear();
 
     m_depthAttachment.destroy();
+
+    if (m_context->headless) {
+        for (auto& image : m_offscreen_images) image.destroy(); // Also destroys the views
+        m_offscreen_images.clear();
+        m_images.clear();
+        m_imageViews.clear();
+        return;
+    }
     
-    for (auto view : m_imageViews) {
-        vkDestroyImageView(m_context->device.getLogicalDevice(), view, nullptr);
+    for (auto view : m_imageViews) m_context->deletion_queue.pushImageView(view);
+    m_imageViews.clear();
+    m_images.clear(); // Owned by the VkSwapchainKHR
+}
+
+void VulkanSwapchain::createOffscreenImages(uint32_t width, uint32_t height) {
+    m_imageFormat = VK_FORMAT_B8G8R8A8_UNORM; // Same channel order as most swapchains, and supported as a color attachment everywhere
+    m_swapChainExtent = { width, height };
+    uint32_t image_count = std::max(m_config.image_count ? m_config.image_count : OFFSCREEN_IMAGE_COUNT, 2u);
+    setFramesInFlight(image_count);
+
+    m_offscreen_images.resize(image_count);
+    m_images.resize(image_count);
+    m_imageViews.resize(image_count);
+    for (uint32_t i = 0; i < image_count; i++) {
+        m_offscreen_images[i].create(*m_context, VK_IMAGE_TYPE_2D, width, height, m_imageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_images[i] = m_offscreen_images[i].getHandle();
+        m_imageViews[i] = m_offscreen_images[i].getImageView();
     }
+    m_next_offscreen_image = 0;
 
-    vkDestroySwapchainKHR(m_context->device.getLogicalDevice(), m_swapChain, nullptr);
+    Logger::info("Created %u offscreen images (%ux%u) for headless rendering", image_count, width, height);
 }
 
 VkResult VulkanSwapchain::acquireNextImageIndex(VkSemaphore image_available_semaphore, uint32_t* out_image_index) {
+    if (m_context->headless) {
+        *out_image_index = m_next_offscreen_image;
+        m_next_offscreen_image = (m_next_offscreen_image + 1) % m_images.size();
+        return VK_SUCCESS;
+    }
+
     VkResult result = vkAcquireNextImageKHR(m_context->device.getLogicalDevice(), m_swapChain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, out_image_index);
     return result;
 }
 
-void VulkanSwapchain::present(VkQueue presentQueue, VkSemaphore signalSemaphores, uint32_t imageIndex) {
+VkResult VulkanSwapchain::present(VkQueue presentQueue, VkSemaphore signalSemaphores, uint32_t imageIndex) {
     /*
         Return image back to the swapchain for presentation
     */
+    if (m_context->headless) return VK_SUCCESS;
+
     VkPresentInfoKHR present_info = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
     present_info.waitSemaphoreCount = 1;
     present_info.pWaitSemaphores = &signalSemaphores;
@@ -100,7 +160,8 @@ void VulkanSwapchain::present(VkQueue presentQueue, VkSemaphore signalSemaphores
     present_info.pImageIndices = &imageIndex;
 
     VkResult result = vkQueuePresentKHR(presentQueue, &present_info);
-    if (result != VK_SUCCESS) Logger::fatal("Failed to present swap chain image");
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) Logger::fatal("Failed to present swap chain image");
+    return result;
 }
 
 VkSurfaceFormatKHR VulkanSwapchain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -126,12 +187,23 @@ VkPresentModeKHR VulkanSwapchain::chooseSwapPresentMode(const std::vector<VkPres
     */
 
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        if (availablePresentMode == m_config.present_mode) {
+            m_present_mode = availablePresentMode;
             return availablePresentMode;
+        }
     }
+
+    if (m_config.present_mode != VK_PRESENT_MODE_FIFO_KHR) Logger::warn("Present mode %d isn't supported by the surface, falling back to FIFO", m_config.present_mode);
+    m_present_mode = VK_PRESENT_MODE_FIFO_KHR;
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+void VulkanSwapchain::setFramesInFlight(uint32_t image_count) {
+    // More frames in flight than images would just have the extra frames wait in acquire
+    uint32_t frames_in_flight = m_config.frames_in_flight ? m_config.frames_in_flight : image_count - 1;
+    m_context->max_frames_in_flight = std::clamp(frames_in_flight, 1u, image_count);
+}
+
 VkExtent2D VulkanSwapchain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t width,
     uint32_t height) {
     VkExtent2D actualExtent = { width, height };
@@ -174,8 +246,8 @@ void VulkanSwapchain::regenerateFramebuffers() {
     m_framebuffers.resize(m_images.size());
 
     for (int i = 0; i < m_framebuffers.size(); i++) {
-        std::vector<VkImageView> imageViews = { m_imageViews[i], m_depthAttachment.getImageView() };
+        VkImageView imageViews[2] = { m_imageViews[i], m_depthAttachment.getImageView() }; // Attachments in the same order as the renderpass
 
-        m_framebuffers[i].create(*m_context, m_context->framebuffer_width, m_context->framebuffer_height, imageViews);
+        m_framebuffers[i].create(*m_context, m_context->framebuffer_width, m_context->framebuffer_height, imageViews, 2);
     }
 }
\ No newline at end of file